@@ -13,16 +13,40 @@
 #include "device_settings.h"
 
 #define CLOCK_SPEED 16000000
+// ESP8266 starts with this baud rate. TIMER3 is always configured for it, so the end of frame gap is longer on escalated baud rates
 #define USART_BAUD_RATE 115200
+#define USART_16X_OVERSAMPLING_MAX_BAUD_RATE 460800
+#define USART_ESCALATED_BAUD_RATES_SIZE 2
+// Framing and noise errors of an escalated baud rate are counted in windows. This many of them in one window mean the line can't
+// carry the baud rate, the rare errors of a long uptime don't add up
+#define USART_ESCALATED_BAUD_RATE_MAX_ERRORS 5
+#define USART_ESCALATED_BAUD_RATE_ERRORS_WINDOW TIMER14_60S
+#define USART_ESCALATED_BAUD_RATE_MAX_PROBES 3
 #define TIMER3_PERIOD_TICKS (unsigned int)(CLOCK_SPEED * 15 / USART_BAUD_RATE)
-#define TIMER3_SEC_PER_PERIOD ((float)TIMER3_PERIOD_TICKS / CLOCK_SPEED)
 #define TIMER3_MS_PER_PERIOD ((float)TIMER3_PERIOD_TICKS * 1000 / CLOCK_SPEED)
+#define TIMER3_US_PER_PERIOD (TIMER3_PERIOD_TICKS / SYSTICK_TICKS_PER_US)
+#define SYSTICK_TICKS_PER_MS (CLOCK_SPEED / 1000)
+#define SYSTICK_TICKS_PER_US (CLOCK_SPEED / 1000000)
 #define TIMER14_PERIOD 24
 #define TIMER14_PRESCALER 0xFFFF
 #define TIMER14_TACTS_PER_SECOND (CLOCK_SPEED / TIMER14_PERIOD / TIMER14_PRESCALER)
 
 #define USART1_TX_DMA_CHANNEL DMA1_Channel2
 #define USART1_TDR_ADDRESS (unsigned int)(&(USART1->TDR))
+// ADC requests are mapped to this channel by default
+#define ADC_DMA_CHANNEL DMA1_Channel1
+#define ADC_DR_ADDRESS (unsigned int)(&(ADC1->DR))
+// TIMER1 update triggers a conversion of the temperature sensor and VREFINT every period
+#define TIMER1_PRESCALER (CLOCK_SPEED / 1000 - 1)
+#define TIMER1_PERIOD_MS 100
+// Pairs of the temperature sensor and VREFINT conversions (the scan is upward: channel 16, then 17), averaged on reading
+#define HEALTH_SAMPLES_SIZE 16
+// Factory calibration at 3.3V: VREFINT and the temperature sensor at 30 degrees C
+#define VREFINT_CAL (*(unsigned short *) 0x1FFFF7BA)
+#define TEMPERATURE_SENSOR_CAL_30C (*(unsigned short *) 0x1FFFF7B8)
+#define CALIBRATION_VDDA_MV 3300
+// 4.3 mV/degree C in 3.3V conversion steps multiplied by 1000
+#define TEMPERATURE_SENSOR_AVERAGE_SLOPE 5336
 
 #if defined STM32F030K6T6
    #define NETWORK_STATUS_LED_PIN GPIO_Pin_5
@@ -44,23 +68,152 @@
    #define PROJECTOR_RELAY_PORT GPIOA
 #endif
 
+// Local control is enabled when device_settings.h defines LOCAL_CONTROL_KEY and LOCAL_CONTROL_PORT. The key is the 128 bit
+// SipHash key written as 16 characters
+#if defined LOCAL_CONTROL_KEY
+   #define LOCAL_CONTROL_ENABLED 1
+   _Static_assert(sizeof(LOCAL_CONTROL_KEY) == 17, "LOCAL_CONTROL_KEY has to consist of 16 characters");
+   // Multiple connections mode. Incoming connections take the lowest free link IDs, so the server uses the last one
+   #define SERVER_LINK_ID "4"
+   // The only link to the server. Separate status, command and maintenance links are out of scope: the long polling request
+   // carries the status already, and ESP8266 shares one USART and 5 link IDs with the LAN clients
+   #define SERVER_LINK_ID_PARAMETER SERVER_LINK_ID ","
+   #define SERVER_LINK_ID_ASSIGNMENT "=" SERVER_LINK_ID
+#else
+   #define LOCAL_CONTROL_ENABLED 0
+   #define LOCAL_CONTROL_KEY "0000000000000000"
+   #define LOCAL_CONTROL_PORT "0"
+   #define SERVER_LINK_ID ""
+   #define SERVER_LINK_ID_PARAMETER ""
+   #define SERVER_LINK_ID_ASSIGNMENT ""
+#endif
+
+// The optional statistics of the debug info are collected and sent when device_settings.h defines them. The flash of
+// STM32F030F4P6 doesn't hold all of them along with the firmware
+#if defined POLL_CYCLE_STATISTICS
+   #define POLL_CYCLE_STATISTICS_ENABLED 1
+#else
+   #define POLL_CYCLE_STATISTICS_ENABLED 0
+#endif
+#if defined UPTIME_STATISTICS
+   #define UPTIME_STATISTICS_ENABLED 1
+#else
+   #define UPTIME_STATISTICS_ENABLED 0
+#endif
+#if defined FAULT_RECOVERY_STATISTICS
+   #define FAULT_RECOVERY_STATISTICS_ENABLED 1
+#else
+   #define FAULT_RECOVERY_STATISTICS_ENABLED 0
+#endif
+#if defined REQUEST_TRACES
+   #define REQUEST_TRACES_ENABLED 1
+#else
+   #define REQUEST_TRACES_ENABLED 0
+#endif
+#if defined COMMAND_TIMEOUT_STATISTICS
+   #define COMMAND_TIMEOUT_STATISTICS_ENABLED 1
+#else
+   #define COMMAND_TIMEOUT_STATISTICS_ENABLED 0
+#endif
+#if defined RECOVERY_STEP_STATISTICS
+   #define RECOVERY_STEP_STATISTICS_ENABLED 1
+#else
+   #define RECOVERY_STEP_STATISTICS_ENABLED 0
+#endif
+#if defined RAM_USAGE_STATISTICS
+   #define RAM_USAGE_STATISTICS_ENABLED 1
+#else
+   #define RAM_USAGE_STATISTICS_ENABLED 0
+#endif
+// The start and reset times of the device and the counters of the connection
+#if defined DEVICE_STATISTICS
+   #define DEVICE_STATISTICS_ENABLED 1
+#else
+   #define DEVICE_STATISTICS_ENABLED 0
+#endif
+
+// The optional features are built when device_settings.h defines them, the flash of STM32F030F4P6 doesn't hold all of them either.
+// ESP8266 is switched to a faster baud rate with USART_BAUD_RATE_ESCALATION, it needs AT firmware supporting AT+UART_CUR
+#if defined USART_BAUD_RATE_ESCALATION
+   #define USART_BAUD_RATE_ESCALATION_ENABLED 1
+#else
+   #define USART_BAUD_RATE_ESCALATION_ENABLED 0
+#endif
+// The server is pinged every 30 s while idle with SERVER_PING. Without it "serverPing" of the debug info stays 0
+#if defined SERVER_PING
+   #define SERVER_PING_ENABLED 1
+#else
+   #define SERVER_PING_ENABLED 0
+#endif
+// The verified ESP8266 configuration is saved into the reserved flash page with WARM_BOOT, the next boots skip its queries
+#if defined WARM_BOOT
+   #define WARM_BOOT_ENABLED 1
+#else
+   #define WARM_BOOT_ENABLED 0
+#endif
+// Every request starts with AT+CIPSTATUS with LINK_STATUS_QUERY, so CIPSTART is skipped on the open link and the lost Wi-Fi is
+// rejoined right away. Without it "linkStatus" isn't sent
+#if defined LINK_STATUS_QUERY
+   #define LINK_STATUS_QUERY_ENABLED 1
+#else
+   #define LINK_STATUS_QUERY_ENABLED 0
+#endif
+// The response timeouts are estimated from the measured RTT with ADAPTIVE_COMMAND_TIMEOUTS. Without it every command class waits
+// its maximum timeout
+#if defined ADAPTIVE_COMMAND_TIMEOUTS
+   #define ADAPTIVE_COMMAND_TIMEOUTS_ENABLED 1
+#else
+   #define ADAPTIVE_COMMAND_TIMEOUTS_ENABLED 0
+#endif
+// The USART ISR starts the request payload on the "> " prompt of CIPSEND with PAYLOAD_ON_PROMPT. Without it the payload is sent
+// when the prompt response is handled
+#if defined PAYLOAD_ON_PROMPT
+   #define PAYLOAD_ON_PROMPT_ENABLED 1
+#else
+   #define PAYLOAD_ON_PROMPT_ENABLED 0
+#endif
+// The relay and the link state are restored after a warm reset from the .noinit record with WARM_RESET_RECOVERY. Without it they
+// start from scratch, and "warmResets" with "watchdogResets" of the debug info stay 0
+#if defined WARM_RESET_RECOVERY
+   #define WARM_RESET_RECOVERY_ENABLED 1
+#else
+   #define WARM_RESET_RECOVERY_ENABLED 0
+#endif
+// The commands are sent while the server holds the long polling request with BACKGROUND_LONG_POLLING. Without it the request
+// keeps the scheduler until the response, as a command does
+#if defined BACKGROUND_LONG_POLLING
+   #define BACKGROUND_LONG_POLLING_ENABLED 1
+#else
+   #define BACKGROUND_LONG_POLLING_ENABLED 0
+#endif
+// The next queued task is sent in the loop turn of the completed response with CHAINED_TASKS, otherwise in the next turn
+#if defined CHAINED_TASKS
+   #define CHAINED_TASKS_ENABLED 1
+#else
+   #define CHAINED_TASKS_ENABLED 0
+#endif
+
 // General flags
-#define USART_DATA_RECEIVED_FLAG 1
 #define SERVER_IS_AVAILABLE_FLAG 2
 #define SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG 4
 #define SEND_DEBUG_INFO_FLAG 8
 #define TURN_PROJECTOR_ON 16
+#define FULL_STATUS_REQUIRED_FLAG 32
+// The relay follows the local control command until the server has been informed about it
+#define LOCALLY_CONTROLLED_FLAG 64
+// The configuration page is rewritten once the link is idle
+#define CONFIGURATION_PAGE_WRITE_PENDING_FLAG 128
 
 #define GET_VISIBLE_NETWORK_LIST_TASK 1
 #define DISABLE_ECHO_TASK 2
 #define CONNECT_TO_NETWORK_TASK 4
-//
+#define SET_USART_BAUD_RATE_TASK 8
 #define GET_AP_CONNECTION_STATUS_AND_CONNECT_TASK 16
 #define GET_OWN_IP_ADDRESS_TASK 32
 #define SET_OWN_IP_ADDRESS_TASK 64
 #define CONNECT_TO_SERVER_TASK 128
 #define SET_BYTES_TO_SEND_IN_REQUEST_TASK 256
-//
+#define PROBE_USART_BAUD_RATE_TASK 512
 #define POST_REQUEST_SENT_TASK 1024
 #define GET_CURRENT_DEFAULT_WIFI_MODE_TASK 2048
 #define SET_DEFAULT_STATION_WIFI_MODE_TASK 4096
@@ -70,8 +223,19 @@
 #define GET_SERVER_AVAILABILITY_TASK 65536
 #define ESTABLISH_LONG_POLLING_CONNECTION_TASK 131072
 #define ESTABLISH_LONG_POLLING_CONNECTION_REQUEST_TASK 262144
-
-#define USART_DATA_RECEIVED_BUFFER_SIZE 1000
+#define SOFT_RESET_ESP8266_TASK 524288
+#define SET_MULTIPLE_CONNECTIONS_TASK 1048576
+#define START_LOCAL_CONTROL_SERVER_TASK 2097152
+#define GET_LINK_STATUS_TASK 4194304
+
+// ESP8266 settings saved into its flash ("_DEF" commands) which have been confirmed
+#define STATION_WIFI_MODE_VERIFIED_SETTING 1
+#define OWN_IP_ADDRESS_VERIFIED_SETTING 2
+#define ALL_VERIFIED_SETTINGS (STATION_WIFI_MODE_VERIFIED_SETTING | OWN_IP_ADDRESS_VERIFIED_SETTING)
+
+// Every of the 2 receiving buffers. 1 character is for '\0'. Longer responses are handed over in chunks of whole lines
+#define USART_DATA_RECEIVED_BUFFER_SIZE 256
+#define USART_DATA_RECEIVED_BUFFERS_AMOUNT 2
 #define PIPED_REQUEST_COMMANDS_TO_SEND_SIZE 3
 #define PIPED_REQUEST_CIPSTART_COMMAND_INDEX 0
 #define PIPED_REQUEST_CIPSEND_COMMAND_INDEX 1
@@ -80,7 +244,8 @@
 #define PIPED_TASKS_TO_SEND_SIZE 30
 #define PIPED_TASKS_HISTORY_SIZE 10
 #define SENT_TASKS_HISTORY_SIZE 10
-#define DEFAULT_ACCESS_POINT_GAIN_SIZE 4
+// Reported when the RSSI hasn't been received yet
+#define UNKNOWN_RSSI_DBM -1
 
 #define TIMER3_10MS (unsigned short)(10 / TIMER3_MS_PER_PERIOD)
 #define TIMER3_100MS (unsigned short)(100 / TIMER3_MS_PER_PERIOD)
@@ -101,104 +266,621 @@ typedef enum {
    DO_NOT_EXECUTE_FUNCTION_IMMEDIATELY
 } ImmediatelyFunctionExecution;
 
+typedef enum {
+   DEVICE_STARTED_EVENT,
+   DEVICE_STATE_RESET_EVENT,
+   ESP8266_DISABLED_EVENT,
+   NETWORK_CONNECTED_EVENT,
+   NETWORK_DISCONNECTED_EVENT,
+   SERVER_AVAILABLE_EVENT,
+   SERVER_UNAVAILABLE_EVENT,
+   PROJECTOR_TURNED_ON_EVENT,
+   PROJECTOR_TURNED_OFF_EVENT
+} DeviceEvent;
+
+typedef enum {
+   RESPONSE_TIMEOUT_FAULT,
+   ERROR_RESPONSE_FAULT,
+   BUSY_RESPONSE_FAULT,
+   CONNECTION_CLOSED_FAULT,
+   NETWORK_DISCONNECTED_FAULT,
+   SERVICE_UNAVAILABLE_FAULT,
+   UNEXPECTED_RESPONSE_FAULT,
+   FAULT_CLASSES_SIZE
+} FaultClass;
+
+// Ordered from the cheapest step. The next one is taken when the previous hasn't recovered the long polling
+typedef enum {
+   RESYNC_PARSER_RECOVERY_STEP,
+   REISSUE_AT_RECOVERY_STEP,
+   REOPEN_CONNECTION_RECOVERY_STEP,
+   REJOIN_NETWORK_RECOVERY_STEP,
+   SOFT_RESET_ESP8266_RECOVERY_STEP,
+   POWER_CYCLE_ESP8266_RECOVERY_STEP,
+   SYSTEM_RESET_RECOVERY_STEP,
+   RECOVERY_STEPS_SIZE
+} RecoveryStep;
+
+// Stages of a long polling request
+typedef enum {
+   CIPSTART_SENT_STAGE,
+   CONNECTED_STAGE,
+   SEND_PROMPT_STAGE,
+   PAYLOAD_SENT_STAGE,
+   SEND_OK_STAGE,
+   FIRST_RESPONSE_BYTE_STAGE,
+   RESPONSE_PARSED_STAGE,
+   RELAY_WRITTEN_STAGE,
+   TRACE_STAGES_SIZE
+} TraceStage;
+
+// Commands of a class share the response timeout estimation
+typedef enum {
+   QUICK_COMMAND_CLASS,
+   SETTINGS_COMMAND_CLASS,
+   CONNECTION_COMMAND_CLASS,
+   LONG_COMMAND_CLASS,
+   LONG_POLLING_COMMAND_CLASS,
+   // AT+CWJAP_DEF takes seconds whatever the quick connection commands take
+   ACCESS_POINT_JOIN_COMMAND_CLASS,
+   COMMAND_CLASSES_SIZE
+} CommandClass;
+
+// Statistics of the debug info are split over consecutive polls, so the request stays far below the CIPSEND limit of 2048 bytes
+typedef enum {
+   DEVICE_DEBUG_INFO_SECTION,
+   CONNECTION_DEBUG_INFO_SECTION,
+   FAULTS_DEBUG_INFO_SECTION,
+   RECOVERY_DEBUG_INFO_SECTION,
+   MEASUREMENTS_DEBUG_INFO_SECTION,
+   DEBUG_INFO_SECTIONS_SIZE
+} DebugInfoSection;
+
+// "STATUS:<n>" of AT+CIPSTATUS
+typedef enum {
+   UNKNOWN_LINK_STATUS,
+   GOT_IP_LINK_STATUS = 2,
+   CONNECTED_LINK_STATUS = 3,
+   DISCONNECTED_LINK_STATUS = 4,
+   NO_WIFI_LINK_STATUS = 5
+} LinkStatus;
+
+// The long polling request is held by the server in the background after "SEND OK", so other commands can be sent meanwhile
+typedef enum {
+   NO_LONG_POLLING_WAIT,
+   LONG_POLLING_RESPONSE_WAIT,
+   // After the failed request
+   LONG_POLLING_RETRY_WAIT
+} LongPollingWait;
+
+typedef enum {
+   POWER_ON_RESET_CAUSE,
+   PIN_RESET_CAUSE,
+   SOFTWARE_RESET_CAUSE,
+   WATCHDOG_RESET_CAUSE,
+   LOW_POWER_RESET_CAUSE,
+   OPTION_BYTES_RESET_CAUSE
+} ResetCause;
+
+#define TRACES_SIZE 4
+#define DEVICE_EVENTS_SIZE 8
+// The most numbers a statistics template has, CONNECTION_STATISTICS_JSON_FIELD
+#define NUMBER_PARAMETERS_MAX 11
+// The debug info counters and the baud rate, which are sent when they have been changed
+#define DEBUG_COUNTERS_SIZE 7
+// The upper bound of ESP8266 start time (TIMER14_5S) when "ready" isn't received
+#define ESP8266_START_TIMEOUT_MS 5000
+// Consecutive errors and timeouts before the next recovery step is taken
+#define RECOVERY_STEP_MAX_ERRORS 5
+#define LONG_POLLING_RETRY_DELAY_MS 15000
+#define COMMAND_LATENCY_HISTOGRAM_SIZE 16
+// 2^6 - the timeout reaches the class maximum long before
+#define COMMAND_TIMEOUT_MAX_BACKOFF_SHIFT 6
+// Free RAM is filled with the pattern on boot, so overwritten words show how far the heap and the stack have ever grown
+#define FREE_RAM_PAINT_PATTERN 0xC5C5C5C5
+// Words below the stack pointer left unpainted: the painting function frame and its callee
+#define FREE_RAM_PAINT_STACK_MARGIN_WORDS 8
+// Flags kept in the recovery record, so the relay is restored right after a warm reset
+#define RECOVERED_GENERAL_FLAGS (SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG | SERVER_IS_AVAILABLE_FLAG | TURN_PROJECTOR_ON | LOCALLY_CONTROLLED_FLAG)
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+// The tag of the local control command is SipHash-2-4 printed as 16 hex digits
+#define LOCAL_CONTROL_TAG_LENGTH 16
+#define ROTATE_LEFT_64(x, bits) (((x) << (bits)) | ((x) >> (64 - (bits))))
+// Till the end of the 1 KB configuration page
+#define SAVED_LOCAL_CONTROL_SEQUENCES_SIZE 254
+// Free slots left for the commands, which come before the full page is rewritten on the idle link
+#define SAVED_LOCAL_CONTROL_SEQUENCES_RESERVE 16
+// Flags which changes are saved as events
+#define LOGGED_GENERAL_FLAGS (SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG | SERVER_IS_AVAILABLE_FLAG | TURN_PROJECTOR_ON)
+
+typedef struct {
+   signed char rssi_dbm;
+   unsigned char server_is_available;
+   unsigned char full_status;
+   // In the order of DEBUG_COUNTER_JSON_FIELDS
+   unsigned int debug_counters[DEBUG_COUNTERS_SIZE];
+   unsigned int local_control_sequence;
+   LinkStatus link_status;
+} StatusSnapshot;
+
+typedef struct {
+   unsigned int timestamp_ms;
+   DeviceEvent event;
+} DeviceEventRecord;
+
+typedef struct {
+   unsigned short faults;
+   unsigned short recoveries;
+   unsigned int last_recovery_time_ms;
+   unsigned int max_recovery_time_ms;
+} FaultRecoveryStatistics;
+
+typedef struct {
+   unsigned short attempts;
+   unsigned short recoveries;
+   unsigned int last_recovery_time_ms;
+   unsigned int max_recovery_time_ms;
+} RecoveryStepStatistics;
+
+typedef struct {
+   unsigned int start_timestamp_ms;
+   // Since CIPSTART_SENT_STAGE
+   unsigned int stage_offsets_ms[TRACE_STAGES_SIZE];
+   unsigned char recorded_stages;
+} Trace;
+
+typedef struct {
+   unsigned int min_timeout_ms;
+   unsigned int max_timeout_ms;
+} CommandClassTimeoutBounds;
+
+// Smoothed RTT is scaled by 8 and its variance by 4 as in TCP, so small changes aren't lost in the integer division. 0 - no samples yet
+typedef struct {
+   unsigned int scaled_smoothed_rtt_ms;
+   unsigned int scaled_rtt_variance_ms;
+   unsigned char consecutive_timeouts;
+} CommandClassTimeout;
+
+// The fast average is scaled by 4 (gain 1/4) and the slow one by 16 (gain 1/16). Their difference is the trend
+typedef struct {
+   signed char last_dbm;
+   signed char min_dbm;
+   signed char max_dbm;
+   unsigned short samples;
+   int sum_dbm;
+   int scaled_fast_average_dbm;
+   int scaled_slow_average_dbm;
+} RssiStatistics;
+
+// Kept in the reserved flash page. Erased flash reads as 0xFF, so an empty page isn't valid
+typedef struct {
+   // Of the device settings the configuration has been verified with
+   unsigned int settings_checksum;
+   unsigned short verified_settings;
+   // Protects from a partially written record
+   unsigned short verified_settings_complement;
+   // Accepted local control sequences are appended, the last written one is the current. Erased slots read as 0xFFFFFFFF
+   unsigned int saved_local_control_sequences[SAVED_LOCAL_CONTROL_SEQUENCES_SIZE];
+} VerifiedConfiguration;
+
+#define VERIFIED_CONFIGURATION_FLASH_ADDRESS ((unsigned int) _verified_config_page)
+#define VERIFIED_CONFIGURATION ((VerifiedConfiguration *) _verified_config_page)
+
+// Kept in the .noinit RAM section which survives warm resets. RAM is random after power on, so the record is checksummed
+typedef struct {
+   unsigned int general_flags;
+   // The last accepted local control command. Replays are rejected by the sequence saved in the flash
+   unsigned int local_control_sequence;
+   unsigned short status_sequence;
+   unsigned short warm_resets;
+   unsigned short watchdog_resets;
+   // FNV-1a of the fields above
+   unsigned int checksum;
+} RecoveryRecord;
+
+// Poll cycle is everything between two long polling requests preparations
+typedef struct {
+   unsigned short at_commands;
+   unsigned short sent_bytes;
+   unsigned short received_bytes;
+   unsigned short allocations;
+   unsigned int cpu_time_us;
+} PollCycleStatistics;
+
 #define RECEIVED_USART_DATA_FOR_DEBUG_INFO_MAX_LENGTH 100
 #define MALLOC_ADDRESSES_SIZE 100
-
-unsigned int piped_tasks_to_send_g[PIPED_TASKS_TO_SEND_SIZE];
-unsigned int piped_tasks_history_g[PIPED_TASKS_HISTORY_SIZE];
-unsigned char piped_tasks_history_index_g;
-unsigned int sent_tasks_history_g[SENT_TASKS_HISTORY_SIZE];
-unsigned char sent_tasks_history_index_g;
-char *piped_request_commands_to_send_g[PIPED_REQUEST_COMMANDS_TO_SEND_SIZE]; // AT+CIPSTART="TCP","address",port; AT+CIPSEND=bytes_to_send; a request
-unsigned int sent_task_g;
-unsigned int general_flags_g;
-
-char USART_OK[] __attribute__ ((section(".text.const"))) = "OK";
-char USART_ERROR[] __attribute__ ((section(".text.const"))) = "ERROR";
-char ESP8226_REQUEST_DISABLE_ECHO[] __attribute__ ((section(".text.const"))) = "ATE0\r\n";
-char ESP8226_RESPONSE_BUSY[] __attribute__ ((section(".text.const"))) = "busy";
-char ESP8226_REQUEST_GET_VISIBLE_NETWORK_LIST[] __attribute__ ((section(".text.const"))) = "AT+CWLAP\r\n";
-char ESP8226_RESPONSE_VISIBLE_NETWORK_LIST_PREFIX[] __attribute__ ((section(".text.const"))) = "+CWLAP:";
-char ESP8226_REQUEST_GET_AP_CONNECTION_STATUS[] __attribute__ ((section(".text.const"))) = "AT+CWJAP?\r\n";
-char ESP8226_RESPONSE_NOT_CONNECTED_STATUS[] __attribute__ ((section(".text.const"))) = "No AP";
-char ESP8226_REQUEST_CONNECT_TO_NETWORK_AND_SAVE[] __attribute__ ((section(".text.const"))) = "AT+CWJAP_DEF=\"<1>\",\"<2>\"\r\n";
-char ESP8226_REQUEST_GET_VERSION_ID[] __attribute__ ((section(".text.const"))) = "AT+GMR\r\n";
-char ESP8226_RESPONSE_CONNECTED[] __attribute__ ((section(".text.const"))) = "CONNECT";
-char ESP8226_CONNECTION_CLOSED[] __attribute__ ((section(".text.const"))) = "CLOSED\r\n\r\nOK";
-char ESP8226_REQUEST_CONNECT_TO_SERVER[] __attribute__ ((section(".text.const"))) = "AT+CIPSTART=\"TCP\",\"<1>\",<2>\r\n";
-char ESP8226_REQUEST_DISCONNECT_FROM_SERVER[] __attribute__ ((section(".text.const"))) = "AT+CIPCLOSE\r\n";
-char ESP8226_REQUEST_SERVER_PING[] __attribute__ ((section(".text.const"))) = "AT+PING=\"<1>\"\r\n";
-char ESP8226_REQUEST_START_SENDING[] __attribute__ ((section(".text.const"))) = "AT+CIPSEND=<1>\r\n";
-char ESP8226_RESPONSE_START_SENDING_READY[] __attribute__ ((section(".text.const"))) = ">";
-char ESP8226_RESPONSE_SENDING[] __attribute__ ((section(".text.const"))) = "busy s...";
-char ESP8226_RESPONSE_SUCCSESSFULLY_SENT[] __attribute__ ((section(".text.const"))) = "\r\nSEND OK\r\n";
-char ESP8226_RESPONSE_ALREADY_CONNECTED[] __attribute__ ((section(".text.const"))) = "ALREADY CONNECTED";
-char ESP8226_RESPONSE_PREFIX[] __attribute__ ((section(".text.const"))) = "+IPD";
-char ESP8226_REQUEST_GET_CURRENT_DEFAULT_WIFI_MODE[] __attribute__ ((section(".text.const"))) = "AT+CWMODE_DEF?\r\n";
-char ESP8226_RESPONSE_WIFI_MODE_PREFIX[] __attribute__ ((section(".text.const"))) = "+CWMODE_DEF:";
-char ESP8226_RESPONSE_WIFI_STATION_MODE[] __attribute__ ((section(".text.const"))) = "1";
-char ESP8226_REQUEST_SET_DEFAULT_STATION_WIFI_MODE[] __attribute__ ((section(".text.const"))) = "AT+CWMODE_DEF=1\r\n";
-char ESP8226_REQUEST_GET_OWN_IP_ADDRESS[] __attribute__ ((section(".text.const"))) = "AT+CIPSTA_DEF?\r\n";
-char ESP8226_RESPONSE_CURRENT_OWN_IP_ADDRESS_PREFIX[] __attribute__ ((section(".text.const"))) = "+CIPSTA_DEF:ip:";
-char ESP8226_REQUEST_SET_OWN_IP_ADDRESS[] __attribute__ ((section(".text.const"))) = "AT+CIPSTA_DEF=\"<1>\"\r\n";
-char ESP8226_REQUEST_SEND_STATUS_INFO_AND_ESTABLISH_LONG_POLLING_REQUEST[] __attribute__ ((section(".text.const"))) =
+#define DEFAULT_DEBUG_INFO_POLLS_INTERVAL 10
+
+typedef struct {
+   unsigned int sent_task;
+   unsigned int general_flags;
+   unsigned int piped_tasks_to_send[PIPED_TASKS_TO_SEND_SIZE];
+   unsigned int piped_tasks_history[PIPED_TASKS_HISTORY_SIZE];
+   unsigned char piped_tasks_history_index;
+   unsigned int sent_tasks_history[SENT_TASKS_HISTORY_SIZE];
+   unsigned char sent_tasks_history_index;
+   char *piped_request_commands_to_send[PIPED_REQUEST_COMMANDS_TO_SEND_SIZE]; // AT+CIPSTART="TCP","address",port; AT+CIPSEND=bytes_to_send; a request
+
+   char *usart_data_to_be_transmitted_buffer;
+   char *received_usart_error_data;
+   // Of the default access point from AT+CWJAP? and AT+CWLAP
+   RssiStatistics rssi;
+
+   // Written by DMA on every TIMER1 trigger, so the CPU never waits for the ADC
+   volatile unsigned short health_samples[HEALTH_SAMPLES_SIZE];
+   // 0 - not measured yet
+   unsigned short supply_voltage_mv;
+   unsigned short min_supply_voltage_mv;
+   unsigned short max_supply_voltage_mv;
+   signed char die_temperature_c;
+   signed char min_die_temperature_c;
+   signed char max_die_temperature_c;
+   // Into the receiving buffer
+   volatile unsigned short usart_received_bytes;
+   // Received bytes till the end of the last received line. 0 - no whole line has been received yet
+   volatile unsigned short usart_received_line_end_bytes;
+   volatile unsigned char usart_receiving_buffer_index;
+   // Set by TIMER3 when a frame has been handed over to the main loop, reset by the main loop when it's done with the frame
+   volatile unsigned char usart_data_received;
+   // The frame parsed by the main loop. Never written by the ISR while "usart_data_received" is set
+   char * volatile usart_data_received_buffer;
+   volatile unsigned short usart_data_received_length;
+   // The handed over data is a chunk of a longer frame. Only "on_received_line" consumes chunks, the handlers get the frame tail
+   volatile unsigned char usart_data_received_is_chunk;
+   // Called for every line of the received data while it's set
+   void (*on_received_line)(char *line);
+   unsigned char visible_networks_received;
+   volatile unsigned int final_task_for_request_resending;
+
+   void (*scheduled_function_to_execute_on_error)();
+   void (*on_response)();
+   volatile unsigned int send_usart_data_timeout_ms;
+   volatile unsigned char send_usart_data_errors_counter;
+   volatile unsigned short send_usart_data_errors_unresetable_counter;
+   volatile unsigned int last_error_task;
+   volatile unsigned short network_searching_status_led_counter;
+   volatile unsigned char esp8266_disabled_counter;
+   volatile unsigned char esp8266_disabled_timer;
+   unsigned short checking_connection_status_and_server_availability_timer;
+   unsigned short health_measurement_timer;
+   volatile unsigned short visible_network_list_timer;
+
+   volatile unsigned short usart_overrun_errors_counter;
+   volatile unsigned short usart_idle_line_detection_counter;
+   volatile unsigned short usart_noise_detection_counter;
+   volatile unsigned short usart_framing_errors_counter;
+   // Received bytes dropped because both buffers were occupied or a line was longer than the buffer
+   volatile unsigned short usart_buffer_overflows_counter;
+
+   volatile unsigned int milliseconds_counter;
+   PollCycleStatistics current_poll_cycle;
+   PollCycleStatistics last_poll_cycle;
+   volatile unsigned short poll_cycle_received_bytes;
+
+   // Ring buffer of the last events
+   DeviceEventRecord device_events[DEVICE_EVENTS_SIZE];
+   unsigned char device_events_index;
+   unsigned char device_events_amount;
+   unsigned int logged_general_flags;
+   unsigned short polls_completed_counter;
+   unsigned short device_state_resets_counter;
+   // Bucket "i" contains latencies up to 2^i milliseconds. Long polling requests aren't included
+   unsigned short command_latency_histogram[COMMAND_LATENCY_HISTOGRAM_SIZE];
+   unsigned int command_sent_timestamp_ms;
+   unsigned char command_latency_measured;
+
+   // Recovery is finished by the first successful long polling request after a fault
+   FaultRecoveryStatistics fault_recoveries[FAULT_CLASSES_SIZE];
+   unsigned char fault_recovery_in_progress;
+   FaultClass first_fault_class;
+   unsigned int first_fault_timestamp_ms;
+
+   RecoveryStepStatistics recovery_steps[RECOVERY_STEPS_SIZE];
+   RecoveryStep next_recovery_step;
+   // The last taken step is credited when the long polling succeeds
+   RecoveryStep taken_recovery_step;
+   unsigned char recovery_step_in_progress;
+   unsigned int recovery_step_timestamp_ms;
+
+   // Ring buffer of the last long polling requests traces
+   Trace traces[TRACES_SIZE];
+   unsigned char traces_index;
+   volatile unsigned char payload_is_being_sent;
+   volatile unsigned int usart_frame_start_timestamp_ms;
+   volatile unsigned int usart_frame_handed_over_timestamp_us;
+   // From the last response byte till the relay GPIO edge
+   unsigned int relay_actuation_time_us;
+   unsigned int max_relay_actuation_time_us;
+
+   CommandClassTimeout command_class_timeouts[COMMAND_CLASSES_SIZE];
+   CommandClass scheduled_command_class;
+   // The scheduled command has been sent again after a timeout, so its response time is ambiguous (Karn's algorithm)
+   unsigned char scheduled_command_resent;
+   unsigned int random_number_seed;
+
+   unsigned int verified_settings;
+   // The verified configuration has been found in the flash, so the verification is postponed after the first poll
+   unsigned char warm_boot;
+   // Since SysTick start. 0 - no successful poll yet
+   unsigned int first_poll_time_ms;
+   ResetCause reset_cause;
+
+   // The last accepted local control command
+   unsigned int local_control_sequence;
+   unsigned short local_control_commands_counter;
+   unsigned short rejected_local_control_commands_counter;
+
+   LongPollingWait long_polling_wait;
+   unsigned int long_polling_wait_start_ms;
+   unsigned int long_polling_wait_timeout_ms;
+   // Commands sent while the long polling request has been held by the server
+   unsigned short commands_during_long_polling_counter;
+   unsigned short server_ping_time_ms;
+   unsigned short server_ping_failures_counter;
+   LinkStatus link_status;
+   // CIPSTART hasn't been sent because the server link was still open
+   unsigned short skipped_connections_counter;
+
+   unsigned char esp8266_is_starting;
+   unsigned int esp8266_enabled_timestamp_ms;
+   unsigned int esp8266_last_start_time_ms;
+   // Sum of the time saved against ESP8266_START_TIMEOUT_MS by "ready" detection
+   unsigned int esp8266_saved_start_time_ms;
+   // Starts without "ready" which waited the whole ESP8266_START_TIMEOUT_MS
+   unsigned short esp8266_start_timeouts;
+
+   // Initialization is measured from ATE0 till the long polling request preparation
+   unsigned char initialization_in_progress;
+   unsigned int initialization_start_timestamp_ms;
+   unsigned int last_initialization_time_ms;
+   // Tasks sent right after the previous response without waiting for the next loop turn
+   unsigned short chained_tasks_counter;
+   // CIPSEND arms the USART ISR to start the payload DMA as soon as ">" is received, without waiting for the idle gap and the main loop
+   volatile unsigned char payload_armed_for_prompt;
+   volatile unsigned char payload_sent_on_prompt;
+   unsigned short payloads_sent_on_prompt_counter;
+   // From the long polling request preparation till its payload DMA start
+   unsigned int poll_decided_timestamp_us;
+   volatile unsigned int request_on_wire_time_us;
+
+   unsigned int usart_baud_rate;
+   // Index of the next escalated baud rate to try. USART_ESCALATED_BAUD_RATES_SIZE - all of them have failed
+   unsigned char usart_escalated_baud_rate_index;
+   // The errors counter at the start of the current window
+   unsigned short usart_escalated_baud_rate_errors_baseline;
+   volatile unsigned short usart_escalated_baud_rate_errors_window_timer;
+   unsigned char usart_escalated_baud_rate_probes;
+
+   // The last status the server has responded "OK" on and the status being sent now
+   StatusSnapshot acknowledged_status;
+   StatusSnapshot sent_status;
+   // Of the last status ESP8266 has sent. The status being sent carries the next one, a status that hasn't been sent is generated
+   // again with the same sequence
+   unsigned short status_sequence;
+   // Debug info is sent only when something has been changed or every "debug_info_polls_interval" polls. 0 - only on changes
+   unsigned char debug_info_polls_interval;
+   unsigned char polls_without_debug_info;
+   // Sent with the next debug info
+   DebugInfoSection debug_info_section;
+
+   // The ISR receives into one buffer while the main loop parses the other one
+   char usart_data_received_buffers[USART_DATA_RECEIVED_BUFFERS_AMOUNT][USART_DATA_RECEIVED_BUFFER_SIZE];
+} DeviceContext;
+
+// Linker script symbols: .data, .bss, the heap start and the stack top
+extern char _sdata[], _edata[], _sbss[], _ebss[], _end[], _eram[];
+// The last flash page reserved by the linker script
+extern char _verified_config_page[];
+// Current heap break from the C library system calls. The heap never shrinks, so it's also the heap high-water mark
+extern void *_sbrk(int increment);
+
+// The whole device state. Host simulations can run several instances switching "device_g" between them
+DeviceContext device_context_g;
+DeviceContext *device_g = &device_context_g;
+RecoveryRecord recovery_record_g __attribute__ ((section(".noinit")));
+
+// The constants are kept in the flash. Every one has its own section, so the linker drops the ones of the disabled options
+char USART_OK[] __attribute__ ((section(".text.const.USART_OK"))) = "OK";
+char USART_ERROR[] __attribute__ ((section(".text.const.USART_ERROR"))) = "ERROR";
+char USART_ERROR_FRAME[] __attribute__ ((section(".text.const.USART_ERROR_FRAME"))) = "\r\nERROR\r\n";
+char ESP8226_REQUEST_DISABLE_ECHO[] __attribute__ ((section(".text.const.ESP8226_REQUEST_DISABLE_ECHO"))) = "ATE0\r\n";
+char ESP8226_REQUEST_SET_CURRENT_UART_CONFIGURATION[] __attribute__ ((section(".text.const.ESP8226_REQUEST_SET_CURRENT_UART_CONFIGURATION"))) = "AT+UART_CUR=<1>,8,1,0,0\r\n";
+char ESP8226_REQUEST_PROBE[] __attribute__ ((section(".text.const.ESP8226_REQUEST_PROBE"))) = "AT\r\n";
+char ESP8226_REQUEST_SOFT_RESET[] __attribute__ ((section(".text.const.ESP8226_REQUEST_SOFT_RESET"))) = "AT+RST\r\n";
+char ESP8226_RESPONSE_READY[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_READY"))) = "ready";
+char ESP8226_RESPONSE_BUSY[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_BUSY"))) = "busy";
+char ESP8226_REQUEST_GET_VISIBLE_NETWORK_LIST[] __attribute__ ((section(".text.const.ESP8226_REQUEST_GET_VISIBLE_NETWORK_LIST"))) = "AT+CWLAP\r\n";
+char ESP8226_RESPONSE_VISIBLE_NETWORK_LIST_PREFIX[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_VISIBLE_NETWORK_LIST_PREFIX"))) = "+CWLAP:";
+char ESP8226_REQUEST_GET_AP_CONNECTION_STATUS[] __attribute__ ((section(".text.const.ESP8226_REQUEST_GET_AP_CONNECTION_STATUS"))) = "AT+CWJAP?\r\n";
+char ESP8226_RESPONSE_NOT_CONNECTED_STATUS[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_NOT_CONNECTED_STATUS"))) = "No AP";
+char ESP8226_REQUEST_CONNECT_TO_NETWORK_AND_SAVE[] __attribute__ ((section(".text.const.ESP8226_REQUEST_CONNECT_TO_NETWORK_AND_SAVE"))) = "AT+CWJAP_DEF=\"<1>\",\"<2>\"\r\n";
+char ESP8226_REQUEST_GET_VERSION_ID[] __attribute__ ((section(".text.const.ESP8226_REQUEST_GET_VERSION_ID"))) = "AT+GMR\r\n";
+char ESP8226_RESPONSE_CONNECTED[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_CONNECTED"))) = "CONNECT";
+char ESP8226_RESPONSE_CLOSED[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_CLOSED"))) = "CLOSED";
+char ESP8226_CONNECTION_CLOSED[] __attribute__ ((section(".text.const.ESP8226_CONNECTION_CLOSED"))) = "CLOSED\r\n\r\nOK";
+char ESP8226_REQUEST_CONNECT_TO_SERVER[] __attribute__ ((section(".text.const.ESP8226_REQUEST_CONNECT_TO_SERVER"))) = "AT+CIPSTART=" SERVER_LINK_ID_PARAMETER "\"TCP\",\"<1>\",<2>\r\n";
+char ESP8226_REQUEST_DISCONNECT_FROM_SERVER[] __attribute__ ((section(".text.const.ESP8226_REQUEST_DISCONNECT_FROM_SERVER"))) = "AT+CIPCLOSE" SERVER_LINK_ID_ASSIGNMENT "\r\n";
+char ESP8226_REQUEST_SET_MULTIPLE_CONNECTIONS[] __attribute__ ((section(".text.const.ESP8226_REQUEST_SET_MULTIPLE_CONNECTIONS"))) = "AT+CIPMUX=1\r\n";
+char ESP8226_REQUEST_GET_LINK_STATUS[] __attribute__ ((section(".text.const.ESP8226_REQUEST_GET_LINK_STATUS"))) = "AT+CIPSTATUS\r\n";
+char ESP8226_RESPONSE_LINK_STATUS_PREFIX[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_LINK_STATUS_PREFIX"))) = "STATUS:";
+char ESP8226_RESPONSE_SERVER_LINK_STATUS[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_SERVER_LINK_STATUS"))) = "+CIPSTATUS:" SERVER_LINK_ID_PARAMETER;
+char ESP8226_REQUEST_START_LOCAL_CONTROL_SERVER[] __attribute__ ((section(".text.const.ESP8226_REQUEST_START_LOCAL_CONTROL_SERVER"))) = "AT+CIPSERVER=1," LOCAL_CONTROL_PORT "\r\n";
+char ESP8226_RESPONSE_LINK_DATA_PREFIX[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_LINK_DATA_PREFIX"))) = "+IPD,";
+char ESP8226_RESPONSE_SERVER_LINK_DATA_PREFIX[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_SERVER_LINK_DATA_PREFIX"))) = "+IPD," SERVER_LINK_ID_PARAMETER;
+char ESP8226_RESPONSE_SERVER_LINK_CLOSED[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_SERVER_LINK_CLOSED"))) = SERVER_LINK_ID_PARAMETER "CLOSED";
+char ESP8226_REQUEST_SERVER_PING[] __attribute__ ((section(".text.const.ESP8226_REQUEST_SERVER_PING"))) = "AT+PING=\"<1>\"\r\n";
+char ESP8226_REQUEST_START_SENDING[] __attribute__ ((section(".text.const.ESP8226_REQUEST_START_SENDING"))) = "AT+CIPSEND=" SERVER_LINK_ID_PARAMETER "<1>\r\n";
+char ESP8226_RESPONSE_START_SENDING_READY[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_START_SENDING_READY"))) = ">";
+char ESP8226_RESPONSE_SENDING[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_SENDING"))) = "busy s...";
+char ESP8226_RESPONSE_SUCCSESSFULLY_SENT[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_SUCCSESSFULLY_SENT"))) = "\r\nSEND OK\r\n";
+char ESP8226_RESPONSE_ALREADY_CONNECTED[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_ALREADY_CONNECTED"))) = "ALREADY CONNECTED";
+char ESP8226_RESPONSE_PREFIX[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_PREFIX"))) = "+IPD";
+char ESP8226_REQUEST_GET_CURRENT_DEFAULT_WIFI_MODE[] __attribute__ ((section(".text.const.ESP8226_REQUEST_GET_CURRENT_DEFAULT_WIFI_MODE"))) = "AT+CWMODE_DEF?\r\n";
+char ESP8226_RESPONSE_WIFI_MODE_PREFIX[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_WIFI_MODE_PREFIX"))) = "+CWMODE_DEF:";
+char ESP8226_RESPONSE_WIFI_STATION_MODE[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_WIFI_STATION_MODE"))) = "1";
+char ESP8226_REQUEST_SET_DEFAULT_STATION_WIFI_MODE[] __attribute__ ((section(".text.const.ESP8226_REQUEST_SET_DEFAULT_STATION_WIFI_MODE"))) = "AT+CWMODE_DEF=1\r\n";
+char ESP8226_REQUEST_GET_OWN_IP_ADDRESS[] __attribute__ ((section(".text.const.ESP8226_REQUEST_GET_OWN_IP_ADDRESS"))) = "AT+CIPSTA_DEF?\r\n";
+char ESP8226_RESPONSE_CURRENT_OWN_IP_ADDRESS_PREFIX[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_CURRENT_OWN_IP_ADDRESS_PREFIX"))) = "+CIPSTA_DEF:ip:";
+char ESP8226_REQUEST_SET_OWN_IP_ADDRESS[] __attribute__ ((section(".text.const.ESP8226_REQUEST_SET_OWN_IP_ADDRESS"))) = "AT+CIPSTA_DEF=\"<1>\"\r\n";
+char ESP8226_REQUEST_SEND_STATUS_INFO_AND_ESTABLISH_LONG_POLLING_REQUEST[] __attribute__ ((section(".text.const.ESP8226_REQUEST_SEND_STATUS_INFO_AND_ESTABLISH_LONG_POLLING_REQUEST"))) =
       "POST /server/esp8266/projectorDeferred HTTP/1.1\r\nContent-Length: <1>\r\nHost: <2>\r\nUser-Agent: ESP8266\r\nContent-Type: application/json\r\nAccept: application/json\r\nConnection: keep-alive\r\n\r\n<3>\r\n";
-char DEBUG_STATUS_JSON[] __attribute__ ((section(".text.const"))) =
-      "{\"gain\":\"<1>\",\"debugInfoIncluded\":<2>,\"errors\":\"<3>\",\"usartOverrunErrors\":\"<4>\",\"usartIdleLineDetections\":\"<5>\",\"usartNoiseDetection\":\"<6>\",\"usartFramingErrors\":\"<7>\",\"lastErrorTask\":\"<8>\",\"usartData\":\"<9>\",\"timeStamp\":\"<10>\",\"serverIsAvailable\":<11>,\"deviceName\":\"<12>\"}";
-char TIMESTAMP_JSON_ELEMENT[] __attribute__ ((section(".text.const"))) = "timeStamp";
-char TURN_ON_TRUE_JSON_ELEMENT[] __attribute__ ((section(".text.const"))) = "\"turnOn\":true";
-char STATUS_JSON[] __attribute__ ((section(".text.const"))) = "{\"gain\":\"<1>\",\"debugInfoIncluded\":<2>,\"timeStamp\":\"<3>\",\"serverIsAvailable\":<4>,\"deviceName\":\"<5>\"}";
-char ESP8226_RESPONSE_OK_STATUS_CODE[] __attribute__ ((section(".text.const"))) = "\"statusCode\":\"OK\"";
-char ESP8226_RESPONSE_HTTP_STATUS_200_OK[] __attribute__ ((section(".text.const"))) = "200 OK";
-char ESP8226_RESPONSE_HTTP_STATUS_400_BAD_REQUEST[] __attribute__ ((section(".text.const"))) = "HTTP/1.1 400 Bad Request";
-char SERVER_STATUS_INCLUDE_DEBUG_INFO[] __attribute__ ((section(".text.const"))) = "\"includeDebugInfo\":true";
-char JSON_OBJECT_PREFIX[] __attribute__ ((section(".text.const"))) = "{";
-char RESPONSE_CLOSED_BY_TOMCAT[] __attribute__ ((section(".text.const"))) = "\r\n+IPD,5:0\r\n\r\nCLOSED\r\n";
-char RESPONSE_CLOSED_BY_TOMCAT_PREFIX[] __attribute__ ((section(".text.const"))) = "\r\n+IPD,5:0";
-char RESPONSE_CLOSED_BY_TOMCAT_SUFFIX[] __attribute__ ((section(".text.const"))) = "CLOSED\r\n";
-char RESPONSE_SERVICE_UNAVAILABLE[] __attribute__ ((section(".text.const"))) = "503 Service Unavailable";
-
-char *usart_data_to_be_transmitted_buffer_g = NULL;
-char *received_usart_error_data_g = NULL;
-char usart_data_received_buffer_g[USART_DATA_RECEIVED_BUFFER_SIZE];
-char default_access_point_gain_g[DEFAULT_ACCESS_POINT_GAIN_SIZE] = {' ', ' ', ' ', ' '};
-volatile unsigned short usart_received_bytes_g;
-volatile unsigned int final_task_for_request_resending_g;
-
-void (*scheduled_function_to_execute_on_error_g)() = NULL;
-void (*on_response_g)() = NULL;
-volatile unsigned int send_usart_data_time_counter_g;
-volatile unsigned short send_usart_data_timout_sec_g = 0xFFFF;
-volatile unsigned char send_usart_data_errors_counter_g;
-volatile unsigned short send_usart_data_errors_unresetable_counter_g;
-volatile unsigned int last_error_task_g;
-volatile unsigned short network_searching_status_led_counter_g;
-volatile unsigned char esp8266_disabled_counter_g;
-volatile unsigned char esp8266_disabled_timer_g = TIMER14_5S;
-unsigned short checking_connection_status_and_server_availability_timer_g;
-volatile unsigned short visible_network_list_timer_g = TIMER14_10MIN;;
-volatile unsigned char resets_occured_g;
-volatile unsigned int response_timestamp_ms_g;
-volatile unsigned int response_timestamp_counter_g;
-
-volatile unsigned short usart_overrun_errors_counter_g;
-volatile unsigned short usart_idle_line_detection_counter_g;
-volatile unsigned short usart_noise_detection_counter_g;
-volatile unsigned short usart_framing_errors_counter_g;
+// <10> - <12> are the statistics of the debug info section
+char DEBUG_STATUS_JSON[] __attribute__ ((section(".text.const.DEBUG_STATUS_JSON"))) = "<1><2><3><4><5><6><7>,\"lastErrorTask\":\"<8>\",\"usartData\":\"<9>\"<10><11><12>";
+char TIMESTAMP_JSON_ELEMENT[] __attribute__ ((section(".text.const.TIMESTAMP_JSON_ELEMENT"))) = "timeStamp";
+char TURN_ON_TRUE_JSON_ELEMENT[] __attribute__ ((section(".text.const.TURN_ON_TRUE_JSON_ELEMENT"))) = "\"turnOn\":true";
+// Only changed since the last acknowledged status fields are sent: <5> - <9> are either the fields below or empty strings
+char STATUS_JSON[] __attribute__ ((section(".text.const.STATUS_JSON"))) =
+      "{\"statusSequence\":\"<1>\",\"fullStatus\":<2>,\"debugInfoIncluded\":<3>,\"deviceName\":\"<4>\"<5><6><7><8><9><10>}";
+char RSSI_JSON_FIELD[] __attribute__ ((section(".text.const.RSSI_JSON_FIELD"))) =
+      ",\"rssiDbm\":{\"last\":<1>,\"smoothed\":<2>,\"mean\":<3>,\"min\":<4>,\"max\":<5>,\"trend\":<6>,\"samples\":<7>}";
+char HEALTH_JSON_FIELD[] __attribute__ ((section(".text.const.HEALTH_JSON_FIELD"))) =
+      ",\"health\":{\"supplyMv\":{\"now\":<1>,\"min\":<2>,\"max\":<3>},\"dieTemperatureC\":{\"now\":<4>,\"min\":<5>,\"max\":<6>}}";
+char NEGATIVE_NUMBER[] __attribute__ ((section(".text.const.NEGATIVE_NUMBER"))) = "-<1>";
+char GAIN_JSON_FIELD[] __attribute__ ((section(".text.const.GAIN_JSON_FIELD"))) = ",\"gain\":\"<1>\"";
+char LINK_STATUS_JSON_FIELD[] __attribute__ ((section(".text.const.LINK_STATUS_JSON_FIELD"))) = ",\"linkStatus\":<1>";
+char HEX_DIGITS[] __attribute__ ((section(".text.const.HEX_DIGITS"))) = "0123456789abcdef";
+char LOCAL_CONTROL_JSON_FIELD[] __attribute__ ((section(".text.const.LOCAL_CONTROL_JSON_FIELD"))) = ",\"localControl\":{\"sequence\":<1>,\"turnOn\":<2>}";
+char SERVER_IS_AVAILABLE_JSON_FIELD[] __attribute__ ((section(".text.const.SERVER_IS_AVAILABLE_JSON_FIELD"))) = ",\"serverIsAvailable\":<1>";
+#if REQUEST_TRACES_ENABLED
+char TIMESTAMP_JSON_FIELD[] __attribute__ ((section(".text.const.TIMESTAMP_JSON_FIELD"))) = ",\"timeStamp\":\"<1>\"";
+#endif
+char ERRORS_JSON_FIELD[] __attribute__ ((section(".text.const.ERRORS_JSON_FIELD"))) = ",\"errors\":\"<1>\"";
+char USART_OVERRUN_ERRORS_JSON_FIELD[] __attribute__ ((section(".text.const.USART_OVERRUN_ERRORS_JSON_FIELD"))) = ",\"usartOverrunErrors\":\"<1>\"";
+char USART_IDLE_LINE_DETECTIONS_JSON_FIELD[] __attribute__ ((section(".text.const.USART_IDLE_LINE_DETECTIONS_JSON_FIELD"))) = ",\"usartIdleLineDetections\":\"<1>\"";
+char USART_NOISE_DETECTION_JSON_FIELD[] __attribute__ ((section(".text.const.USART_NOISE_DETECTION_JSON_FIELD"))) = ",\"usartNoiseDetection\":\"<1>\"";
+char USART_FRAMING_ERRORS_JSON_FIELD[] __attribute__ ((section(".text.const.USART_FRAMING_ERRORS_JSON_FIELD"))) = ",\"usartFramingErrors\":\"<1>\"";
+char USART_BUFFER_OVERFLOWS_JSON_FIELD[] __attribute__ ((section(".text.const.USART_BUFFER_OVERFLOWS_JSON_FIELD"))) = ",\"usartBufferOverflows\":\"<1>\"";
+char USART_BAUD_RATE_JSON_FIELD[] __attribute__ ((section(".text.const.USART_BAUD_RATE_JSON_FIELD"))) = ",\"usartBaudRate\":\"<1>\"";
+// In the order of get_debug_counters()
+char *DEBUG_COUNTER_JSON_FIELDS[DEBUG_COUNTERS_SIZE] __attribute__ ((section(".text.const.DEBUG_COUNTER_JSON_FIELDS"))) = {ERRORS_JSON_FIELD,
+      USART_OVERRUN_ERRORS_JSON_FIELD, USART_IDLE_LINE_DETECTIONS_JSON_FIELD, USART_NOISE_DETECTION_JSON_FIELD,
+      USART_FRAMING_ERRORS_JSON_FIELD, USART_BUFFER_OVERFLOWS_JSON_FIELD, USART_BAUD_RATE_JSON_FIELD};
+#if POLL_CYCLE_STATISTICS_ENABLED
+char POLL_CYCLE_JSON_FIELD[] __attribute__ ((section(".text.const.POLL_CYCLE_JSON_FIELD"))) =
+      ",\"pollCycle\":{\"atCommands\":<1>,\"sentBytes\":<2>,\"receivedBytes\":<3>,\"allocations\":<4>,\"cpuTimeUs\":<5>}";
+#endif
+#if UPTIME_STATISTICS_ENABLED
+char UPTIME_STATISTICS_JSON_FIELD[] __attribute__ ((section(".text.const.UPTIME_STATISTICS_JSON_FIELD"))) =
+      ",\"uptimeSec\":<1>,\"pollsCompleted\":<2>,\"resets\":<3>,\"commandLatencyMs\":{\"p50\":<4>,\"p90\":<5>,\"p99\":<6>},\"events\":[<7>]";
+char DEVICE_EVENT_JSON_ELEMENT[] __attribute__ ((section(".text.const.DEVICE_EVENT_JSON_ELEMENT"))) = "<1><2>\"<3>:<4>\"";
+#endif
+#if DEVICE_STATISTICS_ENABLED
+char DEVICE_STATISTICS_JSON_FIELD[] __attribute__ ((section(".text.const.DEVICE_STATISTICS_JSON_FIELD"))) =
+      ",\"warmBoot\":<1>,\"firstPollMs\":<2>,\"esp8266Start\":{\"lastMs\":<3>,\"savedMs\":<4>,\"timeouts\":<5>},\"initializationMs\":<6>,\"resetCause\":<7>,\"warmResets\":<8>,\"watchdogResets\":<9>";
+char CONNECTION_STATISTICS_JSON_FIELD[] __attribute__ ((section(".text.const.CONNECTION_STATISTICS_JSON_FIELD"))) =
+      ",\"chainedTasks\":<1>,\"requestOnWireUs\":<2>,\"promptPayloads\":<3>,\"relayLatencyUs\":{\"last\":<4>,\"max\":<5>},\"localCommands\":{\"accepted\":<6>,\"rejected\":<7>},\"commandsDuringLongPoll\":<8>,\"serverPing\":{\"lastMs\":<9>,\"failures\":<10>},\"skippedConnections\":<11>";
+#endif
+#if FAULT_RECOVERY_STATISTICS_ENABLED
+char FAULT_RECOVERIES_JSON_FIELD[] __attribute__ ((section(".text.const.FAULT_RECOVERIES_JSON_FIELD"))) = ",\"faultRecoveries\":[<1>]";
+// Fault class:faults:recoveries:last recovery time ms:max recovery time ms
+char FAULT_RECOVERY_JSON_ELEMENT[] __attribute__ ((section(".text.const.FAULT_RECOVERY_JSON_ELEMENT"))) = "<1><2>\"<3>:<4>:<5>:<6>:<7>\"";
+#endif
+#if COMMAND_TIMEOUT_STATISTICS_ENABLED
+char COMMAND_TIMEOUTS_JSON_FIELD[] __attribute__ ((section(".text.const.COMMAND_TIMEOUTS_JSON_FIELD"))) = ",\"commandTimeouts\":[<1>]";
+// Command class:smoothed RTT ms:timeout ms:consecutive timeouts
+char COMMAND_TIMEOUT_JSON_ELEMENT[] __attribute__ ((section(".text.const.COMMAND_TIMEOUT_JSON_ELEMENT"))) = "<1><2>\"<3>:<4>:<5>:<6>\"";
+#endif
+#if RECOVERY_STEP_STATISTICS_ENABLED
+char RECOVERY_STEPS_JSON_FIELD[] __attribute__ ((section(".text.const.RECOVERY_STEPS_JSON_FIELD"))) = ",\"recoverySteps\":[<1>]";
+// Recovery step:attempts:recoveries:last recovery time ms:max recovery time ms
+char RECOVERY_STEP_JSON_ELEMENT[] __attribute__ ((section(".text.const.RECOVERY_STEP_JSON_ELEMENT"))) = "<1><2>\"<3>:<4>:<5>:<6>:<7>\"";
+#endif
+#if RAM_USAGE_STATISTICS_ENABLED
+char RAM_USAGE_JSON_FIELD[] __attribute__ ((section(".text.const.RAM_USAGE_JSON_FIELD"))) =
+      ",\"ramBytes\":{\"data\":<1>,\"bss\":<2>,\"heapMax\":<3>,\"stackMax\":<4>,\"freeMin\":<5>}";
+#endif
+#if REQUEST_TRACES_ENABLED
+char TRACES_JSON_FIELD[] __attribute__ ((section(".text.const.TRACES_JSON_FIELD"))) = ",\"traces\":[<1>]";
+// Durations of every stage since the previous one. "null" - the stage hasn't been reached
+char TRACE_JSON_ELEMENT[] __attribute__ ((section(".text.const.TRACE_JSON_ELEMENT"))) = "<1><2>[<3>,<4>,<5>,<6>,<7>,<8>,<9>,<10>]";
+char NULL_JSON_VALUE[] __attribute__ ((section(".text.const.NULL_JSON_VALUE"))) = "null";
+#endif
+char EMPTY_STRING[] __attribute__ ((section(".text.const.EMPTY_STRING"))) = "";
+char ESP8226_RESPONSE_OK_STATUS_CODE[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_OK_STATUS_CODE"))) = "\"statusCode\":\"OK\"";
+char ESP8226_RESPONSE_HTTP_STATUS_200_OK[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_HTTP_STATUS_200_OK"))) = "200 OK";
+char ESP8226_RESPONSE_HTTP_STATUS_400_BAD_REQUEST[] __attribute__ ((section(".text.const.ESP8226_RESPONSE_HTTP_STATUS_400_BAD_REQUEST"))) = "HTTP/1.1 400 Bad Request";
+char SERVER_STATUS_INCLUDE_DEBUG_INFO[] __attribute__ ((section(".text.const.SERVER_STATUS_INCLUDE_DEBUG_INFO"))) = "\"includeDebugInfo\":true";
+char DEBUG_INFO_POLLS_INTERVAL_JSON_ELEMENT[] __attribute__ ((section(".text.const.DEBUG_INFO_POLLS_INTERVAL_JSON_ELEMENT"))) = "debugInfoInterval";
+char SERVER_STATUS_FULL_STATUS_REQUIRED[] __attribute__ ((section(".text.const.SERVER_STATUS_FULL_STATUS_REQUIRED"))) = "\"fullStatusRequired\":true";
+char JSON_OBJECT_PREFIX[] __attribute__ ((section(".text.const.JSON_OBJECT_PREFIX"))) = "{";
+char RESPONSE_CLOSED_BY_TOMCAT[] __attribute__ ((section(".text.const.RESPONSE_CLOSED_BY_TOMCAT"))) = "\r\n+IPD,5:0\r\n\r\nCLOSED\r\n";
+char RESPONSE_CLOSED_BY_TOMCAT_PREFIX[] __attribute__ ((section(".text.const.RESPONSE_CLOSED_BY_TOMCAT_PREFIX"))) = "\r\n+IPD,5:0";
+char RESPONSE_CLOSED_BY_TOMCAT_SUFFIX[] __attribute__ ((section(".text.const.RESPONSE_CLOSED_BY_TOMCAT_SUFFIX"))) = "CLOSED\r\n";
+char RESPONSE_SERVICE_UNAVAILABLE[] __attribute__ ((section(".text.const.RESPONSE_SERVICE_UNAVAILABLE"))) = "503 Service Unavailable";
+
+// From the fastest one
+unsigned int USART_ESCALATED_BAUD_RATES[USART_ESCALATED_BAUD_RATES_SIZE] __attribute__ ((section(".text.const.USART_ESCALATED_BAUD_RATES"))) = {921600, 460800};
+CommandClassTimeoutBounds COMMAND_CLASS_TIMEOUT_BOUNDS[COMMAND_CLASSES_SIZE] __attribute__ ((section(".text.const.COMMAND_CLASS_TIMEOUT_BOUNDS"))) = {
+      {100, 2000}, {200, 5000}, {500, 10000}, {1000, 20000}, {330000, 330000}, {5000, 10000}
+};
+
 
 char *malloc_addresses_g[MALLOC_ADDRESSES_SIZE];
 unsigned int malloc_size_to_be_allocated_g;
 unsigned int malloc_invoked_function_address_g;
 
+void init_device_context(DeviceContext *device);
 void IWDG_Config();
 void Clock_Config();
 void Pins_Config();
 void TIMER3_Confing();
 void TIMER14_Confing();
+void TIMER1_Confing();
+void ADC_Config();
+void update_health_measurements();
+void *get_health_measurements();
+void SysTick_Timer_Config();
+unsigned int get_microseconds();
+void start_poll_cycle();
+void *get_poll_cycle_statistics();
+void *counted_malloc(unsigned int size);
+void add_device_event(DeviceEvent event);
+void add_general_flags_events();
+void add_command_latency(unsigned int sent_task);
+unsigned int get_command_latency_percentile(unsigned char percentile);
+void *get_uptime_statistics();
+void *get_device_statistics();
+void *get_connection_statistics();
+void add_fault(FaultClass fault_class);
+FaultClass get_response_fault_class();
+void finish_fault_recovery();
+void *get_fault_recoveries();
+void take_next_recovery_step();
+void finish_recovery_step();
+void *get_recovery_steps();
+void paint_free_ram();
+unsigned int *get_heap_break();
+void *get_ram_usage();
+void add_esp8266_initialization_tasks();
+void check_esp8266_ready();
+void finish_esp8266_start(unsigned char ready_received);
+unsigned int get_settings_checksum();
+unsigned int add_to_checksum(unsigned int checksum, void *data, unsigned short length);
+unsigned char is_verified_configuration_valid();
+void add_verified_setting(unsigned int verified_setting);
+void write_pending_configuration_page();
+void write_configuration_page(unsigned short verified_settings, unsigned int local_control_sequence);
+void unlock_flash();
+ResetCause get_reset_cause();
+unsigned int get_recovery_record_checksum();
+void restore_recovery_record();
+void save_recovery_record();
+void erase_flash_page(unsigned int page_address);
+void write_flash_half_word(unsigned int address, unsigned short data);
+unsigned char handle_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
+void send_chained_task();
 unsigned char handle_disable_echo_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
 unsigned char handle_get_connection_status_and_connect_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
 unsigned char handle_get_connection_status_task(unsigned int current_piped_task_to_send, unsigned int *sent_flag);
 unsigned char handle_connect_to_network_task(unsigned int current_piped_task_to_send, unsigned int *sent_flag);
+unsigned char handle_set_usart_baud_rate_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
+unsigned char handle_probe_usart_baud_rate_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
+unsigned char handle_soft_reset_esp8266_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
+unsigned char handle_set_multiple_connections_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
+unsigned char handle_get_server_availability_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
+unsigned char handle_get_link_status_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
+unsigned char handle_start_local_control_server_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
 unsigned char handle_connect_to_server_task(unsigned int current_piped_task_to_send, unsigned int *sent_flag);
 unsigned char handle_set_bytes_to_send_in_request_task(unsigned int current_piped_task_to_send, unsigned int *sent_flag);
 unsigned char handle_get_current_default_wifi_mode_task(unsigned int current_piped_task_to_send, unsigned int *sent_flag);
@@ -210,22 +892,65 @@ unsigned char handle_get_visible_network_list_task(unsigned int current_piped_ta
 unsigned char handle_establish_long_polling_connection_task(unsigned int current_piped_task_to_send);
 unsigned char handle_establish_long_polling_connection_request_task(unsigned int current_piped_task_to_send, unsigned int *sent_task);
 void establish_long_polling_connection(unsigned int request_task);
+void handle_long_polling_response();
+void start_long_polling_wait(LongPollingWait long_polling_wait, unsigned int timeout_ms);
+unsigned char is_long_polling_response_frame();
+unsigned char take_long_polling_response_segments();
+void check_long_polling_wait();
+unsigned char update_projector_relay();
+void add_relay_actuation_time();
 void reset_device_state();
 void set_flag(unsigned int *flags, unsigned int flag_value);
 void reset_flag(unsigned int *flags, unsigned int flag_value);
 unsigned char read_flag(unsigned int *flags, unsigned int flag_value);
 void DMA_Config();
 void USART_Config();
+void change_usart_baud_rate(unsigned int baud_rate);
+void set_esp8266_usart_baud_rate();
+void probe_usart_baud_rate();
+void fall_back_to_default_usart_baud_rate();
+void check_usart_baud_rate_errors();
+unsigned short get_usart_baud_rate_errors();
 void disable_echo();
+void soft_reset_esp8266();
+void set_multiple_connections();
+void ping_server();
+unsigned char get_server_ping_time(unsigned short *ping_time_ms);
+void get_link_status();
+LinkStatus get_received_link_status();
+void start_local_control_server();
+void add_local_control_server_tasks();
+unsigned char handle_local_control_frame();
+unsigned char is_local_control_link(char link_id);
+void execute_local_control_command(char *command);
+unsigned long long get_local_control_tag(char *data, unsigned short length);
+unsigned long long get_little_endian_word(char *data, unsigned char length);
+void siphash_round(unsigned long long v[]);
+unsigned int get_saved_local_control_sequence();
+unsigned char save_local_control_sequence(unsigned int sequence);
 void get_network_list();
 void connect_to_network();
 void get_ap_connection_status();
-void schedule_function_resending(void (*function_to_execute)(), unsigned short timeout, ImmediatelyFunctionExecution execute);
+void schedule_function_resending(void (*function_to_execute)(), CommandClass command_class, ImmediatelyFunctionExecution execute);
+unsigned int get_command_class_timeout(CommandClass command_class);
+unsigned int get_scheduled_command_timeout();
+void add_command_rtt_sample();
+void on_command_timeout();
+unsigned int get_random_number();
+void *get_command_timeouts();
 void send_usard_data(char string[]);
+void start_usart_dma_transmission(char string[], unsigned short bytes_to_send);
+void count_sent_usart_data(unsigned short sent_bytes);
+void check_payload_prompt();
+void send_payload_on_prompt();
 unsigned char is_usart_response_contains_elements(char *data_to_be_contained[], unsigned char elements_count);
 unsigned char is_usart_response_contains_element(char string_to_be_contained[]);
 unsigned char contains_string(char being_compared_string[], char string_to_be_contained[]);
 void clear_usart_data_received_buffer();
+void release_usart_data_received_buffer();
+void hand_over_usart_received_chunk();
+void process_received_lines();
+void on_visible_network_line(char *line);
 unsigned short get_received_data_length();
 unsigned char is_received_data_length_equal(unsigned short length);
 void *set_string_parameters(char string[], char *parameters[]);
@@ -237,12 +962,11 @@ void add_piped_task_to_send_into_tail(unsigned int task);
 void add_piped_task_to_send_into_head(unsigned int task);
 void delete_piped_task(unsigned int task);
 void on_successfully_receive_general_actions(unsigned int sent_task);
-void prepare_http_request(char address[], char port[], char request[], void (*on_response)(), unsigned int request_task);
+unsigned char prepare_http_request(char address[], char port[], char request[], void (*on_response)(), unsigned int request_task);
 void resend_usart_http_request_using_global_final_task();
 void *num_to_string(unsigned int number);
-unsigned int divide_by_10(unsigned int dividend);
-unsigned char get_first_digit(unsigned int long_digit);
-void *array_to_string(char array[], unsigned char array_length);
+void *signed_num_to_string(int number);
+void *set_number_parameters(char string[], int numbers[], unsigned char numbers_amount);
 char *get_gson_element_value(char *json_string, char *json_element_to_find);
 void connect_to_server();
 void resend_usart_http_request(unsigned int final_task);
@@ -258,47 +982,76 @@ void delete_all_piped_tasks();
 unsigned char is_piped_task_to_send_scheduled(unsigned int task);
 unsigned char is_piped_tasks_scheduler_full();
 unsigned char is_piped_tasks_scheduler_empty();
-void schedule_global_function_resending_and_send_request(unsigned int task_to_be_sent, unsigned int task_to_be_sent_in_case_of_error, unsigned short timeout);
+void schedule_global_function_resending_and_send_request(unsigned int task_to_be_sent, unsigned int task_to_be_sent_in_case_of_error, CommandClass command_class);
 char *generate_request(char *request_template);
-void *add_debug_info(char *gain, char *debug_info_included, char *response_timestamp, char *server_is_available);
+void *add_debug_info();
+void get_debug_counters(unsigned int counters[]);
+char *get_changed_status_field(char field_template[], unsigned int value, unsigned int acknowledged_value);
+char *get_status_field(char field_template[], char *value);
+void acknowledge_sent_status();
+unsigned char is_debug_info_to_be_sent();
+void save_debug_info_polls_interval();
+unsigned int string_to_num(char string[]);
 unsigned int calculate_response_timestamp();
+void start_trace();
+void add_trace_stage(TraceStage stage);
+void add_trace_stage_with_timestamp(TraceStage stage, unsigned int timestamp_ms);
+unsigned char is_trace_stage_recorded(TraceStage stage);
+void *get_traces();
 void get_own_ip_address();
 void set_own_ip_address();
 void close_connection();
 void add_error();
+void add_task_error(unsigned int task);
 void check_connection_status_and_server_availability();
 void check_visible_network_list();
 void add_piped_task_into_history(unsigned int task);
 void add_sent_task_into_history(unsigned int task);
 unsigned int get_last_piped_task_in_history();
 void *get_received_usart_error_data();
-void save_default_access_point_gain();
+void save_default_access_point_rssi(char *received_data);
+unsigned char parse_rssi(char *string, signed char *rssi_dbm);
+void add_rssi_sample(signed char rssi_dbm);
+signed char get_smoothed_rssi();
+void *get_rssi_statistics();
 char *debug_malloc(unsigned int size, unsigned int invoked_function);
 void debug_free(char *memory_location_to_free);
 void add_debug_malloc_address(char *allocated_memory_location);
 void remove_debug_malloc_address(char *freed_memory_location);
 
 void SysTick_Handler() {
+   device_g->milliseconds_counter++;
 }
 
 void DMA1_Channel2_3_IRQHandler() {
    DMA_ClearITPendingBit(DMA1_IT_TC2);
+
+   if (device_g->payload_is_being_sent) {
+      device_g->payload_is_being_sent = 0;
+      add_trace_stage(PAYLOAD_SENT_STAGE);
+   }
 }
 
 void TIM14_IRQHandler() {
    TIM_ClearITPendingBit(TIM14, TIM_IT_Update);
 
-   if (visible_network_list_timer_g) {
-      visible_network_list_timer_g--;
+   if (device_g->visible_network_list_timer) {
+      device_g->visible_network_list_timer--;
+   }
+   if (device_g->checking_connection_status_and_server_availability_timer) {
+      device_g->checking_connection_status_and_server_availability_timer--;
    }
-   if (checking_connection_status_and_server_availability_timer_g) {
-      checking_connection_status_and_server_availability_timer_g--;
+   if (device_g->usart_escalated_baud_rate_errors_window_timer) {
+      device_g->usart_escalated_baud_rate_errors_window_timer--;
+   }
+   if (device_g->health_measurement_timer) {
+      device_g->health_measurement_timer--;
    }
    if (!is_esp8266_enabled(0)) {
-      esp8266_disabled_counter_g++;
+      device_g->esp8266_disabled_counter++;
    }
-   if (esp8266_disabled_timer_g) {
-      esp8266_disabled_timer_g--;
+   if (device_g->esp8266_disabled_timer) {
+      device_g->esp8266_disabled_timer--;
    }
 }
 
@@ -306,14 +1059,50 @@ void TIM3_IRQHandler() {
    TIM_ClearITPendingBit(TIM3, TIM_IT_Update);
 
    // Some error eventually occurs when only the first symbol exists
-   if (usart_received_bytes_g > 1) {
-      set_flag(&general_flags_g, USART_DATA_RECEIVED_FLAG);
+   if (device_g->usart_received_bytes == 1) {
+      device_g->usart_received_bytes = 0;
+      device_g->usart_received_line_end_bytes = 0;
+   } else if (device_g->usart_received_bytes > 1 && !device_g->usart_data_received) {
+      // The frame is handed over and the next one is received into the other buffer. While the main loop is still busy with the
+      // previous frame, the received data stays here and is handed over on the next period
+      char *received_buffer = device_g->usart_data_received_buffers[device_g->usart_receiving_buffer_index];
+
+      received_buffer[device_g->usart_received_bytes] = '\0';
+      device_g->usart_data_received_buffer = received_buffer;
+      device_g->usart_data_received_length = device_g->usart_received_bytes;
+      device_g->usart_data_received_is_chunk = 0;
+      device_g->usart_frame_handed_over_timestamp_us = get_microseconds();
+      device_g->usart_receiving_buffer_index = device_g->usart_receiving_buffer_index == 0 ? 1 : 0;
+      device_g->usart_received_bytes = 0;
+      device_g->usart_received_line_end_bytes = 0;
+      device_g->usart_data_received = 1;
    }
-   usart_received_bytes_g = 0;
-   if (scheduled_function_to_execute_on_error_g != NULL) {
-      send_usart_data_time_counter_g++;
+   device_g->network_searching_status_led_counter++;
+}
+
+/**
+ * The full receiving buffer is handed over till the end of its last line. The incomplete line is moved into the other buffer
+ * and continues there
+ */
+void hand_over_usart_received_chunk() {
+   char *received_buffer = device_g->usart_data_received_buffers[device_g->usart_receiving_buffer_index];
+   unsigned char next_receiving_buffer_index = device_g->usart_receiving_buffer_index == 0 ? 1 : 0;
+   char *next_receiving_buffer = device_g->usart_data_received_buffers[next_receiving_buffer_index];
+   unsigned short line_end_bytes = device_g->usart_received_line_end_bytes;
+   unsigned short incomplete_line_bytes = device_g->usart_received_bytes - line_end_bytes;
+
+   for (unsigned short i = 0; i < incomplete_line_bytes; i++) {
+      next_receiving_buffer[i] = received_buffer[line_end_bytes + i];
    }
-   network_searching_status_led_counter_g++;
+   received_buffer[line_end_bytes] = '\0';
+
+   device_g->usart_data_received_buffer = received_buffer;
+   device_g->usart_data_received_length = line_end_bytes;
+   device_g->usart_data_received_is_chunk = 1;
+   device_g->usart_receiving_buffer_index = next_receiving_buffer_index;
+   device_g->usart_received_bytes = incomplete_line_bytes;
+   device_g->usart_received_line_end_bytes = 0;
+   device_g->usart_data_received = 1;
 }
 
 void EXTI0_1_IRQHandler() {
@@ -326,87 +1115,147 @@ void EXTI4_15_IRQHandler() {
 void USART1_IRQHandler() {
    if (USART_GetFlagStatus(USART1, USART_FLAG_RXNE) == SET) {
       TIM_SetCounter(TIM3, 0);
-      usart_data_received_buffer_g[usart_received_bytes_g] = USART_ReceiveData(USART1);
-      usart_received_bytes_g++;
 
-      if (usart_received_bytes_g >= USART_DATA_RECEIVED_BUFFER_SIZE) {
-         usart_received_bytes_g = 0;
+      if (device_g->usart_received_bytes == 0) {
+         device_g->usart_frame_start_timestamp_ms = device_g->milliseconds_counter;
+      }
+      if (device_g->usart_received_bytes >= USART_DATA_RECEIVED_BUFFER_SIZE - 1 && !device_g->usart_data_received &&
+            device_g->usart_received_line_end_bytes) {
+         hand_over_usart_received_chunk();
+      }
+
+      char received_character = USART_ReceiveData(USART1);
+      if (POLL_CYCLE_STATISTICS_ENABLED) {
+         device_g->poll_cycle_received_bytes++;
+      }
+
+      if (device_g->usart_received_bytes >= USART_DATA_RECEIVED_BUFFER_SIZE - 1) {
+         device_g->usart_buffer_overflows_counter++;
+      } else {
+         device_g->usart_data_received_buffers[device_g->usart_receiving_buffer_index][device_g->usart_received_bytes] = received_character;
+         device_g->usart_received_bytes++;
+
+         if (received_character == '\n') {
+            device_g->usart_received_line_end_bytes = device_g->usart_received_bytes;
+         } else if (PAYLOAD_ON_PROMPT_ENABLED && device_g->payload_armed_for_prompt) {
+            check_payload_prompt();
+         }
       }
    }
 
    if (USART_GetFlagStatus(USART1, USART_FLAG_ORE)) {
       USART_ClearITPendingBit(USART1, USART_IT_ORE);
       USART_ClearFlag(USART1, USART_FLAG_ORE);
-      usart_overrun_errors_counter_g++;
+      device_g->usart_overrun_errors_counter++;
    } else if (USART_GetFlagStatus(USART1, USART_FLAG_IDLE)) {
       USART_ClearITPendingBit(USART1, USART_IT_ORE);
       USART_ClearFlag(USART1, USART_FLAG_IDLE);
-      usart_idle_line_detection_counter_g++;
+      device_g->usart_idle_line_detection_counter++;
    } else if (USART_GetFlagStatus(USART1, USART_FLAG_NE)) {
       USART_ClearITPendingBit(USART1, USART_IT_ORE);
       USART_ClearFlag(USART1, USART_FLAG_NE);
-      usart_noise_detection_counter_g++;
+      device_g->usart_noise_detection_counter++;
    } else if (USART_GetFlagStatus(USART1, USART_FLAG_FE)) {
       USART_ClearITPendingBit(USART1, USART_IT_ORE);
       USART_ClearFlag(USART1, USART_FLAG_FE);
-      usart_framing_errors_counter_g++;
+      device_g->usart_framing_errors_counter++;
    }
 }
 
 int main() {
+#if RAM_USAGE_STATISTICS_ENABLED
+   paint_free_ram();
+#endif
+   init_device_context(device_g);
    RCC_APB2PeriphClockCmd(RCC_APB2Periph_DBGMCU, ENABLE);
    IWDG_Config();
    Clock_Config();
    Pins_Config();
+   // Before any network activity
+   restore_recovery_record();
    disable_esp8266();
    DMA_Config();
    USART_Config();
+   ADC_Config();
+   TIMER1_Confing();
    TIMER3_Confing();
    TIMER14_Confing();
+   SysTick_Timer_Config();
+   add_device_event(DEVICE_STARTED_EVENT);
+
+   device_g->warm_boot = is_verified_configuration_valid();
 
    add_piped_task_to_send_into_tail(DISABLE_ECHO_TASK);
-   add_piped_task_to_send_into_tail(GET_CURRENT_DEFAULT_WIFI_MODE_TASK);
-   add_piped_task_to_send_into_tail(GET_OWN_IP_ADDRESS_TASK);
-   add_piped_task_to_send_into_tail(GET_AP_CONNECTION_STATUS_AND_CONNECT_TASK);
-   add_piped_task_to_send_into_tail(GET_VISIBLE_NETWORK_LIST_TASK);
-   add_piped_task_to_send_into_tail(ESTABLISH_LONG_POLLING_CONNECTION_TASK);
+   if (USART_BAUD_RATE_ESCALATION_ENABLED) {
+      add_piped_task_to_send_into_tail(SET_USART_BAUD_RATE_TASK);
+   }
+   add_local_control_server_tasks();
+   if (device_g->warm_boot) {
+      add_piped_task_to_send_into_tail(GET_AP_CONNECTION_STATUS_AND_CONNECT_TASK);
+      add_piped_task_to_send_into_tail(ESTABLISH_LONG_POLLING_CONNECTION_TASK);
+      // Verified lazily while the first long polling request is being held by the server
+      add_piped_task_to_send_into_tail(GET_CURRENT_DEFAULT_WIFI_MODE_TASK);
+      add_piped_task_to_send_into_tail(GET_OWN_IP_ADDRESS_TASK);
+      add_piped_task_to_send_into_tail(GET_VISIBLE_NETWORK_LIST_TASK);
+   } else {
+      add_piped_task_to_send_into_tail(GET_CURRENT_DEFAULT_WIFI_MODE_TASK);
+      add_piped_task_to_send_into_tail(GET_OWN_IP_ADDRESS_TASK);
+      add_piped_task_to_send_into_tail(GET_AP_CONNECTION_STATUS_AND_CONNECT_TASK);
+      add_piped_task_to_send_into_tail(GET_VISIBLE_NETWORK_LIST_TASK);
+      add_piped_task_to_send_into_tail(ESTABLISH_LONG_POLLING_CONNECTION_TASK);
+   }
 
-   set_flag(&general_flags_g, SEND_DEBUG_INFO_FLAG);
+   set_flag(&device_g->general_flags, SEND_DEBUG_INFO_FLAG);
+   set_flag(&device_g->general_flags, FULL_STATUS_REQUIRED_FLAG);
 
    while (1) {
       if (is_esp8266_enabled(1)) {
-         // Seconds
-         unsigned short send_usart_data_passed_time_sec = (unsigned short) (TIMER3_SEC_PER_PERIOD * send_usart_data_time_counter_g);
-         unsigned int sent_task = 0;
+         if (device_g->esp8266_is_starting) {
+            finish_esp8266_start(0);
+         }
 
-         if (read_flag(&general_flags_g, USART_DATA_RECEIVED_FLAG)) {
-            reset_flag(&general_flags_g, USART_DATA_RECEIVED_FLAG);
+         unsigned int send_usart_data_passed_time_ms = device_g->milliseconds_counter - device_g->command_sent_timestamp_ms;
+         unsigned int sent_task = 0;
+         unsigned char usart_data_received = device_g->usart_data_received;
 
-            if (usart_data_to_be_transmitted_buffer_g != NULL) {
-               free(usart_data_to_be_transmitted_buffer_g);
-               usart_data_to_be_transmitted_buffer_g = NULL;
+         if (usart_data_received) {
+            process_received_lines();
+         }
+         if (usart_data_received && !device_g->usart_data_received_is_chunk && !(LOCAL_CONTROL_ENABLED && handle_local_control_frame())) {
+            if (device_g->usart_data_to_be_transmitted_buffer != NULL) {
+               free(device_g->usart_data_to_be_transmitted_buffer);
+               device_g->usart_data_to_be_transmitted_buffer = NULL;
             }
 
-            /*if (is_string_starts_with(usart_data_received_buffer_g, RESPONSE_CLOSED_BY_TOMCAT_PREFIX)
-                  || is_string_starts_with(usart_data_received_buffer_g, RESPONSE_CLOSED_BY_TOMCAT_SUFFIX)) {
-               is_string_starts_with(usart_data_received_buffer_g, RESPONSE_CLOSED_BY_TOMCAT_PREFIX);
+            /*if (is_string_starts_with(device_g->usart_data_received_buffer, RESPONSE_CLOSED_BY_TOMCAT_PREFIX)
+                  || is_string_starts_with(device_g->usart_data_received_buffer, RESPONSE_CLOSED_BY_TOMCAT_SUFFIX)) {
+               is_string_starts_with(device_g->usart_data_received_buffer, RESPONSE_CLOSED_BY_TOMCAT_PREFIX);
             } else {
-               sent_task = sent_task_g;
+               sent_task = device_g->sent_task;
             }*/
-            sent_task = sent_task_g;
-         } else if (scheduled_function_to_execute_on_error_g != NULL && send_usart_data_passed_time_sec >= send_usart_data_timout_sec_g) {
-            if (usart_data_to_be_transmitted_buffer_g != NULL) {
-               free(usart_data_to_be_transmitted_buffer_g);
-               usart_data_to_be_transmitted_buffer_g = NULL;
+            if (!(is_long_polling_response_frame() && take_long_polling_response_segments())) {
+               sent_task = device_g->sent_task;
+               add_command_latency(sent_task);
+            }
+         } else if (device_g->scheduled_function_to_execute_on_error != NULL && send_usart_data_passed_time_ms >= device_g->send_usart_data_timeout_ms) {
+            if (device_g->usart_data_to_be_transmitted_buffer != NULL) {
+               free(device_g->usart_data_to_be_transmitted_buffer);
+               device_g->usart_data_to_be_transmitted_buffer = NULL;
             }
 
-            scheduled_function_to_execute_on_error_g();
+            add_fault(RESPONSE_TIMEOUT_FAULT);
+            on_command_timeout();
+            device_g->scheduled_function_to_execute_on_error();
          }
 
+         check_long_polling_wait();
+
          unsigned int current_piped_task_to_send = get_current_piped_task_to_send();
 
          if (current_piped_task_to_send || sent_task) {
-            if (sent_task || scheduled_function_to_execute_on_error_g != NULL) {
+            unsigned int handling_start_us = POLL_CYCLE_STATISTICS_ENABLED ? get_microseconds() : 0;
+
+            if (sent_task || device_g->scheduled_function_to_execute_on_error != NULL) {
                current_piped_task_to_send = 0;
             }
 
@@ -417,59 +1266,31 @@ int main() {
                add_sent_task_into_history(sent_task);
             }*/
 
-            unsigned char not_handled = 1;
-            not_handled = handle_disable_echo_task(current_piped_task_to_send, &sent_task);
+            unsigned char not_handled = handle_task(current_piped_task_to_send, &sent_task);
 
-            if (not_handled) {
-               not_handled = handle_get_connection_status_and_connect_task(current_piped_task_to_send, &sent_task);
-            }
-            if (not_handled) {
-               not_handled = handle_get_connection_status_task(current_piped_task_to_send, &sent_task);
-            }
-            if (not_handled) {
-               not_handled = handle_connect_to_network_task(current_piped_task_to_send, &sent_task);
-            }
-            if (not_handled) {
-               not_handled = handle_connect_to_server_task(current_piped_task_to_send, &sent_task);
-            }
-            if (not_handled) {
-               not_handled = handle_set_bytes_to_send_in_request_task(current_piped_task_to_send, &sent_task);
-            }
-            if (not_handled) {
-               not_handled = handle_get_current_default_wifi_mode_task(current_piped_task_to_send, &sent_task);
-            }
-            if (not_handled) {
-               not_handled = handle_set_default_station_wifi_mode_task(current_piped_task_to_send, &sent_task);
-            }
-            if (not_handled) {
-               not_handled = handle_get_own_ip_address_task(current_piped_task_to_send, &sent_task);
-            }
-            if (not_handled) {
-               not_handled = handle_set_own_ip_address_task(current_piped_task_to_send, &sent_task);
-            }
-            if (not_handled) {
-               not_handled = handle_close_connection_task(current_piped_task_to_send, &sent_task);
-            }
-            if (not_handled) {
-               not_handled = handle_get_visible_network_list_task(current_piped_task_to_send, &sent_task);
+            if (current_piped_task_to_send && !not_handled) {
+               device_g->piped_tasks_history_index++;
             }
-            if (not_handled) {
-               not_handled = handle_establish_long_polling_connection_task(current_piped_task_to_send);
+            if (CHAINED_TASKS_ENABLED && sent_task) {
+               send_chained_task();
             }
-            if (not_handled) {
-               not_handled = handle_establish_long_polling_connection_request_task(current_piped_task_to_send, &sent_task);
+            if (POLL_CYCLE_STATISTICS_ENABLED) {
+               device_g->current_poll_cycle.cpu_time_us += get_microseconds() - handling_start_us;
             }
+         }
 
-            if (current_piped_task_to_send && !not_handled) {
-               piped_tasks_history_index_g++;
-            }
+         if (usart_data_received) {
+            release_usart_data_received_buffer();
          }
 
          check_visible_network_list();
+         check_connection_status_and_server_availability();
+         check_usart_baud_rate_errors();
+         add_general_flags_events();
 
          // LED blinking
-         if (!read_flag(&general_flags_g, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG) && network_searching_status_led_counter_g >= TIMER3_100MS) {
-            network_searching_status_led_counter_g = 0;
+         if (!read_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG) && device_g->network_searching_status_led_counter >= TIMER3_100MS) {
+            device_g->network_searching_status_led_counter = 0;
 
             if (GPIO_ReadOutputDataBit(NETWORK_STATUS_LED_PORT, NETWORK_STATUS_LED_PIN)) {
                GPIO_WriteBit(NETWORK_STATUS_LED_PORT, NETWORK_STATUS_LED_PIN, Bit_RESET);
@@ -478,44 +1299,159 @@ int main() {
             }
          }
 
-         if (send_usart_data_errors_counter_g >= 10 || is_piped_tasks_scheduler_full()) {
-            reset_device_state();
-         }
-         if (resets_occured_g >= 5) {
-            NVIC_SystemReset();
+         if (device_g->send_usart_data_errors_counter >= RECOVERY_STEP_MAX_ERRORS || is_piped_tasks_scheduler_full()) {
+            take_next_recovery_step();
          }
 
-         if (read_flag(&general_flags_g, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG)) {
+         if (read_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG)) {
             GPIO_WriteBit(NETWORK_STATUS_LED_PORT, NETWORK_STATUS_LED_PIN, Bit_SET);
          } else {
             GPIO_WriteBit(NETWORK_STATUS_LED_PORT, NETWORK_STATUS_LED_PIN, Bit_RESET);
          }
-         if (read_flag(&general_flags_g, SERVER_IS_AVAILABLE_FLAG)) {
+         if (read_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG)) {
             GPIO_WriteBit(SERVER_AVAILABILITI_LED_PORT, SERVER_AVAILABILITI_LED_PIN, Bit_SET);
          } else {
             GPIO_WriteBit(SERVER_AVAILABILITI_LED_PORT, SERVER_AVAILABILITI_LED_PIN, Bit_RESET);
          }
-         if (read_flag(&general_flags_g, TURN_PROJECTOR_ON) && read_flag(&general_flags_g, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG) &&
-               read_flag(&general_flags_g, SERVER_IS_AVAILABLE_FLAG)) {
-            GPIO_WriteBit(PROJECTOR_RELAY_PORT, PROJECTOR_RELAY_PIN, Bit_SET);
-         } else {
-            GPIO_WriteBit(PROJECTOR_RELAY_PORT, PROJECTOR_RELAY_PIN, Bit_RESET);
-         }
-      } else if (esp8266_disabled_counter_g >= TIMER14_1S) {
-         esp8266_disabled_counter_g = 0;
+         // The relay is switched by the response parser. This one follows the lost connection or server
+         update_projector_relay();
+         save_recovery_record();
+      } else if (is_esp8266_enabled(0)) {
+         check_esp8266_ready();
+      } else if (device_g->esp8266_disabled_counter >= TIMER14_1S) {
+         device_g->esp8266_disabled_counter = 0;
+         write_pending_configuration_page();
          enable_esp8266();
       }
+      // Also while ESP8266 is being restarted
+      update_health_measurements();
 
       IWDG_ReloadCounter();
    }
 }
 
+/**
+ * Runs the task through the handlers chain
+ *
+ * @return 0 if the task or the response has been handled
+ */
+unsigned char handle_task(unsigned int current_piped_task_to_send, unsigned int *sent_task) {
+   unsigned char not_handled = handle_disable_echo_task(current_piped_task_to_send, sent_task);
+
+   if (not_handled) {
+      not_handled = handle_get_connection_status_and_connect_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_get_connection_status_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_connect_to_network_task(current_piped_task_to_send, sent_task);
+   }
+   if (USART_BAUD_RATE_ESCALATION_ENABLED && not_handled) {
+      not_handled = handle_set_usart_baud_rate_task(current_piped_task_to_send, sent_task);
+   }
+   if (USART_BAUD_RATE_ESCALATION_ENABLED && not_handled) {
+      not_handled = handle_probe_usart_baud_rate_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_soft_reset_esp8266_task(current_piped_task_to_send, sent_task);
+   }
+   // The local control server tasks aren't added without the local control
+   if (LOCAL_CONTROL_ENABLED && not_handled) {
+      not_handled = handle_set_multiple_connections_task(current_piped_task_to_send, sent_task);
+   }
+   if (LOCAL_CONTROL_ENABLED && not_handled) {
+      not_handled = handle_start_local_control_server_task(current_piped_task_to_send, sent_task);
+   }
+   if (SERVER_PING_ENABLED && not_handled) {
+      not_handled = handle_get_server_availability_task(current_piped_task_to_send, sent_task);
+   }
+   if (LINK_STATUS_QUERY_ENABLED && not_handled) {
+      not_handled = handle_get_link_status_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_connect_to_server_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_set_bytes_to_send_in_request_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_get_current_default_wifi_mode_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_set_default_station_wifi_mode_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_get_own_ip_address_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_set_own_ip_address_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_close_connection_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_get_visible_network_list_task(current_piped_task_to_send, sent_task);
+   }
+   if (not_handled) {
+      not_handled = handle_establish_long_polling_connection_task(current_piped_task_to_send);
+   }
+   if (not_handled) {
+      not_handled = handle_establish_long_polling_connection_request_task(current_piped_task_to_send, sent_task);
+   }
+   return not_handled;
+}
+
+/**
+ * When the response has completed the sent command, the next task is sent in the same loop turn. So sequences like
+ * initialization are sent back-to-back
+ */
+void send_chained_task() {
+   if (device_g->scheduled_function_to_execute_on_error != NULL || device_g->sent_task) {
+      return;
+   }
+
+   unsigned int next_piped_task_to_send = get_current_piped_task_to_send();
+   unsigned int no_sent_task = 0;
+
+   if (!next_piped_task_to_send) {
+      return;
+   }
+
+   add_piped_task_into_history(next_piped_task_to_send);
+   if (!handle_task(next_piped_task_to_send, &no_sent_task)) {
+      device_g->piped_tasks_history_index++;
+   }
+   if (DEVICE_STATISTICS_ENABLED && device_g->chained_tasks_counter < 0xFFFF) {
+      device_g->chained_tasks_counter++;
+   }
+}
+
+/**
+ * Sets non zero initial values. The rest of the context shall be zeroed
+ */
+void init_device_context(DeviceContext *device) {
+   device->send_usart_data_timeout_ms = 0xFFFFFFFF;
+   device->usart_data_received_buffer = device->usart_data_received_buffers[1];
+   device->random_number_seed = 2463534242;
+   device->esp8266_disabled_timer = TIMER14_5S;
+   device->visible_network_list_timer = TIMER14_10MIN;
+   device->command_latency_measured = 1;
+   device->usart_baud_rate = USART_BAUD_RATE;
+   device->debug_info_polls_interval = DEFAULT_DEBUG_INFO_POLLS_INTERVAL;
+}
+
 unsigned char handle_disable_echo_task(unsigned int current_piped_task_to_send, unsigned int *sent_task) {
    unsigned char not_handled = 1;
 
    if (current_piped_task_to_send == DISABLE_ECHO_TASK) {
       not_handled = 0;
-      schedule_function_resending(disable_echo, 2, EXECUTE_FUNCTION_IMMEDIATELY);
+
+      if (!device_g->initialization_in_progress) {
+         device_g->initialization_in_progress = 1;
+         device_g->initialization_start_timestamp_ms = device_g->milliseconds_counter;
+      }
+      schedule_function_resending(disable_echo, QUICK_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_task, DISABLE_ECHO_TASK)) {
       not_handled = 0;
 
@@ -533,7 +1469,7 @@ unsigned char handle_get_connection_status_and_connect_task(unsigned int current
 
    if (current_piped_task_to_send == GET_AP_CONNECTION_STATUS_AND_CONNECT_TASK) {
       not_handled = 0;
-      schedule_function_resending(get_ap_connection_status, 2, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(get_ap_connection_status, QUICK_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_task, GET_AP_CONNECTION_STATUS_AND_CONNECT_TASK)) {
       not_handled = 0;
 
@@ -542,14 +1478,16 @@ unsigned char handle_get_connection_status_and_connect_task(unsigned int current
 
          if (is_usart_response_contains_element(DEFAULT_ACCESS_POINT_NAME)) {
             // Has already been connected
-            set_flag(&general_flags_g, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+            set_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+            save_default_access_point_rssi(device_g->usart_data_received_buffer);
          } else if (is_usart_response_contains_element(ESP8226_RESPONSE_NOT_CONNECTED_STATUS)) {
-            reset_flag(&general_flags_g, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+            reset_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+            add_fault(NETWORK_DISCONNECTED_FAULT);
             // Connect
             add_piped_task_to_send_into_head(CONNECT_TO_NETWORK_TASK);
          }
       } else {
-         reset_flag(&general_flags_g, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+         reset_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
          add_error();
       }
    }
@@ -561,7 +1499,7 @@ unsigned char handle_get_connection_status_task(unsigned int current_piped_task_
 
    if (current_piped_task_to_send == GET_CONNECTION_STATUS_TASK) {
       not_handled = 0;
-      schedule_function_resending(get_ap_connection_status, 2, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(get_ap_connection_status, QUICK_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_flag, GET_CONNECTION_STATUS_TASK)) {
       not_handled = 0;
 
@@ -570,12 +1508,13 @@ unsigned char handle_get_connection_status_task(unsigned int current_piped_task_
 
          if (is_usart_response_contains_element(DEFAULT_ACCESS_POINT_NAME)) {
             // Has already been connected
-            set_flag(&general_flags_g, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+            set_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
          } else if (is_usart_response_contains_element(ESP8226_RESPONSE_NOT_CONNECTED_STATUS)) {
-            reset_flag(&general_flags_g, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+            reset_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+            add_fault(NETWORK_DISCONNECTED_FAULT);
          }
       } else {
-         reset_flag(&general_flags_g, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+         reset_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
          add_error();
       }
    }
@@ -587,14 +1526,198 @@ unsigned char handle_connect_to_network_task(unsigned int current_piped_task_to_
 
    if (current_piped_task_to_send == CONNECT_TO_NETWORK_TASK) {
       not_handled = 0;
-      schedule_function_resending(connect_to_network, 10, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(connect_to_network, ACCESS_POINT_JOIN_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_flag, CONNECT_TO_NETWORK_TASK)) {
       not_handled = 0;
 
       if (is_usart_response_contains_element(USART_OK)) {
          on_successfully_receive_general_actions(CONNECT_TO_NETWORK_TASK);
 
-         set_flag(&general_flags_g, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+         set_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+         // The server could lose the device state while it was disconnected
+         set_flag(&device_g->general_flags, FULL_STATUS_REQUIRED_FLAG);
+      } else {
+         add_error();
+      }
+   }
+   return not_handled;
+}
+
+unsigned char handle_set_usart_baud_rate_task(unsigned int current_piped_task_to_send, unsigned int *sent_task) {
+   unsigned char not_handled = 1;
+
+   if (current_piped_task_to_send == SET_USART_BAUD_RATE_TASK) {
+      not_handled = 0;
+
+      if (device_g->usart_escalated_baud_rate_index >= USART_ESCALATED_BAUD_RATES_SIZE) {
+         // All the escalated baud rates have failed
+         delete_current_piped_task();
+      } else {
+         schedule_function_resending(set_esp8266_usart_baud_rate, QUICK_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
+      }
+   } else if (read_flag(sent_task, SET_USART_BAUD_RATE_TASK)) {
+      not_handled = 0;
+
+      if (is_usart_response_contains_element(USART_OK)) {
+         on_successfully_receive_general_actions(SET_USART_BAUD_RATE_TASK);
+
+         // ESP8266 responds "OK" with the previous baud rate and switches after that
+         change_usart_baud_rate(USART_ESCALATED_BAUD_RATES[device_g->usart_escalated_baud_rate_index]);
+         device_g->usart_escalated_baud_rate_errors_baseline = get_usart_baud_rate_errors();
+         device_g->usart_escalated_baud_rate_errors_window_timer = USART_ESCALATED_BAUD_RATE_ERRORS_WINDOW;
+         device_g->usart_escalated_baud_rate_probes = 0;
+         add_piped_task_to_send_into_head(PROBE_USART_BAUD_RATE_TASK);
+      } else {
+         // Old AT firmware doesn't support AT+UART_CUR
+         device_g->usart_escalated_baud_rate_index = USART_ESCALATED_BAUD_RATES_SIZE;
+         add_error();
+      }
+   }
+   return not_handled;
+}
+
+unsigned char handle_probe_usart_baud_rate_task(unsigned int current_piped_task_to_send, unsigned int *sent_task) {
+   unsigned char not_handled = 1;
+
+   if (current_piped_task_to_send == PROBE_USART_BAUD_RATE_TASK) {
+      not_handled = 0;
+      schedule_function_resending(probe_usart_baud_rate, QUICK_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
+   } else if (read_flag(sent_task, PROBE_USART_BAUD_RATE_TASK)) {
+      not_handled = 0;
+
+      if (is_usart_response_contains_element(USART_OK)) {
+         on_successfully_receive_general_actions(PROBE_USART_BAUD_RATE_TASK);
+      } else {
+         fall_back_to_default_usart_baud_rate();
+      }
+   }
+   return not_handled;
+}
+
+/**
+ * ESP8266 responds "OK" with the current baud rate, restarts with the default one and prints "ready" when it's started
+ */
+unsigned char handle_soft_reset_esp8266_task(unsigned int current_piped_task_to_send, unsigned int *sent_task) {
+   unsigned char not_handled = 1;
+
+   if (current_piped_task_to_send == SOFT_RESET_ESP8266_TASK) {
+      not_handled = 0;
+      schedule_function_resending(soft_reset_esp8266, LONG_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
+   } else if (read_flag(sent_task, SOFT_RESET_ESP8266_TASK)) {
+      not_handled = 0;
+
+      if (is_usart_response_contains_element(ESP8226_RESPONSE_READY)) {
+         on_successfully_receive_general_actions(SOFT_RESET_ESP8266_TASK);
+         add_esp8266_initialization_tasks();
+      } else if (is_usart_response_contains_element(USART_OK)) {
+         change_usart_baud_rate(USART_BAUD_RATE);
+      }
+      // Boot messages are skipped
+   }
+   return not_handled;
+}
+
+unsigned char handle_set_multiple_connections_task(unsigned int current_piped_task_to_send, unsigned int *sent_task) {
+   unsigned char not_handled = 1;
+
+   if (current_piped_task_to_send == SET_MULTIPLE_CONNECTIONS_TASK) {
+      not_handled = 0;
+      schedule_function_resending(set_multiple_connections, QUICK_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
+   } else if (read_flag(sent_task, SET_MULTIPLE_CONNECTIONS_TASK)) {
+      not_handled = 0;
+
+      if (is_usart_response_contains_element(USART_OK)) {
+         on_successfully_receive_general_actions(SET_MULTIPLE_CONNECTIONS_TASK);
+      } else {
+         add_error();
+      }
+   }
+   return not_handled;
+}
+
+unsigned char handle_start_local_control_server_task(unsigned int current_piped_task_to_send, unsigned int *sent_task) {
+   unsigned char not_handled = 1;
+
+   if (current_piped_task_to_send == START_LOCAL_CONTROL_SERVER_TASK) {
+      not_handled = 0;
+      schedule_function_resending(start_local_control_server, QUICK_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
+   } else if (read_flag(sent_task, START_LOCAL_CONTROL_SERVER_TASK)) {
+      not_handled = 0;
+
+      if (is_usart_response_contains_element(USART_OK)) {
+         on_successfully_receive_general_actions(START_LOCAL_CONTROL_SERVER_TASK);
+      } else {
+         add_error();
+      }
+   }
+   return not_handled;
+}
+
+/**
+ * The ping detects the unreachable server in seconds while the long polling request may be held for minutes
+ */
+unsigned char handle_get_server_availability_task(unsigned int current_piped_task_to_send, unsigned int *sent_task) {
+   unsigned char not_handled = 1;
+
+   if (current_piped_task_to_send == GET_SERVER_AVAILABILITY_TASK) {
+      not_handled = 0;
+      schedule_function_resending(ping_server, CONNECTION_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
+   } else if (read_flag(sent_task, GET_SERVER_AVAILABILITY_TASK)) {
+      not_handled = 0;
+
+      if (is_usart_response_contains_element(USART_OK) && get_server_ping_time(&device_g->server_ping_time_ms)) {
+         on_successfully_receive_general_actions(GET_SERVER_AVAILABILITY_TASK);
+
+         // The HTTP server itself is known to be alive only while it holds the request
+         if (device_g->long_polling_wait == LONG_POLLING_RESPONSE_WAIT) {
+            set_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+         }
+      } else if (is_usart_response_contains_element(USART_ERROR)) {
+         // "+timeout" and "ERROR" - the server isn't reachable, but ESP8266 is fine
+         on_successfully_receive_general_actions(GET_SERVER_AVAILABILITY_TASK);
+         reset_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+         device_g->server_ping_failures_counter++;
+      } else {
+         add_error();
+      }
+   }
+   return not_handled;
+}
+
+/**
+ * The link status decides whether CIPSTART is needed and what's to be recovered
+ */
+unsigned char handle_get_link_status_task(unsigned int current_piped_task_to_send, unsigned int *sent_task) {
+   unsigned char not_handled = 1;
+
+   if (current_piped_task_to_send == GET_LINK_STATUS_TASK) {
+      not_handled = 0;
+      schedule_function_resending(get_link_status, QUICK_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
+   } else if (read_flag(sent_task, GET_LINK_STATUS_TASK)) {
+      not_handled = 0;
+
+      LinkStatus link_status = get_received_link_status();
+
+      if (link_status != UNKNOWN_LINK_STATUS && is_usart_response_contains_element(USART_OK)) {
+         on_successfully_receive_general_actions(GET_LINK_STATUS_TASK);
+         device_g->link_status = link_status;
+
+         if (link_status == NO_WIFI_LINK_STATUS) {
+            reset_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+            reset_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+            add_fault(NETWORK_DISCONNECTED_FAULT);
+
+            if (!is_piped_task_to_send_scheduled(CONNECT_TO_NETWORK_TASK)) {
+               add_piped_task_to_send_into_head(CONNECT_TO_NETWORK_TASK);
+            }
+         } else if (link_status == CONNECTED_LINK_STATUS && is_usart_response_contains_element(ESP8226_RESPONSE_SERVER_LINK_STATUS) &&
+               is_piped_task_to_send_scheduled(CONNECT_TO_SERVER_TASK)) {
+            // CIPSTART would respond "ALREADY CONNECTED"
+            delete_piped_task(CONNECT_TO_SERVER_TASK);
+            start_trace();
+            add_trace_stage(CONNECTED_STAGE);
+            device_g->skipped_connections_counter++;
+         }
       } else {
          add_error();
       }
@@ -607,13 +1730,14 @@ unsigned char handle_connect_to_server_task(unsigned int current_piped_task_to_s
 
    if (current_piped_task_to_send == CONNECT_TO_SERVER_TASK) {
       not_handled = 0;
-      schedule_function_resending(connect_to_server, 10, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(connect_to_server, CONNECTION_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_flag, CONNECT_TO_SERVER_TASK)) {
       not_handled = 0;
 
       char *data_to_be_contained[] = {ESP8226_RESPONSE_CONNECTED, USART_OK};
       if (is_usart_response_contains_elements(data_to_be_contained, 2) || is_usart_response_contains_element(ESP8226_RESPONSE_ALREADY_CONNECTED)) {
          on_successfully_receive_general_actions(CONNECT_TO_SERVER_TASK);
+         add_trace_stage(CONNECTED_STAGE);
       } else {
          add_error();
       }
@@ -626,14 +1750,17 @@ unsigned char handle_set_bytes_to_send_in_request_task(unsigned int current_pipe
 
    if (current_piped_task_to_send == SET_BYTES_TO_SEND_IN_REQUEST_TASK) {
       not_handled = 0;
-      schedule_function_resending(set_bytes_amount_to_send, 2, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(set_bytes_amount_to_send, QUICK_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_flag, SET_BYTES_TO_SEND_IN_REQUEST_TASK)) {
       not_handled = 0;
 
       if (is_usart_response_contains_element(ESP8226_RESPONSE_START_SENDING_READY)) {
          on_successfully_receive_general_actions(SET_BYTES_TO_SEND_IN_REQUEST_TASK);
+         add_trace_stage(SEND_PROMPT_STAGE);
       } else {
          //resend_usart_get_request(GET_REQUEST_SENT_AND_RESPONSE_RECEIVED_FLAG);
+         device_g->payload_armed_for_prompt = 0;
+         device_g->payload_sent_on_prompt = 0;
          add_error();
       }
    }
@@ -645,14 +1772,16 @@ unsigned char handle_get_current_default_wifi_mode_task(unsigned int current_pip
 
    if (current_piped_task_to_send == GET_CURRENT_DEFAULT_WIFI_MODE_TASK) {
       not_handled = 0;
-      schedule_function_resending(get_current_default_wifi_mode, 2, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(get_current_default_wifi_mode, QUICK_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_flag, GET_CURRENT_DEFAULT_WIFI_MODE_TASK)) {
       not_handled = 0;
 
       if (is_usart_response_contains_element(ESP8226_RESPONSE_WIFI_MODE_PREFIX)) {
          on_successfully_receive_general_actions(GET_CURRENT_DEFAULT_WIFI_MODE_TASK);
 
-         if (!is_usart_response_contains_element(ESP8226_RESPONSE_WIFI_STATION_MODE)) {
+         if (is_usart_response_contains_element(ESP8226_RESPONSE_WIFI_STATION_MODE)) {
+            add_verified_setting(STATION_WIFI_MODE_VERIFIED_SETTING);
+         } else {
             add_piped_task_to_send_into_head(SET_DEFAULT_STATION_WIFI_MODE_TASK);
          }
       } else {
@@ -667,12 +1796,13 @@ unsigned char handle_set_default_station_wifi_mode_task(unsigned int current_pip
 
    if (current_piped_task_to_send == SET_DEFAULT_STATION_WIFI_MODE_TASK) {
       not_handled = 0;
-      schedule_function_resending(set_default_wifi_mode, 2, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(set_default_wifi_mode, SETTINGS_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_task, SET_DEFAULT_STATION_WIFI_MODE_TASK)) {
       not_handled = 0;
 
       if (is_usart_response_contains_element(USART_OK)) {
          on_successfully_receive_general_actions(SET_DEFAULT_STATION_WIFI_MODE_TASK);
+         add_verified_setting(STATION_WIFI_MODE_VERIFIED_SETTING);
       } else {
          add_error();
       }
@@ -685,7 +1815,7 @@ unsigned char handle_get_own_ip_address_task(unsigned int current_piped_task_to_
 
    if (current_piped_task_to_send == GET_OWN_IP_ADDRESS_TASK) {
       not_handled = 0;
-      schedule_function_resending(get_own_ip_address, 5, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(get_own_ip_address, SETTINGS_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_flag, GET_OWN_IP_ADDRESS_TASK)) {
       not_handled = 0;
 
@@ -695,6 +1825,8 @@ unsigned char handle_get_own_ip_address_task(unsigned int current_piped_task_to_
          unsigned char some_another_ip = !is_usart_response_contains_element(ESP8226_OWN_IP_ADDRESS);
          if (some_another_ip) {
             add_piped_task_to_send_into_head(SET_OWN_IP_ADDRESS_TASK);
+         } else {
+            add_verified_setting(OWN_IP_ADDRESS_VERIFIED_SETTING);
          }
       } else {
          add_error();
@@ -708,12 +1840,13 @@ unsigned char handle_set_own_ip_address_task(unsigned int current_piped_task_to_
 
    if (current_piped_task_to_send == SET_OWN_IP_ADDRESS_TASK) {
       not_handled = 0;
-      schedule_function_resending(set_own_ip_address, 2, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(set_own_ip_address, SETTINGS_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_flag, SET_OWN_IP_ADDRESS_TASK)) {
       not_handled = 0;
 
       if (is_usart_response_contains_element(USART_OK)) {
          on_successfully_receive_general_actions(SET_OWN_IP_ADDRESS_TASK);
+         add_verified_setting(OWN_IP_ADDRESS_VERIFIED_SETTING);
       } else {
          add_error();
       }
@@ -726,7 +1859,7 @@ unsigned char handle_close_connection_task(unsigned int current_piped_task_to_se
 
    if (current_piped_task_to_send == CLOSE_CONNECTION_TASK) {
       not_handled = 0;
-      schedule_function_resending(close_connection, 20, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(close_connection, LONG_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_flag, CLOSE_CONNECTION_TASK)) {
       not_handled = 0;
 
@@ -740,14 +1873,15 @@ unsigned char handle_get_visible_network_list_task(unsigned int current_piped_ta
 
    if (current_piped_task_to_send == GET_VISIBLE_NETWORK_LIST_TASK) {
       not_handled = 0;
-      schedule_function_resending(get_network_list, 20, EXECUTE_FUNCTION_IMMEDIATELY);
+      schedule_function_resending(get_network_list, LONG_COMMAND_CLASS, EXECUTE_FUNCTION_IMMEDIATELY);
    } else if (read_flag(sent_task, GET_VISIBLE_NETWORK_LIST_TASK)) {
       not_handled = 0;
 
-      if (is_usart_response_contains_element(ESP8226_RESPONSE_VISIBLE_NETWORK_LIST_PREFIX)) {
+      // The list is consumed line by line by on_visible_network_line()
+      if (device_g->visible_networks_received && is_usart_response_contains_element(USART_OK)) {
          on_successfully_receive_general_actions(GET_VISIBLE_NETWORK_LIST_TASK);
-         save_default_access_point_gain();
-      } else {
+         device_g->on_received_line = NULL;
+      } else if (!device_g->visible_networks_received || is_usart_response_contains_element(USART_ERROR)) {
          add_error();
       }
    }
@@ -772,335 +1906,2200 @@ unsigned char handle_establish_long_polling_connection_request_task(unsigned int
    if (current_piped_task_to_send == ESTABLISH_LONG_POLLING_CONNECTION_REQUEST_TASK) {
       not_handled = 0;
       // Part 2
-      schedule_global_function_resending_and_send_request(ESTABLISH_LONG_POLLING_CONNECTION_REQUEST_TASK, ESTABLISH_LONG_POLLING_CONNECTION_TASK, 330); // 330 - 5.5 minutes
+      schedule_global_function_resending_and_send_request(ESTABLISH_LONG_POLLING_CONNECTION_REQUEST_TASK, ESTABLISH_LONG_POLLING_CONNECTION_TASK, LONG_POLLING_COMMAND_CLASS);
    } else if (read_flag(sent_task, ESTABLISH_LONG_POLLING_CONNECTION_REQUEST_TASK)) {
       not_handled = 0;
 
-      if ((is_usart_response_contains_element(ESP8226_RESPONSE_HTTP_STATUS_200_OK) || is_usart_response_contains_element(ESP8226_RESPONSE_SUCCSESSFULLY_SENT)) &&
-            !is_usart_response_contains_element(ESP8226_RESPONSE_OK_STATUS_CODE) && !is_usart_response_contains_element(RESPONSE_SERVICE_UNAVAILABLE)) {
-         // Sometimes only "SEND OK" is received. Another data will be received later
+      // ESP8266 answers the payload with "SEND OK" or "SEND FAIL". A bare "ERROR" is a late reply to a command resent before, e.g.
+      // to the rest of the payload after a repeated CIPSEND
+      if (is_string_starts_with(device_g->usart_data_received_buffer, USART_ERROR_FRAME) &&
+            get_string_length(device_g->usart_data_received_buffer) == get_string_length(USART_ERROR_FRAME)) {
          clear_usart_data_received_buffer();
       } else {
-         if (is_usart_response_contains_element(ESP8226_RESPONSE_OK_STATUS_CODE)) {
-            on_successfully_receive_general_actions(ESTABLISH_LONG_POLLING_CONNECTION_REQUEST_TASK);
-
-            if (is_usart_response_contains_element(SERVER_STATUS_INCLUDE_DEBUG_INFO)) {
-               set_flag(&general_flags_g, SEND_DEBUG_INFO_FLAG);
-            } else {
-               reset_flag(&general_flags_g, SEND_DEBUG_INFO_FLAG);
-            }
-            if (is_usart_response_contains_element(TURN_ON_TRUE_JSON_ELEMENT)) {
-               set_flag(&general_flags_g, TURN_PROJECTOR_ON);
-            } else {
-               reset_flag(&general_flags_g, TURN_PROJECTOR_ON);
-            }
-
-            set_flag(&general_flags_g, SERVER_IS_AVAILABLE_FLAG);
-            add_piped_task_to_send_into_tail(ESTABLISH_LONG_POLLING_CONNECTION_TASK);
-         } else {
-            send_usart_data_timout_sec_g = 15; // Reset long timeout of long polling request
-
-            reset_flag(&general_flags_g, SERVER_IS_AVAILABLE_FLAG);
-            add_error();
-         }
+         handle_long_polling_response();
       }
    }
    return not_handled;
 }
 
+/**
+ * Called for the sent request and, once "SEND OK" has been received, for the server link frames received while other commands
+ * may be in progress
+ */
+void handle_long_polling_response() {
+   if (is_usart_response_contains_element(ESP8226_RESPONSE_SUCCSESSFULLY_SENT)) {
+      add_trace_stage(SEND_OK_STAGE);
+   }
+   if (is_usart_response_contains_element(ESP8226_RESPONSE_PREFIX)) {
+      add_trace_stage_with_timestamp(FIRST_RESPONSE_BYTE_STAGE, device_g->usart_frame_start_timestamp_ms);
+   }
+
+   if ((is_usart_response_contains_element(ESP8226_RESPONSE_HTTP_STATUS_200_OK) || is_usart_response_contains_element(ESP8226_RESPONSE_SUCCSESSFULLY_SENT)) &&
+         !is_usart_response_contains_element(ESP8226_RESPONSE_OK_STATUS_CODE) && !is_usart_response_contains_element(RESPONSE_SERVICE_UNAVAILABLE)) {
+      // Sometimes only "SEND OK" is received. Another data will be received later, the scheduler isn't blocked meanwhile
+      if (BACKGROUND_LONG_POLLING_ENABLED && device_g->long_polling_wait == NO_LONG_POLLING_WAIT &&
+            is_usart_response_contains_element(ESP8226_RESPONSE_SUCCSESSFULLY_SENT)) {
+         device_g->status_sequence++;
+         on_successfully_receive_general_actions(ESTABLISH_LONG_POLLING_CONNECTION_REQUEST_TASK);
+         start_long_polling_wait(LONG_POLLING_RESPONSE_WAIT, get_command_class_timeout(LONG_POLLING_COMMAND_CLASS));
+      }
+      clear_usart_data_received_buffer();
+   } else {
+      if (is_usart_response_contains_element(ESP8226_RESPONSE_OK_STATUS_CODE)) {
+         // "SEND OK" has come in the same frame
+         if (device_g->long_polling_wait == NO_LONG_POLLING_WAIT) {
+            device_g->status_sequence++;
+            on_successfully_receive_general_actions(ESTABLISH_LONG_POLLING_CONNECTION_REQUEST_TASK);
+         }
+         device_g->long_polling_wait = NO_LONG_POLLING_WAIT;
+         add_trace_stage(RESPONSE_PARSED_STAGE);
+
+         // The command is actuated before the rest of the response is handled. The server command is ignored until the server
+         // has been informed about the local one
+         if (!read_flag(&device_g->general_flags, LOCALLY_CONTROLLED_FLAG)) {
+            if (is_usart_response_contains_element(TURN_ON_TRUE_JSON_ELEMENT)) {
+               set_flag(&device_g->general_flags, TURN_PROJECTOR_ON);
+            } else {
+               reset_flag(&device_g->general_flags, TURN_PROJECTOR_ON);
+            }
+         }
+         set_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+         if (update_projector_relay()) {
+            add_relay_actuation_time();
+         }
+         add_trace_stage(RELAY_WRITTEN_STAGE);
+
+         acknowledge_sent_status();
+         if (device_g->acknowledged_status.local_control_sequence == device_g->local_control_sequence) {
+            reset_flag(&device_g->general_flags, LOCALLY_CONTROLLED_FLAG);
+         }
+         device_g->polls_completed_counter++;
+         finish_fault_recovery();
+         finish_recovery_step();
+
+         if (DEVICE_STATISTICS_ENABLED && !device_g->first_poll_time_ms) {
+            device_g->first_poll_time_ms = device_g->milliseconds_counter;
+         }
+
+         if (is_usart_response_contains_element(SERVER_STATUS_FULL_STATUS_REQUIRED)) {
+            set_flag(&device_g->general_flags, FULL_STATUS_REQUIRED_FLAG);
+         }
+         if (is_usart_response_contains_element(SERVER_STATUS_INCLUDE_DEBUG_INFO)) {
+            set_flag(&device_g->general_flags, SEND_DEBUG_INFO_FLAG);
+            save_debug_info_polls_interval();
+         } else {
+            reset_flag(&device_g->general_flags, SEND_DEBUG_INFO_FLAG);
+         }
+
+         add_piped_task_to_send_into_tail(ESTABLISH_LONG_POLLING_CONNECTION_TASK);
+      } else {
+         reset_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+
+         if (!BACKGROUND_LONG_POLLING_ENABLED || device_g->long_polling_wait == NO_LONG_POLLING_WAIT) {
+            device_g->send_usart_data_timeout_ms = LONG_POLLING_RETRY_DELAY_MS; // Reset long timeout of long polling request
+            add_error();
+         } else {
+            // The scheduled resending function and the sent task may belong to another command now
+            start_long_polling_wait(LONG_POLLING_RETRY_WAIT, LONG_POLLING_RETRY_DELAY_MS);
+            add_task_error(ESTABLISH_LONG_POLLING_CONNECTION_REQUEST_TASK);
+         }
+      }
+   }
+}
+
+void start_long_polling_wait(LongPollingWait long_polling_wait, unsigned int timeout_ms) {
+   device_g->long_polling_wait = long_polling_wait;
+   device_g->long_polling_wait_start_ms = device_g->milliseconds_counter;
+   device_g->long_polling_wait_timeout_ms = timeout_ms;
+}
+
+/**
+ * The frame of the server link while the request is held isn't a response to the command being sent, at least not entirely
+ */
+unsigned char is_long_polling_response_frame() {
+   return BACKGROUND_LONG_POLLING_ENABLED && device_g->long_polling_wait == LONG_POLLING_RESPONSE_WAIT &&
+         (is_usart_response_contains_element(ESP8226_RESPONSE_SERVER_LINK_DATA_PREFIX) ||
+         is_usart_response_contains_element(ESP8226_RESPONSE_SERVER_LINK_CLOSED));
+}
+
+/**
+ * "+IPD,4,<length>:<data>" and "4,CLOSED" are cut out of the frame and handed over to the long polling response handler one by
+ * one. The data is taken by its length, because it may contain any lines. The rest of the frame, e.g. "OK" of AT+PING sent
+ * meanwhile, stays for the sent command
+ *
+ * @return 1 if nothing but line ends is left
+ */
+unsigned char take_long_polling_response_segments() {
+   char *frame = device_g->usart_data_received_buffer;
+   char *line = frame;
+
+   while (*line != '\0') {
+      char *segment_end = NULL;
+
+      if (is_string_starts_with(line, ESP8226_RESPONSE_SERVER_LINK_DATA_PREFIX)) {
+         char *data = line + get_string_length(ESP8226_RESPONSE_SERVER_LINK_DATA_PREFIX);
+         unsigned short data_length = string_to_num(data);
+
+         while (*data >= '0' && *data <= '9') {
+            data++;
+         }
+         if (*data == ':') {
+            segment_end = data + 1;
+
+            // The rest of the data is in the next frame when the length exceeds the received bytes
+            for (; data_length && *segment_end != '\0'; data_length--) {
+               segment_end++;
+            }
+         }
+      } else if (is_string_starts_with(line, ESP8226_RESPONSE_SERVER_LINK_CLOSED)) {
+         segment_end = line + get_string_length(ESP8226_RESPONSE_SERVER_LINK_CLOSED);
+      }
+
+      if (segment_end == NULL) {
+         while (*line != '\n' && *line != '\0') {
+            line++;
+         }
+         if (*line == '\n') {
+            line++;
+         }
+         continue;
+      }
+
+      // "4,CLOSED" after the handled response only closes the link
+      if (device_g->long_polling_wait == LONG_POLLING_RESPONSE_WAIT) {
+         char segment_end_character = *segment_end;
+
+         *segment_end = '\0';
+         device_g->usart_data_received_buffer = line;
+         device_g->usart_data_received_length = segment_end - line;
+         handle_long_polling_response();
+         device_g->usart_data_received_buffer = frame;
+         *segment_end = segment_end_character;
+      }
+
+      char *rest = segment_end;
+      char *cut_segment_character = line;
+
+      do {
+         *cut_segment_character++ = *rest;
+      } while (*rest++ != '\0');
+      device_g->usart_data_received_length = cut_segment_character - frame - 1;
+   }
+
+   for (line = frame; *line != '\0'; line++) {
+      if (*line != '\r' && *line != '\n') {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+/**
+ * The request is sent again when the server hasn't responded in time or the retry delay has passed
+ */
+void check_long_polling_wait() {
+   if (!BACKGROUND_LONG_POLLING_ENABLED || device_g->long_polling_wait == NO_LONG_POLLING_WAIT ||
+         device_g->milliseconds_counter - device_g->long_polling_wait_start_ms < device_g->long_polling_wait_timeout_ms) {
+      return;
+   }
+
+   if (device_g->long_polling_wait == LONG_POLLING_RESPONSE_WAIT) {
+      add_fault(RESPONSE_TIMEOUT_FAULT);
+      reset_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+      device_g->send_usart_data_errors_counter++;
+      device_g->send_usart_data_errors_unresetable_counter++;
+   }
+   device_g->long_polling_wait = NO_LONG_POLLING_WAIT;
+   add_piped_task_to_send_into_tail(ESTABLISH_LONG_POLLING_CONNECTION_TASK);
+}
+
+/**
+ * Clears the scheduler and the parser. Tasks to be sent after that are added by the caller
+ */
 void reset_device_state() {
-   resets_occured_g++;
+   device_g->device_state_resets_counter++;
+   add_device_event(DEVICE_STATE_RESET_EVENT);
    delete_all_piped_tasks();
    clear_piped_request_commands_to_send();
    clear_usart_data_received_buffer();
-   on_response_g = NULL;
-   scheduled_function_to_execute_on_error_g = NULL;
+   device_g->on_response = NULL;
+   device_g->on_received_line = NULL;
+   device_g->scheduled_function_to_execute_on_error = NULL;
+   device_g->long_polling_wait = NO_LONG_POLLING_WAIT;
+
+   if (device_g->received_usart_error_data != NULL) {
+      free(device_g->received_usart_error_data);
+      device_g->received_usart_error_data = NULL;
+   }
+
+   device_g->sent_task = 0;
+   device_g->send_usart_data_errors_counter = 0;
+
+   set_flag(&device_g->general_flags, FULL_STATUS_REQUIRED_FLAG);
+}
+
+void take_next_recovery_step() {
+   RecoveryStep recovery_step = device_g->next_recovery_step;
+
+   // The lost Wi-Fi isn't recovered by the parser, AT or the connection steps
+   if (device_g->link_status == NO_WIFI_LINK_STATUS && recovery_step < REJOIN_NETWORK_RECOVERY_STEP) {
+      recovery_step = REJOIN_NETWORK_RECOVERY_STEP;
+      device_g->next_recovery_step = recovery_step;
+   }
+   if (device_g->next_recovery_step < SYSTEM_RESET_RECOVERY_STEP) {
+      device_g->next_recovery_step++;
+   }
+   if (RECOVERY_STEP_STATISTICS_ENABLED) {
+      RecoveryStepStatistics *recovery_step_statistics = &device_g->recovery_steps[recovery_step];
+
+      if (recovery_step_statistics->attempts < 0xFFFF) {
+         recovery_step_statistics->attempts++;
+      }
+      device_g->taken_recovery_step = recovery_step;
+      device_g->recovery_step_in_progress = 1;
+      device_g->recovery_step_timestamp_ms = device_g->milliseconds_counter;
+   }
+
+   reset_device_state();
+
+   switch (recovery_step) {
+      case RESYNC_PARSER_RECOVERY_STEP:
+         break;
+      case REISSUE_AT_RECOVERY_STEP:
+         add_piped_task_to_send_into_tail(DISABLE_ECHO_TASK);
+         break;
+      case REOPEN_CONNECTION_RECOVERY_STEP:
+         reset_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+         add_piped_task_to_send_into_tail(CLOSE_CONNECTION_TASK);
+         break;
+      case REJOIN_NETWORK_RECOVERY_STEP:
+         reset_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+         reset_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+         add_piped_task_to_send_into_tail(CONNECT_TO_NETWORK_TASK);
+         break;
+      case SOFT_RESET_ESP8266_RECOVERY_STEP:
+         reset_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+         reset_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+         // The initialization tasks are added when ESP8266 is ready
+         add_piped_task_to_send_into_tail(SOFT_RESET_ESP8266_TASK);
+         return;
+      case POWER_CYCLE_ESP8266_RECOVERY_STEP:
+         change_usart_baud_rate(USART_BAUD_RATE);
+         disable_esp8266();
+         add_esp8266_initialization_tasks();
+         return;
+      default:
+         NVIC_SystemReset();
+   }
+   add_piped_task_to_send_into_tail(ESTABLISH_LONG_POLLING_CONNECTION_TASK);
+}
+
+/**
+ * Called on the successful long polling request. The cheapest step will be taken on the next failure again
+ */
+void finish_recovery_step() {
+   device_g->next_recovery_step = RESYNC_PARSER_RECOVERY_STEP;
+
+   if (!RECOVERY_STEP_STATISTICS_ENABLED || !device_g->recovery_step_in_progress) {
+      return;
+   }
+
+   RecoveryStepStatistics *recovery_step_statistics = &device_g->recovery_steps[device_g->taken_recovery_step];
+   unsigned int recovery_time_ms = device_g->milliseconds_counter - device_g->recovery_step_timestamp_ms;
+
+   device_g->recovery_step_in_progress = 0;
+   recovery_step_statistics->last_recovery_time_ms = recovery_time_ms;
+   if (recovery_time_ms > recovery_step_statistics->max_recovery_time_ms) {
+      recovery_step_statistics->max_recovery_time_ms = recovery_time_ms;
+   }
+   if (recovery_step_statistics->recoveries < 0xFFFF) {
+      recovery_step_statistics->recoveries++;
+   }
+}
+
+/**
+ * ESP8266 starts with the default baud rate after reset
+ */
+void add_esp8266_initialization_tasks() {
+   reset_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG);
+   reset_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+
+   add_piped_task_to_send_into_tail(DISABLE_ECHO_TASK);
+   if (USART_BAUD_RATE_ESCALATION_ENABLED) {
+      add_piped_task_to_send_into_tail(SET_USART_BAUD_RATE_TASK);
+   }
+   add_local_control_server_tasks();
+   add_piped_task_to_send_into_tail(GET_AP_CONNECTION_STATUS_AND_CONNECT_TASK);
+   add_piped_task_to_send_into_tail(ESTABLISH_LONG_POLLING_CONNECTION_TASK);
+}
+
+/**
+ * Multiple connections mode is required by the server and both are lost on ESP8266 reset. Nothing is added when the local
+ * control is disabled
+ */
+void add_local_control_server_tasks() {
+   if (!LOCAL_CONTROL_ENABLED) {
+      return;
+   }
+
+   add_piped_task_to_send_into_tail(SET_MULTIPLE_CONNECTIONS_TASK);
+   add_piped_task_to_send_into_tail(START_LOCAL_CONTROL_SERVER_TASK);
+}
+
+/**
+ * The frame is taken by the local control when it consists of the local clients link notifications and data only:
+ * "0,CONNECT", "+IPD,0,<length>:<command>", "0,CLOSED". Such a frame isn't a response to the sent command
+ *
+ * @return 1 if the frame has been handled
+ */
+unsigned char handle_local_control_frame() {
+   char *line = device_g->usart_data_received_buffer;
+   unsigned char handled = 0;
+
+   while (*line != '\0') {
+      if (*line == '\r' || *line == '\n') {
+         line++;
+         continue;
+      }
+
+      if (is_string_starts_with(line, ESP8226_RESPONSE_LINK_DATA_PREFIX)) {
+         char *link_data = line + get_string_length(ESP8226_RESPONSE_LINK_DATA_PREFIX);
+
+         if (!is_local_control_link(*link_data)) {
+            return 0;
+         }
+
+         // Data follows its length
+         while (*link_data != ':' && *link_data != '\0') {
+            link_data++;
+         }
+         if (*link_data == '\0') {
+            return 0;
+         }
+         execute_local_control_command(link_data + 1);
+      } else if (!is_local_control_link(*line) || *(line + 1) != ',') {
+         return 0;
+      }
+
+      handled = 1;
+      while (*line != '\n' && *line != '\0') {
+         line++;
+      }
+   }
+   return handled;
+}
+
+unsigned char is_local_control_link(char link_id) {
+   return link_id >= '0' && link_id <= '9' && link_id != SERVER_LINK_ID[0];
+}
+
+/**
+ * "<sequence>:<1 - turn on, 0 - turn off>:<tag>". The tag is SipHash-2-4 of "<sequence>:<1|0>" keyed with LOCAL_CONTROL_KEY. The
+ * sequence has to be greater than the one saved in the flash, so a captured command can't be replayed after a reset either
+ */
+void execute_local_control_command(char *command) {
+   unsigned int sequence = string_to_num(command);
+   char *character = command;
+
+   while (*character >= '0' && *character <= '9') {
+      character++;
+   }
+
+   char turn_on = *(character + 1);
+   if (*character != ':' || (turn_on != '0' && turn_on != '1') || *(character + 2) != ':') {
+      device_g->rejected_local_control_commands_counter++;
+      return;
+   }
+
+   character += 2;
+   unsigned long long tag = get_local_control_tag(command, character - command);
+   unsigned char tag_differs = 0;
+
+   // All the digits are compared, so the time doesn't tell how many of them are right
+   for (unsigned char i = 0; i < LOCAL_CONTROL_TAG_LENGTH; i++) {
+      char tag_digit = *(character + 1 + i);
+
+      if (tag_digit == '\0') {
+         tag_differs = 1;
+         break;
+      }
+      tag_differs |= tag_digit ^ HEX_DIGITS[(tag >> (4 * (LOCAL_CONTROL_TAG_LENGTH - 1 - i))) & 0xF];
+   }
+
+   if (tag_differs || sequence <= get_saved_local_control_sequence() || !save_local_control_sequence(sequence)) {
+      device_g->rejected_local_control_commands_counter++;
+      return;
+   }
+
+   device_g->local_control_sequence = sequence;
+   device_g->local_control_commands_counter++;
+   set_flag(&device_g->general_flags, LOCALLY_CONTROLLED_FLAG);
+   if (turn_on == '1') {
+      set_flag(&device_g->general_flags, TURN_PROJECTOR_ON);
+   } else {
+      reset_flag(&device_g->general_flags, TURN_PROJECTOR_ON);
+   }
+   if (update_projector_relay()) {
+      add_relay_actuation_time();
+   }
+}
+
+/**
+ * SipHash-2-4 with the key of the 16 LOCAL_CONTROL_KEY characters
+ */
+unsigned long long get_local_control_tag(char *data, unsigned short length) {
+   unsigned long long key_0 = get_little_endian_word(LOCAL_CONTROL_KEY, 8);
+   unsigned long long key_1 = get_little_endian_word(LOCAL_CONTROL_KEY + 8, 8);
+   unsigned long long v[] = {key_0 ^ 0x736f6d6570736575ULL, key_1 ^ 0x646f72616e646f6dULL, key_0 ^ 0x6c7967656e657261ULL,
+         key_1 ^ 0x7465646279746573ULL};
+   unsigned short processed_bytes = 0;
+
+   // The last word is padded and holds the length in its highest byte
+   while (1) {
+      unsigned char word_length = length - processed_bytes < 8 ? length - processed_bytes : 8;
+      unsigned long long message_word = get_little_endian_word(data + processed_bytes, word_length);
+
+      if (word_length < 8) {
+         message_word |= (unsigned long long) length << 56;
+      }
+
+      v[3] ^= message_word;
+      siphash_round(v);
+      siphash_round(v);
+      v[0] ^= message_word;
+
+      processed_bytes += word_length;
+      if (word_length < 8) {
+         break;
+      }
+   }
+
+   v[2] ^= 0xFF;
+   for (unsigned char i = 0; i < 4; i++) {
+      siphash_round(v);
+   }
+   return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+unsigned long long get_little_endian_word(char *data, unsigned char length) {
+   unsigned long long word = 0;
+
+   for (unsigned char i = 0; i < length; i++) {
+      word |= (unsigned long long) (unsigned char) data[i] << (8 * i);
+   }
+   return word;
+}
+
+void siphash_round(unsigned long long v[]) {
+   v[0] += v[1];
+   v[1] = ROTATE_LEFT_64(v[1], 13);
+   v[1] ^= v[0];
+   v[0] = ROTATE_LEFT_64(v[0], 32);
+   v[2] += v[3];
+   v[3] = ROTATE_LEFT_64(v[3], 16);
+   v[3] ^= v[2];
+   v[0] += v[3];
+   v[3] = ROTATE_LEFT_64(v[3], 21);
+   v[3] ^= v[0];
+   v[2] += v[1];
+   v[1] = ROTATE_LEFT_64(v[1], 17);
+   v[1] ^= v[2];
+   v[2] = ROTATE_LEFT_64(v[2], 32);
+}
+
+/**
+ * 0 when no command has been accepted since the page was erased for the first time
+ */
+unsigned int get_saved_local_control_sequence() {
+   unsigned int *saved_sequences = VERIFIED_CONFIGURATION->saved_local_control_sequences;
+   unsigned int saved_sequence = 0;
+
+   for (unsigned short i = 0; i < SAVED_LOCAL_CONTROL_SEQUENCES_SIZE && saved_sequences[i] != 0xFFFFFFFF; i++) {
+      saved_sequence = saved_sequences[i];
+   }
+   return saved_sequence;
+}
+
+/**
+ * Every accepted sequence is appended to the configuration page. The page is rewritten on the idle link when it's nearly full,
+ * it's erased right away only when a burst of commands has used up the reserve. The upper half word is written first: a half
+ * written slot holds a greater sequence, so nothing is replayed after the power loss
+ *
+ * @return 0 if the sequence hasn't been written
+ */
+unsigned char save_local_control_sequence(unsigned int sequence) {
+   unsigned int *saved_sequences = VERIFIED_CONFIGURATION->saved_local_control_sequences;
+   unsigned short free_slot = 0;
+
+   while (free_slot < SAVED_LOCAL_CONTROL_SEQUENCES_SIZE && saved_sequences[free_slot] != 0xFFFFFFFF) {
+      free_slot++;
+   }
+
+   if (free_slot == SAVED_LOCAL_CONTROL_SEQUENCES_SIZE) {
+      write_configuration_page(is_verified_configuration_valid() ? VERIFIED_CONFIGURATION->verified_settings : 0, sequence);
+   } else {
+      unsigned int slot_address = (unsigned int) &saved_sequences[free_slot];
+
+      unlock_flash();
+      write_flash_half_word(slot_address + 2, (unsigned short) (sequence >> 16));
+      write_flash_half_word(slot_address, (unsigned short) sequence);
+      FLASH->CR |= FLASH_CR_LOCK;
+
+      if (free_slot >= SAVED_LOCAL_CONTROL_SEQUENCES_SIZE - SAVED_LOCAL_CONTROL_SEQUENCES_RESERVE) {
+         set_flag(&device_g->general_flags, CONFIGURATION_PAGE_WRITE_PENDING_FLAG);
+      }
+   }
+   return get_saved_local_control_sequence() == sequence;
+}
+
+/**
+ * The start time after the power cycle isn't waited entirely when ESP8266 has printed "ready"
+ */
+void check_esp8266_ready() {
+   if (!device_g->usart_data_received) {
+      return;
+   }
+
+   if (is_usart_response_contains_element(ESP8226_RESPONSE_READY)) {
+      device_g->esp8266_disabled_timer = 0;
+      finish_esp8266_start(1);
+   }
+   clear_usart_data_received_buffer();
+   release_usart_data_received_buffer();
+}
+
+void finish_esp8266_start(unsigned char ready_received) {
+   unsigned int start_time_ms = device_g->milliseconds_counter - device_g->esp8266_enabled_timestamp_ms;
+
+   device_g->esp8266_is_starting = 0;
+   if (!DEVICE_STATISTICS_ENABLED) {
+      return;
+   }
+   device_g->esp8266_last_start_time_ms = start_time_ms;
+
+   if (!ready_received) {
+      if (device_g->esp8266_start_timeouts < 0xFFFF) {
+         device_g->esp8266_start_timeouts++;
+      }
+   } else if (start_time_ms < ESP8266_START_TIMEOUT_MS) {
+      device_g->esp8266_saved_start_time_ms += ESP8266_START_TIMEOUT_MS - start_time_ms;
+   }
+}
+
+/**
+ * FNV-1a of the settings the ESP8266 configuration depends on. Another firmware settings invalidate the saved configuration
+ */
+unsigned int get_settings_checksum() {
+   char *settings[] = {DEFAULT_ACCESS_POINT_NAME, DEFAULT_ACCESS_POINT_PASSWORD, ESP8226_OWN_IP_ADDRESS};
+   unsigned int checksum = FNV_OFFSET_BASIS;
+
+   for (unsigned char i = 0; i < 3; i++) {
+      checksum = add_to_checksum(checksum, settings[i], get_string_length(settings[i]));
+   }
+   return checksum;
+}
+
+/**
+ * FNV-1a. Start with FNV_OFFSET_BASIS
+ */
+unsigned int add_to_checksum(unsigned int checksum, void *data, unsigned short length) {
+   unsigned char *data_byte = (unsigned char *) data;
+
+   for (unsigned short i = 0; i < length; i++, data_byte++) {
+      checksum ^= *data_byte;
+      checksum *= FNV_PRIME;
+   }
+   return checksum;
+}
+
+/**
+ * The reset flags are cleared, so the next reset cause isn't mixed with this one
+ */
+ResetCause get_reset_cause() {
+   ResetCause reset_cause = POWER_ON_RESET_CAUSE;
+
+   if (RCC_GetFlagStatus(RCC_FLAG_IWDGRST) == SET || RCC_GetFlagStatus(RCC_FLAG_WWDGRST) == SET) {
+      reset_cause = WATCHDOG_RESET_CAUSE;
+   } else if (RCC_GetFlagStatus(RCC_FLAG_SFTRST) == SET) {
+      reset_cause = SOFTWARE_RESET_CAUSE;
+   } else if (RCC_GetFlagStatus(RCC_FLAG_LPWRRST) == SET) {
+      reset_cause = LOW_POWER_RESET_CAUSE;
+   } else if (RCC_GetFlagStatus(RCC_FLAG_OBLRST) == SET) {
+      reset_cause = OPTION_BYTES_RESET_CAUSE;
+   } else if (RCC_GetFlagStatus(RCC_FLAG_PORRST) == RESET && RCC_GetFlagStatus(RCC_FLAG_PINRST) == SET) {
+      reset_cause = PIN_RESET_CAUSE;
+   }
+   RCC_ClearFlag();
+   return reset_cause;
+}
+
+unsigned int get_recovery_record_checksum() {
+   return add_to_checksum(FNV_OFFSET_BASIS, &recovery_record_g, (unsigned char *) &recovery_record_g.checksum - (unsigned char *) &recovery_record_g);
+}
+
+/**
+ * After a warm reset the link state is taken from the record and the relay is switched on again if it was on. The network
+ * is checked as usual afterwards, so the relay is switched off once the connection or the server turns out to be lost
+ */
+void restore_recovery_record() {
+   // The reset cause is only reported by the device statistics
+   if (!WARM_RESET_RECOVERY_ENABLED && !DEVICE_STATISTICS_ENABLED) {
+      return;
+   }
+
+   device_g->reset_cause = get_reset_cause();
+
+   if (!WARM_RESET_RECOVERY_ENABLED || device_g->reset_cause == POWER_ON_RESET_CAUSE ||
+         recovery_record_g.checksum != get_recovery_record_checksum()) {
+      recovery_record_g.general_flags = 0;
+      recovery_record_g.local_control_sequence = 0;
+      recovery_record_g.status_sequence = 0;
+      recovery_record_g.warm_resets = 0;
+      recovery_record_g.watchdog_resets = 0;
+   } else {
+      recovery_record_g.warm_resets++;
+      if (device_g->reset_cause == WATCHDOG_RESET_CAUSE) {
+         recovery_record_g.watchdog_resets++;
+      }
+
+      set_flag(&device_g->general_flags, recovery_record_g.general_flags & RECOVERED_GENERAL_FLAGS);
+      device_g->status_sequence = recovery_record_g.status_sequence;
+      device_g->local_control_sequence = recovery_record_g.local_control_sequence;
+      update_projector_relay();
+   }
+   recovery_record_g.checksum = get_recovery_record_checksum();
+}
+
+/**
+ * Updated only when the recovered state has been changed
+ */
+void save_recovery_record() {
+   unsigned int general_flags = device_g->general_flags & RECOVERED_GENERAL_FLAGS;
+
+   if (!WARM_RESET_RECOVERY_ENABLED || (recovery_record_g.general_flags == general_flags &&
+         recovery_record_g.status_sequence == device_g->status_sequence &&
+         recovery_record_g.local_control_sequence == device_g->local_control_sequence)) {
+      return;
+   }
+
+   recovery_record_g.general_flags = general_flags;
+   recovery_record_g.local_control_sequence = device_g->local_control_sequence;
+   recovery_record_g.status_sequence = device_g->status_sequence;
+   recovery_record_g.checksum = get_recovery_record_checksum();
+}
+
+unsigned char is_verified_configuration_valid() {
+   VerifiedConfiguration *verified_configuration = VERIFIED_CONFIGURATION;
+
+   return WARM_BOOT_ENABLED && verified_configuration->settings_checksum == get_settings_checksum() &&
+         verified_configuration->verified_settings == (unsigned short) ~verified_configuration->verified_settings_complement &&
+         verified_configuration->verified_settings == ALL_VERIFIED_SETTINGS;
+}
+
+/**
+ * The flash is written only once all the settings are confirmed and the saved record differs. The page erase stalls the CPU with
+ * the USART interrupt for tens of milliseconds, so it's left till the link is idle
+ */
+void add_verified_setting(unsigned int verified_setting) {
+   if (!WARM_BOOT_ENABLED) {
+      return;
+   }
+
+   set_flag(&device_g->verified_settings, verified_setting);
+
+   if (device_g->verified_settings == ALL_VERIFIED_SETTINGS && !is_verified_configuration_valid()) {
+      set_flag(&device_g->general_flags, CONFIGURATION_PAGE_WRITE_PENDING_FLAG);
+   }
+}
+
+/**
+ * Called when nothing is expected from ESP8266: between the long polling response and the next request, or while ESP8266 is
+ * switched off
+ */
+void write_pending_configuration_page() {
+   // Nothing else is kept in the page
+   if ((!WARM_BOOT_ENABLED && !LOCAL_CONTROL_ENABLED) || !read_flag(&device_g->general_flags, CONFIGURATION_PAGE_WRITE_PENDING_FLAG)) {
+      return;
+   }
+
+   reset_flag(&device_g->general_flags, CONFIGURATION_PAGE_WRITE_PENDING_FLAG);
+   unsigned short verified_settings = device_g->verified_settings == ALL_VERIFIED_SETTINGS || is_verified_configuration_valid() ?
+         ALL_VERIFIED_SETTINGS : 0;
+
+   write_configuration_page(verified_settings, get_saved_local_control_sequence());
+}
+
+/**
+ * The whole page is erased, so the saved local control sequence is written again, before anything else
+ *
+ * @param verified_settings 0 - the configuration isn't written
+ * @param local_control_sequence 0 - nothing to write
+ */
+void write_configuration_page(unsigned short verified_settings, unsigned int local_control_sequence) {
+   unsigned int settings_checksum = get_settings_checksum();
+   unsigned int sequence_address = (unsigned int) VERIFIED_CONFIGURATION->saved_local_control_sequences;
+
+   unlock_flash();
+   erase_flash_page(VERIFIED_CONFIGURATION_FLASH_ADDRESS);
+
+   if (local_control_sequence) {
+      write_flash_half_word(sequence_address + 2, (unsigned short) (local_control_sequence >> 16));
+      write_flash_half_word(sequence_address, (unsigned short) local_control_sequence);
+   }
+   if (verified_settings) {
+      write_flash_half_word(VERIFIED_CONFIGURATION_FLASH_ADDRESS, (unsigned short) settings_checksum);
+      write_flash_half_word(VERIFIED_CONFIGURATION_FLASH_ADDRESS + 2, (unsigned short) (settings_checksum >> 16));
+      write_flash_half_word(VERIFIED_CONFIGURATION_FLASH_ADDRESS + 4, verified_settings);
+      write_flash_half_word(VERIFIED_CONFIGURATION_FLASH_ADDRESS + 6, (unsigned short) ~verified_settings);
+   }
+
+   FLASH->CR |= FLASH_CR_LOCK;
+}
+
+void unlock_flash() {
+   if (FLASH->CR & FLASH_CR_LOCK) {
+      FLASH->KEYR = FLASH_FKEY1;
+      FLASH->KEYR = FLASH_FKEY2;
+   }
+}
+
+void erase_flash_page(unsigned int page_address) {
+   while (FLASH->SR & FLASH_SR_BSY);
+
+   FLASH->CR |= FLASH_CR_PER;
+   FLASH->AR = page_address;
+   FLASH->CR |= FLASH_CR_STRT;
+
+   while (FLASH->SR & FLASH_SR_BSY);
+   FLASH->SR = FLASH_SR_EOP;
+   FLASH->CR &= ~FLASH_CR_PER;
+}
+
+/**
+ * The flash is programmed by half words only
+ */
+void write_flash_half_word(unsigned int address, unsigned short data) {
+   while (FLASH->SR & FLASH_SR_BSY);
+
+   FLASH->CR |= FLASH_CR_PG;
+   *(volatile unsigned short *) address = data;
+
+   while (FLASH->SR & FLASH_SR_BSY);
+   FLASH->SR = FLASH_SR_EOP;
+   FLASH->CR &= ~FLASH_CR_PG;
+}
+
+void check_connection_status_and_server_availability() {
+   if (device_g->checking_connection_status_and_server_availability_timer == 0 && is_piped_tasks_scheduler_empty() &&
+         !device_g->initialization_in_progress && read_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG)) {
+      device_g->checking_connection_status_and_server_availability_timer = TIMER14_30S;
+      add_piped_task_to_send_into_tail(GET_CONNECTION_STATUS_TASK);
+      if (SERVER_PING_ENABLED) {
+         add_piped_task_to_send_into_tail(GET_SERVER_AVAILABILITY_TASK);
+      }
+   }
+}
+
+void check_visible_network_list() {
+   if (!device_g->visible_network_list_timer && is_piped_tasks_scheduler_empty()) {
+      device_g->visible_network_list_timer = TIMER14_10MIN;
+      add_piped_task_to_send_into_tail(GET_VISIBLE_NETWORK_LIST_TASK);
+   }
+}
+
+void schedule_global_function_resending_and_send_request(unsigned int task_to_be_sent, unsigned int task_to_be_sent_in_case_of_error, CommandClass command_class) {
+   device_g->final_task_for_request_resending = task_to_be_sent_in_case_of_error;
+   schedule_function_resending(resend_usart_http_request_using_global_final_task, command_class, DO_NOT_EXECUTE_FUNCTION_IMMEDIATELY);
+
+   send_request(task_to_be_sent);
+}
+
+void add_error() {
+   add_task_error(device_g->sent_task);
+   device_g->sent_task = 0;
+}
+
+/**
+ * The failed task isn't necessarily the sent one: the held long polling request fails while another command is in progress
+ */
+void add_task_error(unsigned int task) {
+   if (FAULT_RECOVERY_STATISTICS_ENABLED) {
+      add_fault(get_response_fault_class());
+   }
+   device_g->send_usart_data_errors_counter++;
+   device_g->send_usart_data_errors_unresetable_counter++;
+   device_g->last_error_task = task;
+
+   if (device_g->received_usart_error_data != NULL) {
+      free(device_g->received_usart_error_data);
+      device_g->received_usart_error_data = NULL;
+   }
+   device_g->received_usart_error_data = get_received_usart_error_data();
+}
+
+/**
+ * The relay is on only while the server is reachable and has asked for it, or the local control command has turned it on. The pin
+ * is set or reset with a single BSRR/BRR write
+ *
+ * @return 1 if the relay state has been changed
+ */
+unsigned char update_projector_relay() {
+   unsigned char turn_on = read_flag(&device_g->general_flags, TURN_PROJECTOR_ON) && (read_flag(&device_g->general_flags, LOCALLY_CONTROLLED_FLAG) ||
+         (read_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG) && read_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG)));
+   unsigned char turned_on = (PROJECTOR_RELAY_PORT->ODR & PROJECTOR_RELAY_PIN) ? 1 : 0;
+
+   if (turn_on == turned_on) {
+      return 0;
+   }
+
+   if (turn_on) {
+      PROJECTOR_RELAY_PORT->BSRR = PROJECTOR_RELAY_PIN;
+   } else {
+      PROJECTOR_RELAY_PORT->BRR = PROJECTOR_RELAY_PIN;
+   }
+   return 1;
+}
+
+/**
+ * The last byte has been received the idle gap before the frame was handed over
+ */
+void add_relay_actuation_time() {
+   if (!DEVICE_STATISTICS_ENABLED) {
+      return;
+   }
+
+   unsigned int relay_actuation_time_us = get_microseconds() - device_g->usart_frame_handed_over_timestamp_us + TIMER3_US_PER_PERIOD;
+
+   device_g->relay_actuation_time_us = relay_actuation_time_us;
+   if (relay_actuation_time_us > device_g->max_relay_actuation_time_us) {
+      device_g->max_relay_actuation_time_us = relay_actuation_time_us;
+   }
+}
+
+void establish_long_polling_connection(unsigned int request_task) {
+   if (device_g->initialization_in_progress) {
+      device_g->initialization_in_progress = 0;
+      device_g->last_initialization_time_ms = device_g->milliseconds_counter - device_g->initialization_start_timestamp_ms;
+   }
+   // The previous response has been handled and the server doesn't hold a request
+   write_pending_configuration_page();
+   device_g->poll_decided_timestamp_us = get_microseconds();
+   device_g->long_polling_wait = NO_LONG_POLLING_WAIT;
+   if (POLL_CYCLE_STATISTICS_ENABLED) {
+      start_poll_cycle();
+   }
+   clear_piped_request_commands_to_send();
+   char *request = generate_request(ESP8226_REQUEST_SEND_STATUS_INFO_AND_ESTABLISH_LONG_POLLING_REQUEST);
+
+   if (!prepare_http_request(ESP8226_SERVER_IP_ADDRESS, ESP8226_SERVER_PORT, request, NULL, request_task)) {
+      // The request hasn't been allocated. The status is generated again on the next loop turn
+      add_piped_task_to_send_into_tail(ESTABLISH_LONG_POLLING_CONNECTION_TASK);
+   }
+}
+
+char *generate_request(char *request_template) {
+   unsigned char full_status = read_flag(&device_g->general_flags, FULL_STATUS_REQUIRED_FLAG);
+   unsigned char server_is_available = read_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG);
+
+   // Only the rendered fields are recorded as sent. A field, which hasn't been allocated, still differs from the acknowledged one
+   // and is sent next time. The full status with a missing field is required again
+   unsigned char missing_fields = 0;
+
+   device_g->sent_status = device_g->acknowledged_status;
+
+   signed char rssi_dbm = get_smoothed_rssi();
+   char *gain_field = NULL;
+   if (full_status || rssi_dbm != device_g->acknowledged_status.rssi_dbm) {
+      char *gain = signed_num_to_string(rssi_dbm);
+      gain_field = get_status_field(GAIN_JSON_FIELD, gain);
+      free(gain);
+
+      if (gain_field != NULL) {
+         device_g->sent_status.rssi_dbm = rssi_dbm;
+      } else {
+         missing_fields++;
+      }
+   }
+
+   char *server_is_available_field = NULL;
+   if (full_status || server_is_available != device_g->acknowledged_status.server_is_available) {
+      server_is_available_field = get_status_field(SERVER_IS_AVAILABLE_JSON_FIELD, server_is_available ? "true" : "false");
+
+      if (server_is_available_field != NULL) {
+         device_g->sent_status.server_is_available = server_is_available;
+      } else {
+         missing_fields++;
+      }
+   }
+
+   char *local_control_field = NULL;
+   if (LOCAL_CONTROL_ENABLED && device_g->local_control_sequence && (full_status ||
+         device_g->local_control_sequence != device_g->acknowledged_status.local_control_sequence)) {
+      char *local_control_sequence = num_to_string(device_g->local_control_sequence);
+      char *parameters[] = {local_control_sequence, read_flag(&device_g->general_flags, TURN_PROJECTOR_ON) ? "true" : "false", NULL};
+
+      local_control_field = set_string_parameters(LOCAL_CONTROL_JSON_FIELD, parameters);
+      free(local_control_sequence);
+
+      if (local_control_field != NULL) {
+         device_g->sent_status.local_control_sequence = device_g->local_control_sequence;
+      } else {
+         missing_fields++;
+      }
+   }
+
+   char *link_status_field = NULL;
+   if (LINK_STATUS_QUERY_ENABLED && (full_status || device_g->link_status != device_g->acknowledged_status.link_status)) {
+      char *link_status = num_to_string(device_g->link_status);
+      link_status_field = get_status_field(LINK_STATUS_JSON_FIELD, link_status);
+      free(link_status);
+
+      if (link_status_field != NULL) {
+         device_g->sent_status.link_status = device_g->link_status;
+      } else {
+         missing_fields++;
+      }
+   }
+
+   char *debug_info = NULL;
+   if (device_g->polls_without_debug_info < 0xFF) {
+      device_g->polls_without_debug_info++;
+   }
+   if (is_debug_info_to_be_sent()) {
+      debug_info = add_debug_info();
+      device_g->polls_without_debug_info = 0;
+   }
+   char *debug_info_included = debug_info != NULL ? "true" : "false";
+
+   char *timestamp_field = NULL;
+#if REQUEST_TRACES_ENABLED
+   // The response timestamp comes from the traces, the field is omitted without them
+   if (full_status || debug_info != NULL) {
+      char *response_timestamp = num_to_string(calculate_response_timestamp());
+      timestamp_field = get_status_field(TIMESTAMP_JSON_FIELD, response_timestamp);
+      free(response_timestamp);
+
+      if (timestamp_field == NULL) {
+         missing_fields++;
+      }
+   }
+#endif
+   device_g->sent_status.full_status = full_status && !missing_fields;
+
+   char *status_sequence_string = num_to_string(device_g->status_sequence + 1);
+   char *parameters_for_status[] = {status_sequence_string, full_status ? "true" : "false", debug_info_included, ESP8226_OWN_DEVICE_NAME,
+         gain_field != NULL ? gain_field : EMPTY_STRING, server_is_available_field != NULL ? server_is_available_field : EMPTY_STRING,
+         timestamp_field != NULL ? timestamp_field : EMPTY_STRING, debug_info != NULL ? debug_info : EMPTY_STRING,
+         local_control_field != NULL ? local_control_field : EMPTY_STRING, link_status_field != NULL ? link_status_field : EMPTY_STRING, NULL};
+   char *status_json = set_string_parameters(STATUS_JSON, parameters_for_status);
+
+   free(status_sequence_string);
+   char *status_fields[] = {gain_field, server_is_available_field, timestamp_field, debug_info, local_control_field, link_status_field};
+   for (unsigned char i = 0; i < 6; i++) {
+      if (status_fields[i] != NULL) {
+         free(status_fields[i]);
+      }
+   }
+
+   if (device_g->received_usart_error_data != NULL) {
+      free(device_g->received_usart_error_data);
+      device_g->received_usart_error_data = NULL;
+   }
+
+   if (status_json == NULL) {
+      device_g->sent_status = device_g->acknowledged_status;
+      return NULL;
+   }
+
+   unsigned short status_string_length = get_string_length(status_json);
+   char *status_string_length_string = num_to_string(status_string_length);
+   char *parameters_for_request[] = {status_string_length_string, ESP8226_SERVER_IP_ADDRESS, status_json, NULL};
+   char *request = set_string_parameters(request_template, parameters_for_request);
+
+   free(status_json);
+   free(status_string_length_string);
+   if (request == NULL) {
+      device_g->sent_status = device_g->acknowledged_status;
+   }
+   return request;
+}
+
+/**
+ * Counters are sent only when they differ from the acknowledged ones or the full status is required
+ */
+void *add_debug_info() {
+   unsigned int counters[DEBUG_COUNTERS_SIZE];
+   char *counter_fields[DEBUG_COUNTERS_SIZE];
+
+   get_debug_counters(counters);
+   for (unsigned char i = 0; i < DEBUG_COUNTERS_SIZE; i++) {
+      counter_fields[i] = get_changed_status_field(DEBUG_COUNTER_JSON_FIELDS[i], counters[i], device_g->acknowledged_status.debug_counters[i]);
+   }
+
+   char *last_error_task_string = num_to_string(device_g->last_error_task);
+   char *received_usart_error_data = device_g->last_error_task && device_g->received_usart_error_data != NULL ? device_g->received_usart_error_data : "";
+   char *section_statistics[] = {NULL, NULL, NULL};
+
+   // Only the statistics of one section are built, so the heap holds a small part of them at once
+   switch (device_g->debug_info_section) {
+      case DEVICE_DEBUG_INFO_SECTION:
+#if UPTIME_STATISTICS_ENABLED
+         section_statistics[0] = get_uptime_statistics();
+#endif
+#if DEVICE_STATISTICS_ENABLED
+         section_statistics[1] = get_device_statistics();
+#endif
+#if RAM_USAGE_STATISTICS_ENABLED
+         section_statistics[2] = get_ram_usage();
+#endif
+         break;
+      case CONNECTION_DEBUG_INFO_SECTION:
+#if DEVICE_STATISTICS_ENABLED
+         section_statistics[0] = get_connection_statistics();
+#endif
+         section_statistics[1] = get_rssi_statistics();
+         break;
+      case FAULTS_DEBUG_INFO_SECTION:
+#if POLL_CYCLE_STATISTICS_ENABLED
+         section_statistics[0] = get_poll_cycle_statistics();
+#endif
+#if FAULT_RECOVERY_STATISTICS_ENABLED
+         section_statistics[1] = get_fault_recoveries();
+#endif
+         break;
+      case RECOVERY_DEBUG_INFO_SECTION:
+#if RECOVERY_STEP_STATISTICS_ENABLED
+         section_statistics[0] = get_recovery_steps();
+#endif
+#if COMMAND_TIMEOUT_STATISTICS_ENABLED
+         section_statistics[1] = get_command_timeouts();
+#endif
+         break;
+      default:
+#if REQUEST_TRACES_ENABLED
+         section_statistics[0] = get_traces();
+#endif
+         section_statistics[1] = get_health_measurements();
+   }
+
+   char *parameters_for_status[] = {EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, EMPTY_STRING,
+         last_error_task_string != NULL ? last_error_task_string : EMPTY_STRING, received_usart_error_data,
+         EMPTY_STRING, EMPTY_STRING, EMPTY_STRING, NULL};
+
+   for (unsigned char i = 0; i < DEBUG_COUNTERS_SIZE; i++) {
+      if (counter_fields[i] != NULL) {
+         parameters_for_status[i] = counter_fields[i];
+      }
+   }
+   // Statistics, which haven't been allocated, are skipped until the next round
+   for (unsigned char i = 0; i < 3; i++) {
+      if (section_statistics[i] != NULL) {
+         parameters_for_status[i + 9] = section_statistics[i];
+      }
+   }
+   char *debug_info = set_string_parameters(DEBUG_STATUS_JSON, parameters_for_status);
+
+   // A counter, which field hasn't been allocated, stays not acknowledged and is sent next time
+   for (unsigned char i = 0; i < DEBUG_COUNTERS_SIZE; i++) {
+      if (debug_info != NULL && counter_fields[i] != NULL) {
+         device_g->sent_status.debug_counters[i] = counters[i];
+      }
+      free(counter_fields[i]);
+   }
+   for (unsigned char i = 0; i < 3; i++) {
+      free(section_statistics[i]);
+   }
+   free(last_error_task_string);
+
+   if (debug_info == NULL) {
+      return NULL;
+   }
+   device_g->debug_info_section = device_g->debug_info_section + 1 < DEBUG_INFO_SECTIONS_SIZE ? device_g->debug_info_section + 1 : DEVICE_DEBUG_INFO_SECTION;
+   device_g->last_error_task = 0;
+   return debug_info;
+}
+
+/**
+ * While the server requires debug info, it's sent only when a counter has been changed, a new error has been captured or
+ * the polls interval has passed. So usual polls stay small. The started sections round is finished on the next polls
+ */
+unsigned char is_debug_info_to_be_sent() {
+   if (!read_flag(&device_g->general_flags, SEND_DEBUG_INFO_FLAG)) {
+      return 0;
+   }
+
+   if (device_g->debug_info_section != DEVICE_DEBUG_INFO_SECTION || read_flag(&device_g->general_flags, FULL_STATUS_REQUIRED_FLAG) ||
+         (device_g->last_error_task && device_g->received_usart_error_data != NULL) ||
+         (device_g->debug_info_polls_interval && device_g->polls_without_debug_info >= device_g->debug_info_polls_interval)) {
+      return 1;
+   }
+
+   unsigned int counters[DEBUG_COUNTERS_SIZE];
+
+   get_debug_counters(counters);
+   for (unsigned char i = 0; i < DEBUG_COUNTERS_SIZE; i++) {
+      if (counters[i] != device_g->acknowledged_status.debug_counters[i]) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+void get_debug_counters(unsigned int counters[]) {
+   counters[0] = device_g->send_usart_data_errors_unresetable_counter;
+   counters[1] = device_g->usart_overrun_errors_counter;
+   counters[2] = device_g->usart_idle_line_detection_counter;
+   counters[3] = device_g->usart_noise_detection_counter;
+   counters[4] = device_g->usart_framing_errors_counter;
+   counters[5] = device_g->usart_buffer_overflows_counter;
+   counters[6] = device_g->usart_baud_rate;
+}
+
+// "debugInfoInterval":"20"
+void save_debug_info_polls_interval() {
+   char *polls_interval = get_gson_element_value(device_g->usart_data_received_buffer, DEBUG_INFO_POLLS_INTERVAL_JSON_ELEMENT);
+
+   if (polls_interval == NULL) {
+      return;
+   }
+
+   unsigned int polls_interval_value = string_to_num(polls_interval);
+   device_g->debug_info_polls_interval = polls_interval_value > 0xFF ? 0xFF : (unsigned char) polls_interval_value;
+   free(polls_interval);
+}
+
+/**
+ * Statistics of the previous poll cycle are saved to be sent in the debug info, counting starts from zero
+ */
+void start_poll_cycle() {
+   device_g->current_poll_cycle.received_bytes = device_g->poll_cycle_received_bytes;
+   device_g->poll_cycle_received_bytes = 0;
+   device_g->last_poll_cycle = device_g->current_poll_cycle;
+
+   device_g->current_poll_cycle.at_commands = 0;
+   device_g->current_poll_cycle.sent_bytes = 0;
+   device_g->current_poll_cycle.received_bytes = 0;
+   device_g->current_poll_cycle.allocations = 0;
+   device_g->current_poll_cycle.cpu_time_us = 0;
+}
+
+#if POLL_CYCLE_STATISTICS_ENABLED
+/**
+ * Do not forget to call free() function on returned pointer when it's no longer needed
+ */
+void *get_poll_cycle_statistics() {
+   int numbers[] = {device_g->last_poll_cycle.at_commands, device_g->last_poll_cycle.sent_bytes, device_g->last_poll_cycle.received_bytes,
+         device_g->last_poll_cycle.allocations, device_g->last_poll_cycle.cpu_time_us};
+   return set_number_parameters(POLL_CYCLE_JSON_FIELD, numbers, 5);
+}
+#endif
+
+void add_device_event(DeviceEvent event) {
+   if (!UPTIME_STATISTICS_ENABLED) {
+      return;
+   }
+
+   if (device_g->device_events_index >= DEVICE_EVENTS_SIZE) {
+      device_g->device_events_index = 0;
+   }
+
+   device_g->device_events[device_g->device_events_index].timestamp_ms = device_g->milliseconds_counter;
+   device_g->device_events[device_g->device_events_index].event = event;
+   device_g->device_events_index++;
+
+   if (device_g->device_events_amount < DEVICE_EVENTS_SIZE) {
+      device_g->device_events_amount++;
+   }
+}
+
+void add_general_flags_events() {
+   if (!UPTIME_STATISTICS_ENABLED) {
+      return;
+   }
+
+   unsigned int changed_flags = (device_g->general_flags ^ device_g->logged_general_flags) & LOGGED_GENERAL_FLAGS;
+
+   if (!changed_flags) {
+      return;
+   }
 
-   if (received_usart_error_data_g != NULL) {
-      free(received_usart_error_data_g);
-      received_usart_error_data_g = NULL;
+   if (read_flag(&changed_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG)) {
+      add_device_event(read_flag(&device_g->general_flags, SUCCESSUFULLY_CONNECTED_TO_NETWORK_FLAG) ? NETWORK_CONNECTED_EVENT : NETWORK_DISCONNECTED_EVENT);
+   }
+   if (read_flag(&changed_flags, SERVER_IS_AVAILABLE_FLAG)) {
+      add_device_event(read_flag(&device_g->general_flags, SERVER_IS_AVAILABLE_FLAG) ? SERVER_AVAILABLE_EVENT : SERVER_UNAVAILABLE_EVENT);
+   }
+   if (read_flag(&changed_flags, TURN_PROJECTOR_ON)) {
+      add_device_event(read_flag(&device_g->general_flags, TURN_PROJECTOR_ON) ? PROJECTOR_TURNED_ON_EVENT : PROJECTOR_TURNED_OFF_EVENT);
    }
+   device_g->logged_general_flags = device_g->general_flags & LOGGED_GENERAL_FLAGS;
+}
 
-   general_flags_g = 0;
-   sent_task_g = 0;
-   send_usart_data_errors_counter_g = 0;
+/**
+ * Only the first response after sent data is measured. The server holds long polling requests, so they aren't measured
+ */
+void add_command_latency(unsigned int sent_task) {
+   if (!UPTIME_STATISTICS_ENABLED) {
+      return;
+   }
 
-   add_piped_task_to_send_into_tail(GET_AP_CONNECTION_STATUS_AND_CONNECT_TASK);
-   add_piped_task_to_send_into_tail(ESTABLISH_LONG_POLLING_CONNECTION_TASK);
+   if (device_g->command_latency_measured || !sent_task || read_flag(&sent_task, ESTABLISH_LONG_POLLING_CONNECTION_REQUEST_TASK)) {
+      device_g->command_latency_measured = 1;
+      return;
+   }
+
+   device_g->command_latency_measured = 1;
+   unsigned int latency_ms = device_g->milliseconds_counter - device_g->command_sent_timestamp_ms;
+   unsigned char bucket = 0;
+
+   while (bucket < COMMAND_LATENCY_HISTOGRAM_SIZE - 1 && latency_ms > (1u << bucket)) {
+      bucket++;
+   }
+
+   if (device_g->command_latency_histogram[bucket] < 0xFFFF) {
+      device_g->command_latency_histogram[bucket]++;
+   }
 }
 
-void check_connection_status_and_server_availability() {
-   if (checking_connection_status_and_server_availability_timer_g == 0 && is_piped_tasks_scheduler_empty()) {
-      checking_connection_status_and_server_availability_timer_g = TIMER14_30S;
-      add_piped_task_to_send_into_tail(GET_CONNECTION_STATUS_TASK);
-      add_piped_task_to_send_into_tail(GET_SERVER_AVAILABILITY_TASK);
+#if UPTIME_STATISTICS_ENABLED
+/**
+ * Returns the upper bound of the histogram bucket the percentile is in
+ */
+unsigned int get_command_latency_percentile(unsigned char percentile) {
+   unsigned int latencies_amount = 0;
+
+   for (unsigned char i = 0; i < COMMAND_LATENCY_HISTOGRAM_SIZE; i++) {
+      latencies_amount += device_g->command_latency_histogram[i];
+   }
+
+   unsigned int percentile_position = latencies_amount * percentile / 100;
+   unsigned int latencies_passed = 0;
+
+   for (unsigned char i = 0; i < COMMAND_LATENCY_HISTOGRAM_SIZE; i++) {
+      latencies_passed += device_g->command_latency_histogram[i];
+
+      if (latencies_passed > percentile_position) {
+         return 1u << i;
+      }
    }
+   return 0;
 }
 
-void check_visible_network_list() {
-   if (!visible_network_list_timer_g && is_piped_tasks_scheduler_empty()) {
-      visible_network_list_timer_g = TIMER14_10MIN;
-      add_piped_task_to_send_into_tail(GET_VISIBLE_NETWORK_LIST_TASK);
+/**
+ * Do not forget to call free() function on returned pointer when it's no longer needed
+ */
+void *get_uptime_statistics() {
+   char *events = NULL;
+   unsigned char event_index = device_g->device_events_amount < DEVICE_EVENTS_SIZE ? 0 : device_g->device_events_index;
+
+   // From the oldest event
+   for (unsigned char i = 0; i < device_g->device_events_amount; i++, event_index++) {
+      if (event_index >= DEVICE_EVENTS_SIZE) {
+         event_index = 0;
+      }
+
+      char *timestamp = num_to_string(device_g->device_events[event_index].timestamp_ms / 1000);
+      char *event = num_to_string(device_g->device_events[event_index].event);
+      char *parameters[] = {events != NULL ? events : EMPTY_STRING, events != NULL ? ", " : EMPTY_STRING, timestamp, event, NULL};
+      char *events_with_added_one = set_string_parameters(DEVICE_EVENT_JSON_ELEMENT, parameters);
+
+      if (events != NULL) {
+         free(events);
+      }
+      free(timestamp);
+      free(event);
+      if (events_with_added_one == NULL) {
+         return NULL;
+      }
+      events = events_with_added_one;
+   }
+
+   char *uptime = num_to_string(device_g->milliseconds_counter / 1000);
+   char *polls_completed = num_to_string(device_g->polls_completed_counter);
+   char *resets = num_to_string(device_g->device_state_resets_counter);
+   char *latency_p50 = num_to_string(get_command_latency_percentile(50));
+   char *latency_p90 = num_to_string(get_command_latency_percentile(90));
+   char *latency_p99 = num_to_string(get_command_latency_percentile(99));
+   char *parameters[] = {uptime, polls_completed, resets, latency_p50, latency_p90, latency_p99, events != NULL ? events : EMPTY_STRING,
+         NULL};
+   // NULL if any of the numbers hasn't been allocated
+   char *uptime_statistics = set_string_parameters(UPTIME_STATISTICS_JSON_FIELD, parameters);
+
+   free(uptime);
+   free(polls_completed);
+   free(resets);
+   free(latency_p50);
+   free(latency_p90);
+   free(latency_p99);
+   if (events != NULL) {
+      free(events);
    }
+   return uptime_statistics;
 }
+#endif
 
+#if DEVICE_STATISTICS_ENABLED
 /**
- * @param timeout timeout in seconds
+ * Do not forget to call free() function on returned pointer when it's no longer needed
  */
-void schedule_global_function_resending_and_send_request(unsigned int task_to_be_sent, unsigned int task_to_be_sent_in_case_of_error, unsigned short timeout) {
-   final_task_for_request_resending_g = task_to_be_sent_in_case_of_error;
-   schedule_function_resending(resend_usart_http_request_using_global_final_task, timeout, DO_NOT_EXECUTE_FUNCTION_IMMEDIATELY);
+void *get_device_statistics() {
+   int numbers[] = {device_g->warm_boot, device_g->first_poll_time_ms, device_g->esp8266_last_start_time_ms, device_g->esp8266_saved_start_time_ms,
+         device_g->esp8266_start_timeouts, device_g->last_initialization_time_ms, device_g->reset_cause, recovery_record_g.warm_resets,
+         recovery_record_g.watchdog_resets};
+   return set_number_parameters(DEVICE_STATISTICS_JSON_FIELD, numbers, 9);
+}
 
-   send_request(task_to_be_sent);
+/**
+ * Do not forget to call free() function on returned pointer when it's no longer needed
+ */
+void *get_connection_statistics() {
+   int numbers[] = {device_g->chained_tasks_counter, device_g->request_on_wire_time_us, device_g->payloads_sent_on_prompt_counter,
+         device_g->relay_actuation_time_us, device_g->max_relay_actuation_time_us, device_g->local_control_commands_counter,
+         device_g->rejected_local_control_commands_counter, device_g->commands_during_long_polling_counter, device_g->server_ping_time_ms,
+         device_g->server_ping_failures_counter, device_g->skipped_connections_counter};
+   return set_number_parameters(CONNECTION_STATISTICS_JSON_FIELD, numbers, 11);
 }
+#endif
 
-void add_error() {
-   send_usart_data_errors_counter_g++;
-   send_usart_data_errors_unresetable_counter_g++;
-   last_error_task_g = sent_task_g;
+/**
+ * Time to recover is measured from the first fault after the last successful long polling request
+ */
+void add_fault(FaultClass fault_class) {
+   if (!FAULT_RECOVERY_STATISTICS_ENABLED) {
+      return;
+   }
+
+   if (device_g->fault_recoveries[fault_class].faults < 0xFFFF) {
+      device_g->fault_recoveries[fault_class].faults++;
+   }
 
-   if (received_usart_error_data_g != NULL) {
-      free(received_usart_error_data_g);
-      received_usart_error_data_g = NULL;
+   if (!device_g->fault_recovery_in_progress) {
+      device_g->fault_recovery_in_progress = 1;
+      device_g->first_fault_class = fault_class;
+      device_g->first_fault_timestamp_ms = device_g->milliseconds_counter;
    }
-   received_usart_error_data_g = get_received_usart_error_data();
-   sent_task_g = 0;
 }
 
-void establish_long_polling_connection(unsigned int request_task) {
-   clear_piped_request_commands_to_send();
-   char *request = generate_request(ESP8226_REQUEST_SEND_STATUS_INFO_AND_ESTABLISH_LONG_POLLING_REQUEST);
+#if FAULT_RECOVERY_STATISTICS_ENABLED
+FaultClass get_response_fault_class() {
+   if (is_usart_response_contains_element(RESPONSE_SERVICE_UNAVAILABLE)) {
+      return SERVICE_UNAVAILABLE_FAULT;
+   } else if (is_usart_response_contains_element(ESP8226_RESPONSE_BUSY)) {
+      return BUSY_RESPONSE_FAULT;
+   } else if (is_usart_response_contains_element(ESP8226_RESPONSE_CLOSED)) {
+      return CONNECTION_CLOSED_FAULT;
+   } else if (is_usart_response_contains_element(USART_ERROR)) {
+      return ERROR_RESPONSE_FAULT;
+   } else {
+      return UNEXPECTED_RESPONSE_FAULT;
+   }
+}
+#endif
+
+void finish_fault_recovery() {
+   if (!FAULT_RECOVERY_STATISTICS_ENABLED || !device_g->fault_recovery_in_progress) {
+      return;
+   }
 
-   prepare_http_request(ESP8226_SERVER_IP_ADDRESS, ESP8226_SERVER_PORT, request, NULL, request_task);
+   FaultRecoveryStatistics *fault_recovery = &device_g->fault_recoveries[device_g->first_fault_class];
+   unsigned int recovery_time_ms = device_g->milliseconds_counter - device_g->first_fault_timestamp_ms;
+
+   device_g->fault_recovery_in_progress = 0;
+   fault_recovery->last_recovery_time_ms = recovery_time_ms;
+   if (recovery_time_ms > fault_recovery->max_recovery_time_ms) {
+      fault_recovery->max_recovery_time_ms = recovery_time_ms;
+   }
+   if (fault_recovery->recoveries < 0xFFFF) {
+      fault_recovery->recoveries++;
+   }
 }
 
-char *generate_request(char *request_template) {
-   char *gain = array_to_string(default_access_point_gain_g, DEFAULT_ACCESS_POINT_GAIN_SIZE);
-   //char *response_timestamp = num_to_string(calculate_response_timestamp());
-   char *response_timestamp = "-1";
-   char *debug_info_included = read_flag(&general_flags_g, SEND_DEBUG_INFO_FLAG) ? "true" : "false";
-   char *server_is_available = read_flag(&general_flags_g, SERVER_IS_AVAILABLE_FLAG) ? "true" : "false";
-   char *status_json;
-
-   if (read_flag(&general_flags_g, SEND_DEBUG_INFO_FLAG)) {
-      status_json = add_debug_info(gain, debug_info_included, response_timestamp, server_is_available);
+#if FAULT_RECOVERY_STATISTICS_ENABLED
+/**
+ * Do not forget to call free() function on returned pointer when it's no longer needed
+ */
+void *get_fault_recoveries() {
+   char *fault_recoveries = NULL;
+
+   for (unsigned char i = 0; i < FAULT_CLASSES_SIZE; i++) {
+      FaultRecoveryStatistics *fault_recovery = &device_g->fault_recoveries[i];
+
+      if (!fault_recovery->faults) {
+         continue;
+      }
+
+      char *fault_class = num_to_string(i);
+      char *faults = num_to_string(fault_recovery->faults);
+      char *recoveries = num_to_string(fault_recovery->recoveries);
+      char *last_recovery_time = num_to_string(fault_recovery->last_recovery_time_ms);
+      char *max_recovery_time = num_to_string(fault_recovery->max_recovery_time_ms);
+      char *parameters[] = {fault_recoveries != NULL ? fault_recoveries : EMPTY_STRING, fault_recoveries != NULL ? "," : EMPTY_STRING,
+            fault_class, faults, recoveries, last_recovery_time, max_recovery_time, NULL};
+      char *fault_recoveries_with_added_one = set_string_parameters(FAULT_RECOVERY_JSON_ELEMENT, parameters);
+
+      if (fault_recoveries != NULL) {
+         free(fault_recoveries);
+      }
+      free(fault_class);
+      free(faults);
+      free(recoveries);
+      free(last_recovery_time);
+      free(max_recovery_time);
+      if (fault_recoveries_with_added_one == NULL) {
+         return NULL;
+      }
+      fault_recoveries = fault_recoveries_with_added_one;
+   }
+
+   char *parameters[] = {fault_recoveries != NULL ? fault_recoveries : EMPTY_STRING, NULL};
+   char *fault_recoveries_field = set_string_parameters(FAULT_RECOVERIES_JSON_FIELD, parameters);
+
+   if (fault_recoveries != NULL) {
+      free(fault_recoveries);
+   }
+   return fault_recoveries_field;
+}
+#endif
+
+#if RAM_USAGE_STATISTICS_ENABLED
+/**
+ * Fills the RAM between the heap break and the current stack pointer with FREE_RAM_PAINT_PATTERN. Must be called before interrupts are enabled
+ */
+void paint_free_ram() {
+   unsigned int *stack_pointer = (unsigned int *) __get_MSP();
+
+   for (unsigned int *free_ram_word = get_heap_break(); free_ram_word < stack_pointer - FREE_RAM_PAINT_STACK_MARGIN_WORDS; free_ram_word++) {
+      *free_ram_word = FREE_RAM_PAINT_PATTERN;
+   }
+}
+
+/**
+ * Heap break aligned up to a word
+ */
+unsigned int *get_heap_break() {
+   return (unsigned int *) (((unsigned int) _sbrk(0) + 3) & ~3);
+}
+
+/**
+ * Static sections sizes and high-water marks. The stack one is the lowest overwritten painted word, so it's scanned on every call.
+ * Do not forget to call free() function on returned pointer when it's no longer needed
+ */
+void *get_ram_usage() {
+   unsigned int *heap_break = get_heap_break();
+   unsigned int *lowest_stack_word = heap_break;
+
+   while (lowest_stack_word < (unsigned int *) _eram && *lowest_stack_word == FREE_RAM_PAINT_PATTERN) {
+      lowest_stack_word++;
+   }
+
+   int numbers[] = {_edata - _sdata, _ebss - _sbss, (char *) heap_break - _end, _eram - (char *) lowest_stack_word,
+         (char *) lowest_stack_word - (char *) heap_break};
+   return set_number_parameters(RAM_USAGE_JSON_FIELD, numbers, 5);
+}
+#endif
+
+#if RECOVERY_STEP_STATISTICS_ENABLED
+/**
+ * Do not forget to call free() function on returned pointer when it's no longer needed
+ */
+void *get_recovery_steps() {
+   char *recovery_steps = NULL;
+
+   for (unsigned char i = 0; i < RECOVERY_STEPS_SIZE; i++) {
+      RecoveryStepStatistics *recovery_step_statistics = &device_g->recovery_steps[i];
+
+      if (!recovery_step_statistics->attempts) {
+         continue;
+      }
+
+      char *recovery_step = num_to_string(i);
+      char *attempts = num_to_string(recovery_step_statistics->attempts);
+      char *recoveries = num_to_string(recovery_step_statistics->recoveries);
+      char *last_recovery_time = num_to_string(recovery_step_statistics->last_recovery_time_ms);
+      char *max_recovery_time = num_to_string(recovery_step_statistics->max_recovery_time_ms);
+      char *parameters[] = {recovery_steps != NULL ? recovery_steps : EMPTY_STRING, recovery_steps != NULL ? "," : EMPTY_STRING,
+            recovery_step, attempts, recoveries, last_recovery_time, max_recovery_time, NULL};
+      char *recovery_steps_with_added_one = set_string_parameters(RECOVERY_STEP_JSON_ELEMENT, parameters);
+
+      if (recovery_steps != NULL) {
+         free(recovery_steps);
+      }
+      free(recovery_step);
+      free(attempts);
+      free(recoveries);
+      free(last_recovery_time);
+      free(max_recovery_time);
+      if (recovery_steps_with_added_one == NULL) {
+         return NULL;
+      }
+      recovery_steps = recovery_steps_with_added_one;
+   }
+
+   char *parameters[] = {recovery_steps != NULL ? recovery_steps : EMPTY_STRING, NULL};
+   char *recovery_steps_field = set_string_parameters(RECOVERY_STEPS_JSON_FIELD, parameters);
+
+   if (recovery_steps != NULL) {
+      free(recovery_steps);
+   }
+   return recovery_steps_field;
+}
+#endif
+
+/**
+ * Every CIPSTART starts the new trace in the ring buffer. The trace of the previous CIPSTART which hasn't connected is started
+ * again in its place, so the retries don't push the complete traces out
+ */
+void start_trace() {
+   if (!REQUEST_TRACES_ENABLED) {
+      return;
+   }
+
+   if (device_g->traces[device_g->traces_index].recorded_stages != (1 << CIPSTART_SENT_STAGE)) {
+      device_g->traces_index++;
+      if (device_g->traces_index >= TRACES_SIZE) {
+         device_g->traces_index = 0;
+      }
+   }
+
+   Trace *trace = &device_g->traces[device_g->traces_index];
+   trace->start_timestamp_ms = device_g->milliseconds_counter;
+   trace->recorded_stages = 0;
+   add_trace_stage(CIPSTART_SENT_STAGE);
+}
+
+void add_trace_stage(TraceStage stage) {
+   add_trace_stage_with_timestamp(stage, device_g->milliseconds_counter);
+}
+
+/**
+ * Only the first occurrence of the stage is recorded
+ */
+void add_trace_stage_with_timestamp(TraceStage stage, unsigned int timestamp_ms) {
+   if (!REQUEST_TRACES_ENABLED) {
+      return;
+   }
+
+   Trace *trace = &device_g->traces[device_g->traces_index];
+   unsigned char stage_flag = 1 << stage;
+
+   if (trace->recorded_stages & stage_flag) {
+      return;
+   }
+
+   // The frame may have started before the trace
+   trace->stage_offsets_ms[stage] = (int) (timestamp_ms - trace->start_timestamp_ms) > 0 ? timestamp_ms - trace->start_timestamp_ms : 0;
+   trace->recorded_stages |= stage_flag;
+}
+
+#if REQUEST_TRACES_ENABLED
+unsigned char is_trace_stage_recorded(TraceStage stage) {
+   return (device_g->traces[device_g->traces_index].recorded_stages & (1 << stage)) ? 1 : 0;
+}
+
+/**
+ * Milliseconds from CIPSTART until the response of the last long polling request has been parsed. 0 - there is no such request yet
+ */
+unsigned int calculate_response_timestamp() {
+   unsigned char trace_index = device_g->traces_index;
+
+   for (unsigned char i = 0; i < TRACES_SIZE; i++) {
+      Trace *trace = &device_g->traces[trace_index];
+
+      if (trace->recorded_stages & (1 << RESPONSE_PARSED_STAGE)) {
+         return trace->stage_offsets_ms[RESPONSE_PARSED_STAGE];
+      }
+
+      trace_index = trace_index == 0 ? TRACES_SIZE - 1 : trace_index - 1;
+   }
+   return 0;
+}
+
+/**
+ * Do not forget to call free() function on returned pointer when it's no longer needed
+ */
+void *get_traces() {
+   char *traces = NULL;
+   unsigned char trace_index = device_g->traces_index;
+
+   // From the oldest trace
+   for (unsigned char i = 0; i < TRACES_SIZE; i++) {
+      trace_index++;
+      if (trace_index >= TRACES_SIZE) {
+         trace_index = 0;
+      }
+
+      Trace *trace = &device_g->traces[trace_index];
+      if (!trace->recorded_stages) {
+         continue;
+      }
+
+      char *stage_durations[TRACE_STAGES_SIZE];
+      unsigned int latest_stage_offset_ms = 0;
+
+      // Stages aren't always recorded in their order: the payload DMA may finish after "SEND OK" has been handled and the first
+      // response byte has the frame start timestamp. Such a stage takes 0 ms
+      for (unsigned char stage = 0; stage < TRACE_STAGES_SIZE; stage++) {
+         if (trace->recorded_stages & (1 << stage)) {
+            unsigned int stage_offset_ms = trace->stage_offsets_ms[stage];
+
+            stage_durations[stage] = num_to_string(stage_offset_ms > latest_stage_offset_ms ? stage_offset_ms - latest_stage_offset_ms : 0);
+            if (stage_offset_ms > latest_stage_offset_ms) {
+               latest_stage_offset_ms = stage_offset_ms;
+            }
+         } else {
+            stage_durations[stage] = NULL_JSON_VALUE;
+         }
+      }
+
+      // A duration, which hasn't been allocated, terminates the parameters, so the trace isn't generated
+      char *parameters[TRACE_STAGES_SIZE + 3];
+      parameters[0] = traces != NULL ? traces : EMPTY_STRING;
+      parameters[1] = traces != NULL ? "," : EMPTY_STRING;
+      for (unsigned char stage = 0; stage < TRACE_STAGES_SIZE; stage++) {
+         parameters[stage + 2] = stage_durations[stage];
+      }
+      parameters[TRACE_STAGES_SIZE + 2] = NULL;
+      char *traces_with_added_one = set_string_parameters(TRACE_JSON_ELEMENT, parameters);
+
+      if (traces != NULL) {
+         free(traces);
+      }
+      for (unsigned char stage = 0; stage < TRACE_STAGES_SIZE; stage++) {
+         if (trace->recorded_stages & (1 << stage)) {
+            free(stage_durations[stage]);
+         }
+      }
+      if (traces_with_added_one == NULL) {
+         return NULL;
+      }
+      traces = traces_with_added_one;
+   }
+
+   char *parameters[] = {traces != NULL ? traces : EMPTY_STRING, NULL};
+   char *traces_field = set_string_parameters(TRACES_JSON_FIELD, parameters);
+
+   if (traces != NULL) {
+      free(traces);
+   }
+   return traces_field;
+}
+#endif
+
+/**
+ * Retransmission timeout as in TCP: smoothed RTT + 4 * RTT variance, doubled on every consecutive timeout
+ */
+unsigned int get_command_class_timeout(CommandClass command_class) {
+   CommandClassTimeoutBounds *bounds = &COMMAND_CLASS_TIMEOUT_BOUNDS[command_class];
+   CommandClassTimeout *timeout = &device_g->command_class_timeouts[command_class];
+
+   if (!ADAPTIVE_COMMAND_TIMEOUTS_ENABLED || !timeout->scaled_smoothed_rtt_ms) {
+      return bounds->max_timeout_ms;
+   }
+
+   unsigned int timeout_ms = (timeout->scaled_smoothed_rtt_ms >> 3) + timeout->scaled_rtt_variance_ms;
+
+   if (timeout_ms < bounds->min_timeout_ms) {
+      timeout_ms = bounds->min_timeout_ms;
+   }
+   timeout_ms <<= timeout->consecutive_timeouts;
+
+   if (timeout_ms > bounds->max_timeout_ms) {
+      timeout_ms = bounds->max_timeout_ms;
+   }
+   return timeout_ms;
+}
+
+/**
+ * Up to 1/8 random jitter is added after a timeout, so the retries don't fire in lockstep with the ESP8266 and the server
+ */
+unsigned int get_scheduled_command_timeout() {
+   unsigned int timeout_ms = get_command_class_timeout(device_g->scheduled_command_class);
+
+   if (ADAPTIVE_COMMAND_TIMEOUTS_ENABLED && device_g->command_class_timeouts[device_g->scheduled_command_class].consecutive_timeouts) {
+      timeout_ms += get_random_number() % (timeout_ms / 8 + 1);
+   }
+   return timeout_ms;
+}
+
+/**
+ * The time since the last sending till the successful response. Long polling requests are held by the server, so they aren't measured
+ */
+void add_command_rtt_sample() {
+   CommandClass command_class = device_g->scheduled_command_class;
+   CommandClassTimeout *timeout = &device_g->command_class_timeouts[command_class];
+
+   if (!ADAPTIVE_COMMAND_TIMEOUTS_ENABLED || command_class == LONG_POLLING_COMMAND_CLASS || device_g->scheduled_command_resent) {
+      return;
+   }
+
+   unsigned int rtt_ms = device_g->milliseconds_counter - device_g->command_sent_timestamp_ms;
+
+   if (rtt_ms == 0) {
+      rtt_ms = 1;
+   }
+
+   if (!timeout->scaled_smoothed_rtt_ms) {
+      timeout->scaled_smoothed_rtt_ms = rtt_ms << 3;
+      timeout->scaled_rtt_variance_ms = rtt_ms << 1;
    } else {
-      char *parameters_for_status[] = {gain, debug_info_included, response_timestamp, server_is_available, ESP8226_OWN_DEVICE_NAME, NULL};
-      status_json = set_string_parameters(STATUS_JSON, parameters_for_status);
+      int rtt_error_ms = (int) rtt_ms - (int) (timeout->scaled_smoothed_rtt_ms >> 3);
+
+      timeout->scaled_smoothed_rtt_ms += rtt_error_ms;
+      if (rtt_error_ms < 0) {
+         rtt_error_ms = -rtt_error_ms;
+      }
+      timeout->scaled_rtt_variance_ms += rtt_error_ms - (int) (timeout->scaled_rtt_variance_ms >> 2);
    }
-   free(gain);
+   timeout->consecutive_timeouts = 0;
+}
+
+void on_command_timeout() {
+   CommandClassTimeout *timeout = &device_g->command_class_timeouts[device_g->scheduled_command_class];
 
-   if (received_usart_error_data_g != NULL) {
-      free(received_usart_error_data_g);
-      received_usart_error_data_g = NULL;
+   if (ADAPTIVE_COMMAND_TIMEOUTS_ENABLED && timeout->consecutive_timeouts < COMMAND_TIMEOUT_MAX_BACKOFF_SHIFT) {
+      timeout->consecutive_timeouts++;
    }
+   device_g->scheduled_command_resent = 1;
+   device_g->send_usart_data_timeout_ms = get_scheduled_command_timeout();
+   // A silent ESP8266 has to lead to the recovery too
+   device_g->send_usart_data_errors_counter++;
+}
 
-   unsigned short status_string_length = get_string_length(status_json);
-   char *status_string_length_string = num_to_string(status_string_length);
-   char *parameters_for_request[] = {status_string_length_string, ESP8226_SERVER_IP_ADDRESS, status_json, NULL};
-   char *request = set_string_parameters(request_template, parameters_for_request);
+/**
+ * Xorshift generator mixed with the current time
+ */
+unsigned int get_random_number() {
+   unsigned int random_number = device_g->random_number_seed;
+
+   random_number ^= random_number << 13;
+   random_number ^= random_number >> 17;
+   random_number ^= random_number << 5;
+   device_g->random_number_seed = random_number;
+   return random_number ^ device_g->milliseconds_counter;
+}
 
-   free(status_json);
-   free(status_string_length_string);
-   return request;
+#if COMMAND_TIMEOUT_STATISTICS_ENABLED
+void *get_command_timeouts() {
+   char *command_timeouts = NULL;
+
+   for (unsigned char i = 0; i < COMMAND_CLASSES_SIZE; i++) {
+      char *command_class = num_to_string(i);
+      char *smoothed_rtt = num_to_string(device_g->command_class_timeouts[i].scaled_smoothed_rtt_ms >> 3);
+      char *timeout = num_to_string(get_command_class_timeout(i));
+      char *consecutive_timeouts = num_to_string(device_g->command_class_timeouts[i].consecutive_timeouts);
+      char *parameters[] = {command_timeouts != NULL ? command_timeouts : EMPTY_STRING, command_timeouts != NULL ? "," : EMPTY_STRING,
+            command_class, smoothed_rtt, timeout, consecutive_timeouts, NULL};
+      char *command_timeouts_with_added_one = set_string_parameters(COMMAND_TIMEOUT_JSON_ELEMENT, parameters);
+
+      if (command_timeouts != NULL) {
+         free(command_timeouts);
+      }
+      free(command_class);
+      free(smoothed_rtt);
+      free(timeout);
+      free(consecutive_timeouts);
+      if (command_timeouts_with_added_one == NULL) {
+         return NULL;
+      }
+      command_timeouts = command_timeouts_with_added_one;
+   }
+
+   char *parameters[] = {command_timeouts, NULL};
+   char *command_timeouts_field = set_string_parameters(COMMAND_TIMEOUTS_JSON_FIELD, parameters);
+
+   free(command_timeouts);
+   return command_timeouts_field;
 }
+#endif
 
-void *add_debug_info(char *gain, char *debug_info_included, char *response_timestamp, char *server_is_available) {
-   char *errors_amount_string = num_to_string(send_usart_data_errors_unresetable_counter_g);
-   char *usart_overrun_errors_counter_string = num_to_string(usart_overrun_errors_counter_g);
-   char *usart_idle_line_detection_counter_string = num_to_string(usart_idle_line_detection_counter_g);
-   char *usart_noise_detection_counter_string = num_to_string(usart_noise_detection_counter_g);
-   char *usart_framing_errors_counter_string = num_to_string(usart_framing_errors_counter_g);
-   char *last_error_task_string = num_to_string(last_error_task_g);
-   char *received_usart_error_data = last_error_task_g && received_usart_error_data_g != NULL ? received_usart_error_data_g : "";
-   char *parameters_for_status[] = {gain, debug_info_included, errors_amount_string, usart_overrun_errors_counter_string,
-         usart_idle_line_detection_counter_string, usart_noise_detection_counter_string, usart_framing_errors_counter_string,
-         last_error_task_string, received_usart_error_data, response_timestamp, server_is_available, ESP8226_OWN_DEVICE_NAME, NULL};
-   char *status_json = set_string_parameters(DEBUG_STATUS_JSON, parameters_for_status);
-
-   free(errors_amount_string);
-   free(usart_overrun_errors_counter_string);
-   free(usart_idle_line_detection_counter_string);
-   free(usart_noise_detection_counter_string);
-   free(usart_framing_errors_counter_string);
-   free(last_error_task_string);
+/**
+ * Do not forget to call free() function on returned pointer when it's no longer needed. NULL is returned if the value hasn't been changed
+ */
+char *get_changed_status_field(char field_template[], unsigned int value, unsigned int acknowledged_value) {
+   if (value == acknowledged_value && !read_flag(&device_g->general_flags, FULL_STATUS_REQUIRED_FLAG)) {
+      return NULL;
+   }
+
+   char *value_string = num_to_string(value);
+   char *field = get_status_field(field_template, value_string);
+   free(value_string);
+   return field;
+}
+
+/**
+ * Do not forget to call free() function on returned pointer when it's no longer needed
+ */
+char *get_status_field(char field_template[], char *value) {
+   char *parameters[] = {value, NULL};
+   return set_string_parameters(field_template, parameters);
+}
+
+/**
+ * The server has received the status, so the next requests contain only the fields changed since this one
+ */
+void acknowledge_sent_status() {
+   device_g->acknowledged_status = device_g->sent_status;
 
-   last_error_task_g = 0;
-   return status_json;
+   if (device_g->sent_status.full_status) {
+      reset_flag(&device_g->general_flags, FULL_STATUS_REQUIRED_FLAG);
+   }
 }
 
 void get_own_ip_address() {
    send_usard_data(ESP8226_REQUEST_GET_OWN_IP_ADDRESS);
-   set_flag(&sent_task_g, GET_OWN_IP_ADDRESS_TASK);
+   set_flag(&device_g->sent_task, GET_OWN_IP_ADDRESS_TASK);
 }
 
 void set_own_ip_address() {
    char *parameters[] = {ESP8226_OWN_IP_ADDRESS, NULL};
-   usart_data_to_be_transmitted_buffer_g = set_string_parameters(ESP8226_REQUEST_SET_OWN_IP_ADDRESS, parameters);
-   send_usard_data(usart_data_to_be_transmitted_buffer_g);
-   set_flag(&sent_task_g, SET_OWN_IP_ADDRESS_TASK);
+   device_g->usart_data_to_be_transmitted_buffer = set_string_parameters(ESP8226_REQUEST_SET_OWN_IP_ADDRESS, parameters);
+   send_usard_data(device_g->usart_data_to_be_transmitted_buffer);
+   set_flag(&device_g->sent_task, SET_OWN_IP_ADDRESS_TASK);
 }
 
 void close_connection() {
    send_usard_data(ESP8226_REQUEST_DISCONNECT_FROM_SERVER);
-   set_flag(&sent_task_g, CLOSE_CONNECTION_TASK);
+   set_flag(&device_g->sent_task, CLOSE_CONNECTION_TASK);
 }
 
 void get_current_default_wifi_mode() {
    send_usard_data(ESP8226_REQUEST_GET_CURRENT_DEFAULT_WIFI_MODE);
-   set_flag(&sent_task_g, GET_CURRENT_DEFAULT_WIFI_MODE_TASK);
+   set_flag(&device_g->sent_task, GET_CURRENT_DEFAULT_WIFI_MODE_TASK);
 }
 
 void set_default_wifi_mode() {
    send_usard_data(ESP8226_REQUEST_SET_DEFAULT_STATION_WIFI_MODE);
-   set_flag(&sent_task_g, SET_DEFAULT_STATION_WIFI_MODE_TASK);
+   set_flag(&device_g->sent_task, SET_DEFAULT_STATION_WIFI_MODE_TASK);
 }
 
 /**
  * "request" shall be allocated with "malloc" function. Later it will be removed with "free" function
  */
-void prepare_http_request(char address[], char port[], char request[], void (*execute_on_response)(), unsigned int request_task) {
+/**
+ * Returns 0 when the request or any of its commands hasn't been allocated. The request is freed then
+ */
+unsigned char prepare_http_request(char address[], char port[], char request[], void (*execute_on_response)(), unsigned int request_task) {
    clear_piped_request_commands_to_send();
-   scheduled_function_to_execute_on_error_g = NULL;
+   device_g->scheduled_function_to_execute_on_error = NULL;
+
+   if (request == NULL) {
+      return 0;
+   }
 
    char *parameters[] = {address, port, NULL};
-   piped_request_commands_to_send_g[PIPED_REQUEST_CIPSTART_COMMAND_INDEX] = set_string_parameters(ESP8226_REQUEST_CONNECT_TO_SERVER, parameters);
+   device_g->piped_request_commands_to_send[PIPED_REQUEST_CIPSTART_COMMAND_INDEX] = set_string_parameters(ESP8226_REQUEST_CONNECT_TO_SERVER, parameters);
 
    unsigned short request_length = get_string_length(request);
    char *request_length_string = num_to_string(request_length);
    char *start_sending_parameters[] = {request_length_string, NULL};
-   piped_request_commands_to_send_g[PIPED_REQUEST_CIPSEND_COMMAND_INDEX] = set_string_parameters(ESP8226_REQUEST_START_SENDING, start_sending_parameters);
+   device_g->piped_request_commands_to_send[PIPED_REQUEST_CIPSEND_COMMAND_INDEX] = set_string_parameters(ESP8226_REQUEST_START_SENDING, start_sending_parameters);
    free(request_length_string);
 
-   piped_request_commands_to_send_g[PIPED_REQUEST_INDEX] = request;
+   device_g->piped_request_commands_to_send[PIPED_REQUEST_INDEX] = request;
+
+   if (device_g->piped_request_commands_to_send[PIPED_REQUEST_CIPSTART_COMMAND_INDEX] == NULL ||
+         device_g->piped_request_commands_to_send[PIPED_REQUEST_CIPSEND_COMMAND_INDEX] == NULL) {
+      clear_piped_request_commands_to_send();
+      return 0;
+   }
 
-   on_response_g = execute_on_response;
+   device_g->on_response = execute_on_response;
 
+   if (LINK_STATUS_QUERY_ENABLED) {
+      add_piped_task_to_send_into_tail(GET_LINK_STATUS_TASK);
+   }
    add_piped_task_to_send_into_tail(CONNECT_TO_SERVER_TASK);
    add_piped_task_to_send_into_tail(SET_BYTES_TO_SEND_IN_REQUEST_TASK);
    add_piped_task_to_send_into_tail(request_task);
+   return 1;
 }
 
 void resend_usart_http_request_using_global_final_task() {
-   resend_usart_http_request(final_task_for_request_resending_g);
+   resend_usart_http_request(device_g->final_task_for_request_resending);
 }
 
 void resend_usart_http_request(unsigned int final_task) {
-   scheduled_function_to_execute_on_error_g = NULL;
+   device_g->scheduled_function_to_execute_on_error = NULL;
    add_piped_task_to_send_into_tail(final_task);
 }
 
 void clear_piped_request_commands_to_send() {
+   // The ISR mustn't send the request being freed
+   device_g->payload_armed_for_prompt = 0;
+   device_g->payload_sent_on_prompt = 0;
+
    for (unsigned char i = 0; i < PIPED_REQUEST_COMMANDS_TO_SEND_SIZE; i++) {
-      char *command = piped_request_commands_to_send_g[i];
+      char *command = device_g->piped_request_commands_to_send[i];
       if (command != NULL) {
          free(command);
-         piped_request_commands_to_send_g[i] = NULL;
+         device_g->piped_request_commands_to_send[i] = NULL;
       }
    }
 }
 
 void connect_to_server() {
-   if (piped_request_commands_to_send_g[PIPED_REQUEST_CIPSTART_COMMAND_INDEX] == NULL) {
+   if (device_g->piped_request_commands_to_send[PIPED_REQUEST_CIPSTART_COMMAND_INDEX] == NULL) {
       return;
    }
 
-   send_usard_data(piped_request_commands_to_send_g[PIPED_REQUEST_CIPSTART_COMMAND_INDEX]);
-   set_flag(&sent_task_g, CONNECT_TO_SERVER_TASK);
+   start_trace();
+   send_usard_data(device_g->piped_request_commands_to_send[PIPED_REQUEST_CIPSTART_COMMAND_INDEX]);
+   set_flag(&device_g->sent_task, CONNECT_TO_SERVER_TASK);
 }
 
 void set_bytes_amount_to_send() {
-   if (piped_request_commands_to_send_g[PIPED_REQUEST_CIPSEND_COMMAND_INDEX] == NULL) {
+   if (device_g->piped_request_commands_to_send[PIPED_REQUEST_CIPSEND_COMMAND_INDEX] == NULL) {
       return;
    }
 
-   send_usard_data(piped_request_commands_to_send_g[PIPED_REQUEST_CIPSEND_COMMAND_INDEX]);
-   set_flag(&sent_task_g, SET_BYTES_TO_SEND_IN_REQUEST_TASK);
+   device_g->payload_sent_on_prompt = 0;
+   device_g->payload_armed_for_prompt = PAYLOAD_ON_PROMPT_ENABLED;
+   send_usard_data(device_g->piped_request_commands_to_send[PIPED_REQUEST_CIPSEND_COMMAND_INDEX]);
+   set_flag(&device_g->sent_task, SET_BYTES_TO_SEND_IN_REQUEST_TASK);
 }
 
 void send_request(unsigned int sent_task_to_set) {
-   if (piped_request_commands_to_send_g[PIPED_REQUEST_INDEX] == NULL) {
+   if (device_g->piped_request_commands_to_send[PIPED_REQUEST_INDEX] == NULL) {
       return;
    }
 
-   send_usard_data(piped_request_commands_to_send_g[PIPED_REQUEST_INDEX]);
-   set_flag(&sent_task_g, sent_task_to_set);
-}
+   char *request = device_g->piped_request_commands_to_send[PIPED_REQUEST_INDEX];
 
-void on_successfully_receive_general_actions(unsigned int sent_task) {
-   scheduled_function_to_execute_on_error_g = NULL;
-   send_usart_data_errors_counter_g = 0;
-   reset_flag(&sent_task_g, sent_task);
-   //delete_current_piped_task();
+   if (PAYLOAD_ON_PROMPT_ENABLED && device_g->payload_sent_on_prompt) {
+      // Already being transmitted by the USART ISR. Only the bookkeeping of send_usard_data() is left
+      device_g->payload_sent_on_prompt = 0;
+      device_g->command_sent_timestamp_ms = device_g->milliseconds_counter;
+      clear_usart_data_received_buffer();
+      count_sent_usart_data(get_string_length(request));
+   } else {
+      device_g->payload_armed_for_prompt = 0;
+      device_g->payload_is_being_sent = 1;
+      device_g->request_on_wire_time_us = get_microseconds() - device_g->poll_decided_timestamp_us;
+      send_usard_data(request);
+   }
+   set_flag(&device_g->sent_task, sent_task_to_set);
 }
 
-void fill_default_access_point_gain() {
-   default_access_point_gain_g[DEFAULT_ACCESS_POINT_GAIN_SIZE - 1] = '1';
-   default_access_point_gain_g[DEFAULT_ACCESS_POINT_GAIN_SIZE - 2] = '-';
+/**
+ * The prompt is "> " at the line start. The data of the links may contain anything including "\r\n> ", so the prompt isn't
+ * awaited any more once "+IPD," has been received. send_request() sends the payload then
+ */
+void check_payload_prompt() {
+   char *line = device_g->usart_data_received_buffers[device_g->usart_receiving_buffer_index] + device_g->usart_received_line_end_bytes;
+   unsigned short line_bytes = device_g->usart_received_bytes - device_g->usart_received_line_end_bytes;
+
+   if (line_bytes == 2 && line[0] == '>' && line[1] == ' ') {
+      send_payload_on_prompt();
+   } else if (line_bytes == 5 && is_string_starts_with(line, ESP8226_RESPONSE_LINK_DATA_PREFIX)) {
+      device_g->payload_armed_for_prompt = 0;
+   }
 }
 
-// +CWLAP:("Asus",-74,...)
-void save_default_access_point_gain() {
-   if (!is_usart_response_contains_element(DEFAULT_ACCESS_POINT_NAME)) {
+/**
+ * Called from the USART ISR on "> " after CIPSEND. The payload goes out right away instead of after the idle gap, the main loop
+ * turn and the handlers chain. send_request() does the rest when the prompt response is handled
+ */
+void send_payload_on_prompt() {
+   char *request = device_g->piped_request_commands_to_send[PIPED_REQUEST_INDEX];
+
+   device_g->payload_armed_for_prompt = 0;
+   if (request == NULL) {
       return;
    }
 
-   for (unsigned char i = 0; i < DEFAULT_ACCESS_POINT_GAIN_SIZE; i++) {
-      default_access_point_gain_g[i] = ' ';
-   }
+   device_g->payload_sent_on_prompt = 1;
+   device_g->payload_is_being_sent = 1;
+   device_g->request_on_wire_time_us = get_microseconds() - device_g->poll_decided_timestamp_us;
+   device_g->payloads_sent_on_prompt_counter++;
+   add_trace_stage(SEND_PROMPT_STAGE);
+   start_usart_dma_transmission(request, get_string_length(request));
+}
 
-   unsigned char first_comma_is_found = 0;
-   char *current_character = strstr(usart_data_received_buffer_g, DEFAULT_ACCESS_POINT_NAME);
+void on_successfully_receive_general_actions(unsigned int sent_task) {
+   if (device_g->scheduled_function_to_execute_on_error != NULL) {
+      add_command_rtt_sample();
+   }
+   device_g->scheduled_function_to_execute_on_error = NULL;
+   device_g->send_usart_data_errors_counter = 0;
+   reset_flag(&device_g->sent_task, sent_task);
+   //delete_current_piped_task();
+}
 
-   if (current_character == NULL) {
-      fill_default_access_point_gain();
+// +CWLAP:("Asus",-74,...)
+void on_visible_network_line(char *line) {
+   if (!is_string_starts_with(line, ESP8226_RESPONSE_VISIBLE_NETWORK_LIST_PREFIX)) {
       return;
    }
 
-   while (*current_character != '\0') {
-      if (first_comma_is_found && *current_character == ',') {
-         current_character--;
+   device_g->visible_networks_received = 1;
+   save_default_access_point_rssi(line);
+}
+
+/**
+ * The RSSI follows the access point name: +CWLAP:(3,"Asus",-67,...) or +CWJAP:"Asus","aa:bb:cc:dd:ee:ff",6,-67. The name is
+ * compared as the whole quoted field, so a neighbour "Asus_5G" isn't taken for "Asus"
+ */
+void save_default_access_point_rssi(char *received_data) {
+   // +CWLAP has the RSSI after the name, +CWJAP after the BSSID and the channel
+   unsigned char commas_before_rssi = is_string_starts_with(received_data, ESP8226_RESPONSE_VISIBLE_NETWORK_LIST_PREFIX) ? 1 : 3;
+   unsigned short name_length = get_string_length(DEFAULT_ACCESS_POINT_NAME);
+   char *current_character = received_data;
+   signed char rssi_dbm;
+
+   for (; *current_character != '\0'; current_character++) {
+      if (*current_character == '\"' && is_string_starts_with(current_character + 1, DEFAULT_ACCESS_POINT_NAME) &&
+            *(current_character + 1 + name_length) == '\"') {
          break;
       }
+   }
 
+   for (; *current_character != '\0' && commas_before_rssi; current_character++) {
       if (*current_character == ',') {
-         first_comma_is_found = 1;
+         commas_before_rssi--;
       }
-      current_character++;
    }
+   if (!commas_before_rssi && parse_rssi(current_character, &rssi_dbm)) {
+      add_rssi_sample(rssi_dbm);
+   }
+}
 
-   for (unsigned char i = DEFAULT_ACCESS_POINT_GAIN_SIZE - 1; i != 0xFF; i--) {
-      if (*current_character == ',') {
-         for (unsigned char i2 = i; i2 != 0xFF; i2--) {
-            default_access_point_gain_g[i2] = ' ';
-         }
-         break;
-      }
+/**
+ * @return 0 if there is no negative number
+ */
+unsigned char parse_rssi(char *string, signed char *rssi_dbm) {
+   if (*string != '-' || *(string + 1) < '0' || *(string + 1) > '9') {
+      return 0;
+   }
 
-      if (*current_character != '-' && (*current_character < '0' || *current_character > '9')) {
-         fill_default_access_point_gain();
-         break;
+   unsigned int attenuation_db = string_to_num(string + 1);
+
+   *rssi_dbm = attenuation_db > 127 ? -127 : -(signed char) attenuation_db;
+   return 1;
+}
+
+void add_rssi_sample(signed char rssi_dbm) {
+   RssiStatistics *rssi = &device_g->rssi;
+
+   if (!rssi->samples) {
+      rssi->min_dbm = rssi_dbm;
+      rssi->max_dbm = rssi_dbm;
+      rssi->scaled_fast_average_dbm = rssi_dbm * 4;
+      rssi->scaled_slow_average_dbm = rssi_dbm * 16;
+   } else {
+      rssi->scaled_fast_average_dbm += rssi_dbm - (rssi->scaled_fast_average_dbm >> 2);
+      rssi->scaled_slow_average_dbm += rssi_dbm - (rssi->scaled_slow_average_dbm >> 4);
+   }
+   if (rssi_dbm < rssi->min_dbm) {
+      rssi->min_dbm = rssi_dbm;
+   }
+   if (rssi_dbm > rssi->max_dbm) {
+      rssi->max_dbm = rssi_dbm;
+   }
+   // The mean is restarted before the sum can overflow
+   if (rssi->samples == 0xFFFF) {
+      rssi->samples = 0;
+      rssi->sum_dbm = 0;
+   }
+   rssi->samples++;
+   rssi->sum_dbm += rssi_dbm;
+   rssi->last_dbm = rssi_dbm;
+}
+
+signed char get_smoothed_rssi() {
+   return device_g->rssi.samples ? (signed char) (device_g->rssi.scaled_fast_average_dbm >> 2) : UNKNOWN_RSSI_DBM;
+}
+
+/**
+ * Averages the samples the DMA has written so far. Called every second
+ */
+void update_health_measurements() {
+   if (device_g->health_measurement_timer) {
+      return;
+   }
+   device_g->health_measurement_timer = TIMER14_1S;
+
+   unsigned int temperature_sensor_sum = 0;
+   unsigned int vrefint_sum = 0;
+   unsigned char samples = 0;
+
+   for (unsigned char i = 0; i < HEALTH_SAMPLES_SIZE; i += 2) {
+      // Not written yet
+      if (!device_g->health_samples[i + 1]) {
+         continue;
       }
-      default_access_point_gain_g[i] = *current_character;
-      current_character--;
+      temperature_sensor_sum += device_g->health_samples[i];
+      vrefint_sum += device_g->health_samples[i + 1];
+      samples++;
    }
+   if (!samples) {
+      return;
+   }
+
+   unsigned short supply_voltage_mv = (unsigned short) (CALIBRATION_VDDA_MV * VREFINT_CAL * samples / vrefint_sum);
+   // The sensor conversion is scaled to the calibration supply
+   int temperature_sensor = (int) (temperature_sensor_sum * supply_voltage_mv / samples / CALIBRATION_VDDA_MV);
+   signed char die_temperature_c = (signed char) (((int) TEMPERATURE_SENSOR_CAL_30C - temperature_sensor) * 1000 / TEMPERATURE_SENSOR_AVERAGE_SLOPE + 30);
+
+   if (!device_g->supply_voltage_mv) {
+      device_g->min_supply_voltage_mv = supply_voltage_mv;
+      device_g->max_supply_voltage_mv = supply_voltage_mv;
+      device_g->min_die_temperature_c = die_temperature_c;
+      device_g->max_die_temperature_c = die_temperature_c;
+   }
+   if (supply_voltage_mv < device_g->min_supply_voltage_mv) {
+      device_g->min_supply_voltage_mv = supply_voltage_mv;
+   }
+   if (supply_voltage_mv > device_g->max_supply_voltage_mv) {
+      device_g->max_supply_voltage_mv = supply_voltage_mv;
+   }
+   if (die_temperature_c < device_g->min_die_temperature_c) {
+      device_g->min_die_temperature_c = die_temperature_c;
+   }
+   if (die_temperature_c > device_g->max_die_temperature_c) {
+      device_g->max_die_temperature_c = die_temperature_c;
+   }
+   device_g->supply_voltage_mv = supply_voltage_mv;
+   device_g->die_temperature_c = die_temperature_c;
+}
+
+void *get_health_measurements() {
+   if (!device_g->supply_voltage_mv) {
+      return NULL;
+   }
+
+   int numbers[] = {device_g->supply_voltage_mv, device_g->min_supply_voltage_mv, device_g->max_supply_voltage_mv, device_g->die_temperature_c,
+         device_g->min_die_temperature_c, device_g->max_die_temperature_c};
+   return set_number_parameters(HEALTH_JSON_FIELD, numbers, 6);
+}
+
+void *get_rssi_statistics() {
+   RssiStatistics *rssi = &device_g->rssi;
+
+   if (!rssi->samples) {
+      return NULL;
+   }
+
+   // Positive trend - the signal is getting stronger
+   int numbers[] = {rssi->last_dbm, get_smoothed_rssi(), rssi->sum_dbm / (int) rssi->samples, rssi->min_dbm, rssi->max_dbm,
+         (rssi->scaled_fast_average_dbm * 4 - rssi->scaled_slow_average_dbm) / 16, rssi->samples};
+   return set_number_parameters(RSSI_JSON_FIELD, numbers, 7);
 }
 
 unsigned int get_current_piped_task_to_send() {
-   return piped_tasks_to_send_g[0];
+   return device_g->piped_tasks_to_send[0];
 }
 
 void delete_current_piped_task() {
-   for (unsigned char i = 0; piped_tasks_to_send_g[i] != 0; i++) {
-      unsigned int next_task = piped_tasks_to_send_g[i + 1];
-      piped_tasks_to_send_g[i] = next_task;
+   for (unsigned char i = 0; device_g->piped_tasks_to_send[i] != 0; i++) {
+      unsigned int next_task = device_g->piped_tasks_to_send[i + 1];
+      device_g->piped_tasks_to_send[i] = next_task;
    }
 }
 
 void add_piped_task_to_send_into_tail(unsigned int task) {
    for (unsigned char i = 0; i < PIPED_TASKS_TO_SEND_SIZE; i++) {
-      if (piped_tasks_to_send_g[i] == 0) {
-         piped_tasks_to_send_g[i] = task;
+      if (device_g->piped_tasks_to_send[i] == 0) {
+         device_g->piped_tasks_to_send[i] = task;
          break;
       }
    }
@@ -1108,20 +4107,20 @@ void add_piped_task_to_send_into_tail(unsigned int task) {
 
 void add_piped_task_to_send_into_head(unsigned int task) {
    for (unsigned char i = PIPED_TASKS_TO_SEND_SIZE - 1; i != 0; i--) {
-      piped_tasks_to_send_g[i] = piped_tasks_to_send_g[i - 1];
+      device_g->piped_tasks_to_send[i] = device_g->piped_tasks_to_send[i - 1];
    }
-   piped_tasks_to_send_g[0] = task;
+   device_g->piped_tasks_to_send[0] = task;
 }
 
 void delete_piped_task(unsigned int task) {
    unsigned char task_is_found = 0;
    for (unsigned char i = 0; i < PIPED_TASKS_TO_SEND_SIZE; i++) {
-      if (piped_tasks_to_send_g[i] == task || task_is_found) {
-         piped_tasks_to_send_g[i] = piped_tasks_to_send_g[i + 1];
+      if (device_g->piped_tasks_to_send[i] == task || task_is_found) {
+         device_g->piped_tasks_to_send[i] = device_g->piped_tasks_to_send[i + 1];
          task_is_found = 1;
       }
 
-      if (piped_tasks_to_send_g[i] == 0) {
+      if (device_g->piped_tasks_to_send[i] == 0) {
          break;
       }
    }
@@ -1129,13 +4128,13 @@ void delete_piped_task(unsigned int task) {
 
 void delete_all_piped_tasks() {
    for (unsigned char i = 0; i < PIPED_TASKS_TO_SEND_SIZE; i++) {
-     piped_tasks_to_send_g[i] = 0;
+     device_g->piped_tasks_to_send[i] = 0;
    }
 }
 
 unsigned char is_piped_task_to_send_scheduled(unsigned int task) {
    for (unsigned char i = 0; i < PIPED_TASKS_TO_SEND_SIZE; i++) {
-     if (piped_tasks_to_send_g[i] == task) {
+     if (device_g->piped_tasks_to_send[i] == task) {
         return 1;
      }
    }
@@ -1143,11 +4142,11 @@ unsigned char is_piped_task_to_send_scheduled(unsigned int task) {
 }
 
 unsigned char is_piped_tasks_scheduler_full() {
-   return piped_tasks_to_send_g[PIPED_TASKS_TO_SEND_SIZE - 2] != 0 ? 1 : 0;
+   return device_g->piped_tasks_to_send[PIPED_TASKS_TO_SEND_SIZE - 2] != 0 ? 1 : 0;
 }
 
 unsigned char is_piped_tasks_scheduler_empty() {
-   return piped_tasks_to_send_g[0] == 0 ? 1 : 0;
+   return device_g->piped_tasks_to_send[0] == 0 ? 1 : 0;
 }
 
 void add_piped_task_into_history(unsigned int task) {
@@ -1155,11 +4154,11 @@ void add_piped_task_into_history(unsigned int task) {
       return;
    }
 
-   if (piped_tasks_history_index_g >= PIPED_TASKS_HISTORY_SIZE) {
-      piped_tasks_history_index_g = 0;
+   if (device_g->piped_tasks_history_index >= PIPED_TASKS_HISTORY_SIZE) {
+      device_g->piped_tasks_history_index = 0;
    }
 
-   piped_tasks_history_g[piped_tasks_history_index_g] = task;
+   device_g->piped_tasks_history[device_g->piped_tasks_history_index] = task;
 }
 
 void add_sent_task_into_history(unsigned int task) {
@@ -1167,36 +4166,40 @@ void add_sent_task_into_history(unsigned int task) {
       return;
    }
 
-   if (sent_tasks_history_index_g >= SENT_TASKS_HISTORY_SIZE) {
-      sent_tasks_history_index_g = 0;
+   if (device_g->sent_tasks_history_index >= SENT_TASKS_HISTORY_SIZE) {
+      device_g->sent_tasks_history_index = 0;
    }
 
-   sent_tasks_history_g[sent_tasks_history_index_g] = task;
-   sent_tasks_history_index_g++;
+   device_g->sent_tasks_history[device_g->sent_tasks_history_index] = task;
+   device_g->sent_tasks_history_index++;
 }
 
 unsigned int get_last_piped_task_in_history() {
    for (unsigned char i = PIPED_TASKS_HISTORY_SIZE - 1; i != 0xFF; i--) {
-      if (piped_tasks_history_g[i] != 0) {
-         return piped_tasks_history_g[i];
+      if (device_g->piped_tasks_history[i] != 0) {
+         return device_g->piped_tasks_history[i];
       }
    }
-   return piped_tasks_history_g[0];
+   return device_g->piped_tasks_history[0];
 }
 
 void *get_received_usart_error_data() {
    unsigned char received_data_length = 0;
 
    while (received_data_length < RECEIVED_USART_DATA_FOR_DEBUG_INFO_MAX_LENGTH &&
-         usart_data_received_buffer_g[received_data_length] != '\0') {
+         device_g->usart_data_received_buffer[received_data_length] != '\0') {
       received_data_length++;
    }
 
    // 1 is for '\0' as the last character
-   char *result_string = malloc(received_data_length + 1);
+   char *result_string = counted_malloc(received_data_length + 1);
+
+   if (result_string == NULL) {
+      return NULL;
+   }
 
    for (unsigned char i = 0; i < received_data_length; i++) {
-      char received_char = usart_data_received_buffer_g[i];
+      char received_char = device_g->usart_data_received_buffer[i];
 
       if (received_char < ' ' || received_char == '\"') {
          if (received_char == '\r') {
@@ -1216,7 +4219,7 @@ void *get_received_usart_error_data() {
 }
 
 unsigned char is_usart_response_contains_element(char string_to_be_contained[]) {
-   if (contains_string(usart_data_received_buffer_g, string_to_be_contained)) {
+   if (contains_string(device_g->usart_data_received_buffer, string_to_be_contained)) {
       return 1;
    } else {
       return 0;
@@ -1226,7 +4229,7 @@ unsigned char is_usart_response_contains_element(char string_to_be_contained[])
 //char *data_to_be_contained[] = {ESP8226_REQUEST_DISABLE_ECHO, USART_OK};
 unsigned char is_usart_response_contains_elements(char *data_to_be_contained[], unsigned char elements_count) {
    for (unsigned char elements_index = 0; elements_index < elements_count; elements_index++) {
-      if (!contains_string(usart_data_received_buffer_g, data_to_be_contained[elements_index])) {
+      if (!contains_string(device_g->usart_data_received_buffer, data_to_be_contained[elements_index])) {
          return 0;
       }
    }
@@ -1242,14 +4245,16 @@ unsigned char contains_string(char being_compared_string[], char string_to_be_co
 
    for (; *being_compared_string != '\0'; being_compared_string++) {
       unsigned char all_chars_are_equal = 1;
+      // The comparison starts again from the next character, so "\r\n\r\nSEND OK" contains "\r\nSEND OK"
+      char *compared_char_address = being_compared_string;
 
       for (char *char_address = string_to_be_contained; *char_address != '\0';
-            char_address++, being_compared_string++) {
-         if (*being_compared_string == '\0') {
+            char_address++, compared_char_address++) {
+         if (*compared_char_address == '\0') {
             return found;
          }
 
-         all_chars_are_equal = *being_compared_string == *char_address ? 1 : 0;
+         all_chars_are_equal = *compared_char_address == *char_address ? 1 : 0;
 
          if (!all_chars_are_equal) {
             break;
@@ -1266,32 +4271,156 @@ unsigned char contains_string(char being_compared_string[], char string_to_be_co
 
 void disable_echo() {
    send_usard_data(ESP8226_REQUEST_DISABLE_ECHO);
-   set_flag(&sent_task_g, DISABLE_ECHO_TASK);
+   set_flag(&device_g->sent_task, DISABLE_ECHO_TASK);
+}
+
+void soft_reset_esp8266() {
+   send_usard_data(ESP8226_REQUEST_SOFT_RESET);
+   set_flag(&device_g->sent_task, SOFT_RESET_ESP8266_TASK);
+}
+
+void set_multiple_connections() {
+   send_usard_data(ESP8226_REQUEST_SET_MULTIPLE_CONNECTIONS);
+   set_flag(&device_g->sent_task, SET_MULTIPLE_CONNECTIONS_TASK);
+}
+
+void ping_server() {
+   char *parameters[] = {ESP8226_SERVER_IP_ADDRESS, NULL};
+   device_g->usart_data_to_be_transmitted_buffer = set_string_parameters(ESP8226_REQUEST_SERVER_PING, parameters);
+   send_usard_data(device_g->usart_data_to_be_transmitted_buffer);
+   set_flag(&device_g->sent_task, GET_SERVER_AVAILABILITY_TASK);
+}
+
+/**
+ * The reply is "+<ms>"
+ *
+ * @return 0 if there is no round trip time in the response
+ */
+unsigned char get_server_ping_time(unsigned short *ping_time_ms) {
+   char *response = device_g->usart_data_received_buffer;
+
+   for (; *response != '\0'; response++) {
+      if (*response == '+' && *(response + 1) >= '0' && *(response + 1) <= '9') {
+         *ping_time_ms = (unsigned short) string_to_num(response + 1);
+         return 1;
+      }
+   }
+   return 0;
+}
+
+void get_link_status() {
+   send_usard_data(ESP8226_REQUEST_GET_LINK_STATUS);
+   set_flag(&device_g->sent_task, GET_LINK_STATUS_TASK);
+}
+
+LinkStatus get_received_link_status() {
+   char *response = device_g->usart_data_received_buffer;
+
+   // "+CIPSTATUS:" lines follow the "STATUS:" one
+   for (; *response != '\0'; response++) {
+      if (is_string_starts_with(response, ESP8226_RESPONSE_LINK_STATUS_PREFIX)) {
+         unsigned int link_status = string_to_num(response + sizeof(ESP8226_RESPONSE_LINK_STATUS_PREFIX) - 1);
+
+         return link_status >= GOT_IP_LINK_STATUS && link_status <= NO_WIFI_LINK_STATUS ? (LinkStatus) link_status : UNKNOWN_LINK_STATUS;
+      }
+   }
+   return UNKNOWN_LINK_STATUS;
+}
+
+void start_local_control_server() {
+   send_usard_data(ESP8226_REQUEST_START_LOCAL_CONTROL_SERVER);
+   set_flag(&device_g->sent_task, START_LOCAL_CONTROL_SERVER_TASK);
 }
 
 void get_network_list() {
+   device_g->visible_networks_received = 0;
+   device_g->on_received_line = on_visible_network_line;
    send_usard_data(ESP8226_REQUEST_GET_VISIBLE_NETWORK_LIST);
-   set_flag(&sent_task_g, GET_VISIBLE_NETWORK_LIST_TASK);
+   set_flag(&device_g->sent_task, GET_VISIBLE_NETWORK_LIST_TASK);
 }
 
 void get_ap_connection_status() {
    send_usard_data(ESP8226_REQUEST_GET_AP_CONNECTION_STATUS);
-   set_flag(&sent_task_g, GET_AP_CONNECTION_STATUS_AND_CONNECT_TASK);
+   set_flag(&device_g->sent_task, GET_AP_CONNECTION_STATUS_AND_CONNECT_TASK);
+}
+
+void set_esp8266_usart_baud_rate() {
+   char *baud_rate = num_to_string(USART_ESCALATED_BAUD_RATES[device_g->usart_escalated_baud_rate_index]);
+   char *parameters[] = {baud_rate, NULL};
+   device_g->usart_data_to_be_transmitted_buffer = set_string_parameters(ESP8226_REQUEST_SET_CURRENT_UART_CONFIGURATION, parameters);
+   free(baud_rate);
+   send_usard_data(device_g->usart_data_to_be_transmitted_buffer);
+   set_flag(&device_g->sent_task, SET_USART_BAUD_RATE_TASK);
+}
+
+/**
+ * Timeout means the escalated baud rate doesn't work either
+ */
+void probe_usart_baud_rate() {
+   if (device_g->usart_escalated_baud_rate_probes >= USART_ESCALATED_BAUD_RATE_MAX_PROBES) {
+      fall_back_to_default_usart_baud_rate();
+      return;
+   }
+
+   device_g->usart_escalated_baud_rate_probes++;
+   send_usard_data(ESP8226_REQUEST_PROBE);
+   set_flag(&device_g->sent_task, PROBE_USART_BAUD_RATE_TASK);
+}
+
+/**
+ * AT+UART_CUR settings aren't saved into the flash, so ESP8266 starts with the default baud rate after power cycle.
+ * The next slower escalated baud rate is tried after that
+ */
+void fall_back_to_default_usart_baud_rate() {
+   device_g->usart_escalated_baud_rate_index++;
+   change_usart_baud_rate(USART_BAUD_RATE);
+   disable_esp8266();
+
+   reset_device_state();
+   add_esp8266_initialization_tasks();
+}
+
+/**
+ * The error rate of the escalated baud rate is checked, not the errors since the escalation
+ */
+void check_usart_baud_rate_errors() {
+   if (!USART_BAUD_RATE_ESCALATION_ENABLED || device_g->usart_baud_rate == USART_BAUD_RATE) {
+      return;
+   }
+
+   unsigned short window_errors = get_usart_baud_rate_errors() - device_g->usart_escalated_baud_rate_errors_baseline;
+
+   if (window_errors >= USART_ESCALATED_BAUD_RATE_MAX_ERRORS) {
+      fall_back_to_default_usart_baud_rate();
+   } else if (!device_g->usart_escalated_baud_rate_errors_window_timer) {
+      device_g->usart_escalated_baud_rate_errors_baseline += window_errors;
+      device_g->usart_escalated_baud_rate_errors_window_timer = USART_ESCALATED_BAUD_RATE_ERRORS_WINDOW;
+   }
+}
+
+unsigned short get_usart_baud_rate_errors() {
+   return device_g->usart_framing_errors_counter + device_g->usart_noise_detection_counter;
 }
 
 void connect_to_network() {
    char *parameters[] = {DEFAULT_ACCESS_POINT_NAME, DEFAULT_ACCESS_POINT_PASSWORD, NULL};
-   usart_data_to_be_transmitted_buffer_g = set_string_parameters(ESP8226_REQUEST_CONNECT_TO_NETWORK_AND_SAVE, parameters);
-   send_usard_data(usart_data_to_be_transmitted_buffer_g);
-   set_flag(&sent_task_g, CONNECT_TO_NETWORK_TASK);
+   device_g->usart_data_to_be_transmitted_buffer = set_string_parameters(ESP8226_REQUEST_CONNECT_TO_NETWORK_AND_SAVE, parameters);
+   send_usard_data(device_g->usart_data_to_be_transmitted_buffer);
+   set_flag(&device_g->sent_task, CONNECT_TO_NETWORK_TASK);
 }
 
 /**
- * @param timeout timeout in seconds
+ * The response timeout is estimated from the response times of the commands of the same class
  */
-void schedule_function_resending(void (*function_to_execute)(), unsigned short timeout, ImmediatelyFunctionExecution execute) {
-   send_usart_data_timout_sec_g = timeout;
-   scheduled_function_to_execute_on_error_g = function_to_execute;
+void schedule_function_resending(void (*function_to_execute)(), CommandClass command_class, ImmediatelyFunctionExecution execute) {
+   if (device_g->long_polling_wait == LONG_POLLING_RESPONSE_WAIT) {
+      device_g->commands_during_long_polling_counter++;
+   }
+   device_g->scheduled_command_class = command_class;
+   device_g->scheduled_command_resent = 0;
+   device_g->send_usart_data_timeout_ms = get_scheduled_command_timeout();
+   device_g->command_sent_timestamp_ms = device_g->milliseconds_counter;
+   device_g->scheduled_function_to_execute_on_error = function_to_execute;
 
    if (execute == EXECUTE_FUNCTION_IMMEDIATELY) {
       function_to_execute();
@@ -1389,6 +4518,26 @@ void TIMER3_Confing() {
    TIM_Cmd(TIM3, ENABLE);
 }
 
+/**
+ * Only triggers the ADC, no interrupts
+ */
+void TIMER1_Confing() {
+   DBGMCU_APB2PeriphConfig(DBGMCU_TIM1_STOP, ENABLE);
+   RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM1, ENABLE);
+
+   TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+   TIM_TimeBaseStructure.TIM_Period = TIMER1_PERIOD_MS - 1;
+   TIM_TimeBaseStructure.TIM_Prescaler = TIMER1_PRESCALER;
+   TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+   TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+   TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+   TIM_TimeBaseInit(TIM1, &TIM_TimeBaseStructure);
+
+   TIM_SelectOutputTrigger(TIM1, TIM_TRGOSource_Update);
+
+   TIM_Cmd(TIM1, ENABLE);
+}
+
 /**
  * 0.0983s with 16MHz clock
  */
@@ -1410,6 +4559,27 @@ void TIMER14_Confing() {
    TIM_Cmd(TIM14, ENABLE);
 }
 
+/**
+ * 1ms interrupts. Together with the current SysTick value gives microseconds
+ */
+void SysTick_Timer_Config() {
+   SysTick_Config(SYSTICK_TICKS_PER_MS);
+}
+
+/**
+ * Overflows every 71 minutes, so only differences of close timestamps shall be used
+ */
+unsigned int get_microseconds() {
+   unsigned int milliseconds;
+   unsigned int ticks;
+
+   do {
+      milliseconds = device_g->milliseconds_counter;
+      ticks = SysTick->VAL;
+   } while (milliseconds != device_g->milliseconds_counter);
+   return milliseconds * 1000 + (SYSTICK_TICKS_PER_MS - 1 - ticks) / SYSTICK_TICKS_PER_US;
+}
+
 void DMA_Config() {
    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1 , ENABLE);
 
@@ -1435,19 +4605,57 @@ void DMA_Config() {
    DMA_Cmd(USART1_TX_DMA_CHANNEL, ENABLE);
 }
 
+/**
+ * The temperature sensor and VREFINT are converted on TIMER1 trigger and moved by the circular DMA. The sensor needs at least 4us of
+ * the sampling time: 239.5 cycles of 4MHz clock
+ */
+void ADC_Config() {
+   RCC_APB2PeriphClockCmd(RCC_APB2Periph_ADC1, ENABLE);
+   ADC_ClockModeConfig(ADC1, ADC_ClockMode_SynClkDiv4);
+   // Has to be done while the ADC is disabled
+   ADC_GetCalibrationFactor(ADC1);
+
+   ADC_InitTypeDef adcInitType;
+   adcInitType.ADC_Resolution = ADC_Resolution_12b;
+   adcInitType.ADC_ContinuousConvMode = DISABLE;
+   adcInitType.ADC_ExternalTrigConvEdge = ADC_ExternalTrigConvEdge_Rising;
+   adcInitType.ADC_ExternalTrigConv = ADC_ExternalTrigConv_T1_TRGO;
+   adcInitType.ADC_DataAlign = ADC_DataAlign_Right;
+   adcInitType.ADC_ScanDirection = ADC_ScanDirection_Upward;
+   ADC_Init(ADC1, &adcInitType);
+
+   ADC_ChannelConfig(ADC1, ADC_Channel_TempSensor | ADC_Channel_Vrefint, ADC_SampleTime_239_5Cycles);
+   ADC_TempSensorCmd(ENABLE);
+   ADC_VrefintCmd(ENABLE);
+
+   DMA_InitTypeDef dmaInitType;
+   dmaInitType.DMA_PeripheralBaseAddr = ADC_DR_ADDRESS;
+   dmaInitType.DMA_MemoryBaseAddr = (unsigned int) device_g->health_samples;
+   dmaInitType.DMA_DIR = DMA_DIR_PeripheralSRC;
+   dmaInitType.DMA_BufferSize = HEALTH_SAMPLES_SIZE;
+   dmaInitType.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+   dmaInitType.DMA_MemoryInc = DMA_MemoryInc_Enable;
+   dmaInitType.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+   dmaInitType.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+   dmaInitType.DMA_Mode = DMA_Mode_Circular;
+   dmaInitType.DMA_Priority = DMA_Priority_Low;
+   dmaInitType.DMA_M2M = DMA_M2M_Disable;
+   DMA_Init(ADC_DMA_CHANNEL, &dmaInitType);
+   DMA_Cmd(ADC_DMA_CHANNEL, ENABLE);
+
+   ADC_DMARequestModeConfig(ADC1, ADC_DMAMode_Circular);
+   ADC_DMACmd(ADC1, ENABLE);
+
+   ADC_Cmd(ADC1, ENABLE);
+   while (!ADC_GetFlagStatus(ADC1, ADC_FLAG_ADRDY));
+   // Waits for the trigger
+   ADC_StartOfConversion(ADC1);
+}
+
 void USART_Config() {
    RCC_APB2PeriphClockCmd(RCC_APB2Periph_USART1, ENABLE);
 
-   USART_OverSampling8Cmd(USART1, DISABLE);
-
-   USART_InitTypeDef USART_InitStructure;
-   USART_InitStructure.USART_BaudRate = USART_BAUD_RATE;
-   USART_InitStructure.USART_WordLength = USART_WordLength_8b;
-   USART_InitStructure.USART_StopBits = USART_StopBits_1;
-   USART_InitStructure.USART_Parity = USART_Parity_No;
-   USART_InitStructure.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
-   USART_InitStructure.USART_Mode = USART_Mode_Rx | USART_Mode_Tx;
-   USART_Init(USART1, &USART_InitStructure);
+   change_usart_baud_rate(USART_BAUD_RATE);
 
    USART_ITConfig(USART1, USART_IT_RXNE, ENABLE);
    USART_ITConfig(USART1, USART_IT_ERR, ENABLE);
@@ -1460,6 +4668,29 @@ void USART_Config() {
    USART_Cmd(USART1, ENABLE);
 }
 
+/**
+ * 16MHz clock with 16 times oversampling gives 2.1% error on 921600, so 8 times oversampling is used for higher baud rates.
+ * The registers are written directly: USART_Init() links RCC_GetClocksFreq() in to find out CLOCK_SPEED. 8 data bits, 1 stop bit,
+ * no parity and no flow control are the reset values
+ */
+void change_usart_baud_rate(unsigned int baud_rate) {
+   USART_Cmd(USART1, DISABLE);
+
+   if (USART_BAUD_RATE_ESCALATION_ENABLED && baud_rate > USART_16X_OVERSAMPLING_MAX_BAUD_RATE) {
+      // The lowest 4 bits of the divider are shifted right by 1 with 8 times oversampling
+      unsigned int usart_divider = (CLOCK_SPEED * 2 + baud_rate / 2) / baud_rate;
+
+      USART1->CR1 |= USART_CR1_OVER8 | USART_CR1_TE | USART_CR1_RE;
+      USART1->BRR = (usart_divider & ~0xF) | ((usart_divider & 0xF) >> 1);
+   } else {
+      USART1->CR1 = (USART1->CR1 & ~USART_CR1_OVER8) | USART_CR1_TE | USART_CR1_RE;
+      USART1->BRR = (CLOCK_SPEED + baud_rate / 2) / baud_rate;
+   }
+
+   USART_Cmd(USART1, ENABLE);
+   device_g->usart_baud_rate = baud_rate;
+}
+
 void set_flag(unsigned int *flags, unsigned int flag_value) {
    *flags |= flag_value;
 }
@@ -1473,15 +4704,37 @@ unsigned char read_flag(unsigned int *flags, unsigned int flag_value) {
 }
 
 void send_usard_data(char *string) {
-   send_usart_data_time_counter_g = 0;
+   device_g->command_sent_timestamp_ms = device_g->milliseconds_counter;
    clear_usart_data_received_buffer();
    DMA_Cmd(USART1_TX_DMA_CHANNEL, DISABLE);
+
+   if (string == NULL) {
+      // The command hasn't been allocated. It's sent again on timeout
+      return;
+   }
    unsigned short bytes_to_send = get_string_length(string);
 
    if (bytes_to_send == 0) {
       return;
    }
 
+   count_sent_usart_data(bytes_to_send);
+   start_usart_dma_transmission(string, bytes_to_send);
+}
+
+void count_sent_usart_data(unsigned short sent_bytes) {
+   if (POLL_CYCLE_STATISTICS_ENABLED) {
+      device_g->current_poll_cycle.at_commands++;
+      device_g->current_poll_cycle.sent_bytes += sent_bytes;
+   }
+   device_g->command_latency_measured = 0;
+}
+
+/**
+ * Also called from the USART ISR, so only registers are touched here
+ */
+void start_usart_dma_transmission(char string[], unsigned short bytes_to_send) {
+   DMA_Cmd(USART1_TX_DMA_CHANNEL, DISABLE);
    DMA_SetCurrDataCounter(USART1_TX_DMA_CHANNEL, bytes_to_send);
    USART1_TX_DMA_CHANNEL->CMAR = (unsigned int) string;
    USART_ClearFlag(USART1, USART_FLAG_TC);
@@ -1496,28 +4749,32 @@ void send_usard_data(char *string) {
 void *set_string_parameters(char string[], char *parameters[]) {
    unsigned char open_brace_found = 0;
    unsigned char parameters_amount = 0;
+   unsigned char parameter_number = 0;
    unsigned short result_string_length = 0;
 
    for (; parameters[parameters_amount] != NULL; parameters_amount++) {
    }
 
-   // Calculate the length without symbols to be replaced ('<x>')
+   // Calculate the length without symbols to be replaced ('<x>'). A parameter, which hasn't been allocated, terminates the
+   // parameters earlier, so the template refers to a missing one and NULL is returned before anything is allocated
    for (char *string_pointer = string; *string_pointer != '\0'; string_pointer++) {
       if (*string_pointer == '<') {
          if (open_brace_found) {
             return NULL;
          }
          open_brace_found = 1;
+         parameter_number = 0;
          continue;
       }
       if (*string_pointer == '>') {
-         if (!open_brace_found) {
+         if (!open_brace_found || parameter_number == 0 || parameter_number > parameters_amount) {
             return NULL;
          }
          open_brace_found = 0;
          continue;
       }
       if (open_brace_found) {
+         parameter_number = parameter_number * 10 + *string_pointer - '0';
          continue;
       }
 
@@ -1534,7 +4791,7 @@ void *set_string_parameters(char string[], char *parameters[]) {
    // 1 is for the last \0 character
    result_string_length++;
 
-   char *allocated_result = malloc(result_string_length); // (string_length + 1) * sizeof(char)
+   char *allocated_result = counted_malloc(result_string_length); // (string_length + 1) * sizeof(char)
 
    if (allocated_result == NULL) {
       return NULL;
@@ -1549,13 +4806,11 @@ void *set_string_parameters(char string[], char *parameters[]) {
          input_string_char = string[input_string_index];
 
          if (input_string_char < '1' || input_string_char > '9') {
+            free(allocated_result);
             return NULL;
          }
 
          unsigned short parameter_numeric_value = input_string_char - '0';
-         if (parameter_numeric_value > parameters_amount) {
-            return NULL;
-         }
 
          input_string_index++;
          input_string_char = string[input_string_index];
@@ -1603,111 +4858,75 @@ unsigned char is_string_starts_with(char long_string[], char short_string[]) {
 }
 
 /**
- * Do not forget to call free() function on returned pointer when it's no longer needed
+ * Digits are taken from the lowest one. Do not forget to call free() function on returned pointer when it's no longer needed
  */
 void *num_to_string(unsigned int number) {
-   char *result_string_pointer = NULL;
+   // 4294967295 is the longest number
+   char digits[10];
+   unsigned char digits_amount = 0;
 
-   if (number == 0) {
-      result_string_pointer = malloc(2);
-      result_string_pointer[0] = '0';
-      result_string_pointer[1] = '\0';
-      return result_string_pointer;
-   }
+   do {
+      digits[digits_amount] = (char) (number % 10 + '0');
+      digits_amount++;
+      number /= 10;
+   } while (number);
 
-   unsigned char string_size = 1;
-   unsigned int divider = 1;
-   unsigned int divider_tmp = 10;
+   char *result_string = counted_malloc(digits_amount + 1);
 
-   for (unsigned char i = 0; divider_tmp <= number; i++) {
-      divider = divider_tmp;
-      divider_tmp *= 10;
-      string_size++;
+   if (result_string == NULL) {
+      return NULL;
    }
-
-   unsigned int remaining = number;
-   unsigned char string_length = 0;
-
-   while (string_size > 0) {
-      unsigned char last_digit_was_zero = 0;
-      if (remaining < divider) {
-         last_digit_was_zero = 1;
-      }
-      unsigned char result_character = last_digit_was_zero ? 0 : get_first_digit(remaining);
-      //unsigned char result_character = (unsigned char) (remaining / divider);
-
-      if (result_string_pointer == NULL && result_character) {
-         result_string_pointer = malloc(string_size + 1);
-         string_length = string_size;
-      }
-      if (result_string_pointer != NULL) {
-         unsigned char index = string_length - string_size;
-         *(result_string_pointer + index) = result_character + '0';
-      }
-
-      if (!last_digit_was_zero) {
-         remaining -= result_character * divider;
-      }
-      divider = divide_by_10(divider);
-      //divider /= 10;
-      string_size--;
+   for (unsigned char i = 0; i < digits_amount; i++) {
+      result_string[i] = digits[digits_amount - 1 - i];
    }
-   result_string_pointer[string_length] = '\0';
-   return result_string_pointer;
+   result_string[digits_amount] = '\0';
+   return result_string;
 }
 
 /**
- * Only 10, 100, 1000, e.t.c can be divided by 10
+ * Leading digits are converted. Conversion stops on the first non digit character
  */
-unsigned int divide_by_10(unsigned int dividend) {
-   if (dividend < 10) {
-      return 0;
-   }
+unsigned int string_to_num(char string[]) {
+   unsigned int result = 0;
 
-   unsigned int subtrahend = 0;
-   unsigned int subtrahend_tmp = 9;
-
-   while (subtrahend_tmp < dividend) {
-      subtrahend = subtrahend_tmp;
-      subtrahend_tmp *= 10;
+   for (; *string >= '0' && *string <= '9'; string++) {
+      result = result * 10 + *string - '0';
    }
-   return dividend - subtrahend;
+   return result;
 }
 
-unsigned char get_first_digit(unsigned int long_digit) {
-   if (long_digit < 10) {
-      return (unsigned char) long_digit;
-   }
-
-   // Find the most subtrahend
-   unsigned int subtrahend = 0;
-   unsigned int subtrahend_tmp = 10;
-
-   while (subtrahend_tmp <= long_digit) {
-      subtrahend = subtrahend_tmp;
-      subtrahend_tmp *= 10;
+/**
+ * Do not forget to call free() function on returned pointer when it's no longer needed
+ */
+void *signed_num_to_string(int number) {
+   if (number >= 0) {
+      return num_to_string(number);
    }
 
-   unsigned char result = 1;
-   unsigned int remaining_result = long_digit - subtrahend;
+   char *digits = num_to_string(-number);
+   char *parameters[] = {digits, NULL};
+   char *result = set_string_parameters(NEGATIVE_NUMBER, parameters);
 
-   while (remaining_result >= subtrahend) {
-      result++;
-      remaining_result -= subtrahend;
-   }
+   free(digits);
    return result;
 }
 
 /**
- * Do not forget to call free() function on returned pointer when it's no longer needed
+ * The numbers are the parameters of the template. Do not forget to call free() function on returned pointer when it's no longer needed
  */
-void *array_to_string(char array[], unsigned char array_length) {
-   char *result = malloc(array_length + 1);
+void *set_number_parameters(char string[], int numbers[], unsigned char numbers_amount) {
+   char *parameters[NUMBER_PARAMETERS_MAX + 1];
 
-   for (unsigned char i = 0; i < array_length; i++) {
-      result[i] = array[i];
+   for (unsigned char i = 0; i < numbers_amount; i++) {
+      parameters[i] = signed_num_to_string(numbers[i]);
+   }
+   parameters[numbers_amount] = NULL;
+   // A number, which hasn't been allocated, terminates the parameters earlier, so NULL is returned
+   char *result = set_string_parameters(string, parameters);
+
+   for (unsigned char i = 0; i < numbers_amount; i++) {
+      free(parameters[i]);
    }
-   result[array_length] = '\0';
    return result;
 }
 
@@ -1740,7 +4959,11 @@ char *get_gson_element_value(char *json_string, char *json_element_to_find) {
    }
    json_element_to_find_value = json_element_to_find_value - returning_value_length;
 
-   char *returning_value = malloc(returning_value_length + 1);
+   char *returning_value = counted_malloc(returning_value_length + 1);
+
+   if (returning_value == NULL) {
+      return NULL;
+   }
 
    for (unsigned int i = 0; i < returning_value_length; i++) {
       *(returning_value + i) = *(json_element_to_find_value + i);
@@ -1749,53 +4972,91 @@ char *get_gson_element_value(char *json_string, char *json_element_to_find) {
    return returning_value;
 }
 
+/**
+ * Only the handed over frame is cleared. The data being received belongs to the next frame
+ */
 void clear_usart_data_received_buffer() {
-   for (unsigned short i = 0; i < USART_DATA_RECEIVED_BUFFER_SIZE; i++) {
-      if (usart_data_received_buffer_g[i] == '\0') {
-         break;
+   device_g->usart_data_received_buffer[0] = '\0';
+   device_g->usart_data_received_length = 0;
+}
+
+/**
+ * The buffer may be reused by the ISR after that
+ */
+void release_usart_data_received_buffer() {
+   device_g->usart_data_received = 0;
+}
+
+/**
+ * Passes every line of the received data to "on_received_line". '\n' is replaced by '\0' during the call
+ */
+void process_received_lines() {
+   if (device_g->on_received_line == NULL) {
+      return;
+   }
+
+   char *line = device_g->usart_data_received_buffer;
+
+   while (*line != '\0') {
+      char *line_end = line;
+
+      while (*line_end != '\0' && *line_end != '\n') {
+         line_end++;
       }
 
-      usart_data_received_buffer_g[i] = '\0';
+      char line_end_character = *line_end;
+      *line_end = '\0';
+      device_g->on_received_line(line);
+      *line_end = line_end_character;
+
+      if (line_end_character == '\0') {
+         break;
+      }
+      line = line_end + 1;
    }
 }
 
 unsigned short get_received_data_length() {
-   for (unsigned short i = 0; i < USART_DATA_RECEIVED_BUFFER_SIZE; i++) {
-      if (usart_data_received_buffer_g[i] == '\0') {
-         return i;
-      }
-   }
-   return 0;
+   return device_g->usart_data_received_length;
 }
 
 unsigned char is_received_data_length_equal(unsigned short length) {
-   for (unsigned short i = 0; i < USART_DATA_RECEIVED_BUFFER_SIZE; i++) {
-      if (i == length && usart_data_received_buffer_g[i] == '\0') {
-         return 1;
-      } else if ((i < length && usart_data_received_buffer_g[i] == '\0') ||
-            i > length) {
-         return 0;
-      }
-   }
-   return 0;
+   return device_g->usart_data_received_length == length;
 }
 
+/**
+ * ESP8266_START_TIMEOUT_MS is waited at most. The start is finished earlier by "ready" (check_esp8266_ready())
+ */
 void enable_esp8266() {
    GPIO_WriteBit(ESP8266_CONTROL_PORT, ESP8266_CONTROL_PIN, Bit_SET);
-   esp8266_disabled_timer_g = TIMER14_5S;
+   device_g->esp8266_disabled_timer = TIMER14_5S;
+   device_g->esp8266_enabled_timestamp_ms = device_g->milliseconds_counter;
+   device_g->esp8266_is_starting = 1;
+   clear_usart_data_received_buffer();
 }
 
 void disable_esp8266() {
+   add_device_event(ESP8266_DISABLED_EVENT);
    GPIO_WriteBit(ESP8266_CONTROL_PORT, ESP8266_CONTROL_PIN, Bit_RESET);
    GPIO_WriteBit(NETWORK_STATUS_LED_PORT, NETWORK_STATUS_LED_PIN, Bit_RESET);
    GPIO_WriteBit(SERVER_AVAILABILITI_LED_PORT, SERVER_AVAILABILITI_LED_PIN, Bit_RESET);
 }
 
 unsigned char is_esp8266_enabled(unsigned char include_timer) {
-   return include_timer ? (GPIO_ReadOutputDataBit(ESP8266_CONTROL_PORT, ESP8266_CONTROL_PIN) && esp8266_disabled_timer_g == 0) :
+   return include_timer ? (GPIO_ReadOutputDataBit(ESP8266_CONTROL_PORT, ESP8266_CONTROL_PIN) && device_g->esp8266_disabled_timer == 0) :
          GPIO_ReadOutputDataBit(ESP8266_CONTROL_PORT, ESP8266_CONTROL_PIN);
 }
 
+/**
+ * Allocations are counted for the poll cycle statistics
+ */
+void *counted_malloc(unsigned int size) {
+   if (POLL_CYCLE_STATISTICS_ENABLED) {
+      device_g->current_poll_cycle.allocations++;
+   }
+   return malloc(size);
+}
+
 char *debug_malloc(unsigned int size, unsigned int invoked_function_address) {
    malloc_size_to_be_allocated_g = size;
    malloc_invoked_function_address_g = invoked_function_address;
@@ -153,7 +153,7 @@
   *         the configuration information for the specified ADC peripheral.
   * @retval None
   */
-/*void ADC_Init(ADC_TypeDef* ADCx, ADC_InitTypeDef* ADC_InitStruct)
+void ADC_Init(ADC_TypeDef* ADCx, ADC_InitTypeDef* ADC_InitStruct)
 {
   uint32_t tmpreg = 0;
 
@@ -187,7 +187,7 @@
 
   // Write to ADCx CFGR 
   ADCx->CFGR1 = tmpreg;
-}*/
+}
 
 /**
   * @brief  Fills each ADC_InitStruct member with its default value.
@@ -227,7 +227,7 @@
   *          This parameter can be: ENABLE or DISABLE.
   * @retval None
   */
-/*void ADC_Cmd(ADC_TypeDef* ADCx, FunctionalState NewState)
+void ADC_Cmd(ADC_TypeDef* ADCx, FunctionalState NewState)
 {
   // Check the parameters 
   assert_param(IS_ADC_ALL_PERIPH(ADCx));
@@ -243,7 +243,7 @@
     // Set the ADDIS to Disable the ADC peripheral 
     ADCx->CR |= (uint32_t)ADC_CR_ADDIS;
   }
-}*/
+}
 
 /**
   * @brief  Configure the ADC to either be clocked by the asynchronous clock(which is
@@ -257,7 +257,7 @@
   *            @arg ADC_ClockMode_SynClkDiv4: ADC clocked by PCLK/4  
   * @retval None
   */
-/*void ADC_ClockModeConfig(ADC_TypeDef* ADCx, uint32_t ADC_ClockMode)
+void ADC_ClockModeConfig(ADC_TypeDef* ADCx, uint32_t ADC_ClockMode)
 {
   // Check the parameters 
   assert_param(IS_ADC_ALL_PERIPH(ADCx));
@@ -266,7 +266,7 @@
     // Configure the ADC Clock mode according to ADC_ClockMode 
     ADCx->CFGR2 = (uint32_t)ADC_ClockMode;
 
-}*/
+}
 
 /**
   * @brief  Enables or disables the jitter when the ADC is clocked by PCLK div2
@@ -571,7 +571,7 @@
   *          This parameter can be: ENABLE or DISABLE.
   * @retval None
   */
-/*void ADC_TempSensorCmd(FunctionalState NewState)
+void ADC_TempSensorCmd(FunctionalState NewState)
 {
   // Check the parameters
   assert_param(IS_FUNCTIONAL_STATE(NewState));
@@ -586,7 +586,7 @@
     // Disable the temperature sensor channel
     ADC->CCR &= (uint32_t)(~ADC_CCR_TSEN);
   }
-}*/
+}
 
 /**
   * @brief  Enables or disables the Vrefint channel.
@@ -594,7 +594,7 @@
   *          This parameter can be: ENABLE or DISABLE.
   * @retval None
   */
-/*void ADC_VrefintCmd(FunctionalState NewState)
+void ADC_VrefintCmd(FunctionalState NewState)
 {
   // Check the parameters
   assert_param(IS_FUNCTIONAL_STATE(NewState));
@@ -609,7 +609,7 @@
     // Disable the Vrefint channel
     ADC->CCR &= (uint32_t)(~ADC_CCR_VREFEN);
   }
-}*/
+}
 
 /**
   * @brief  Enables or disables the Vbat channel. 
@@ -711,7 +711,7 @@
   *            @arg ADC_SampleTime_239_5Cycles: Sample time equal to 239.5 cycles
   * @retval None
   */
-/*void ADC_ChannelConfig(ADC_TypeDef* ADCx, uint32_t ADC_Channel, uint32_t ADC_SampleTime)
+void ADC_ChannelConfig(ADC_TypeDef* ADCx, uint32_t ADC_Channel, uint32_t ADC_SampleTime)
 {
   uint32_t tmpreg = 0;
 
@@ -731,7 +731,7 @@
 
   // Configure the ADC Sample time register 
   ADCx->SMPR = tmpreg ;
-}*/
+}
 
 /**
   * @brief  Enable the Continuous mode for the selected ADCx channels.
@@ -821,7 +821,7 @@
   * @param  ADCx: where x can be 1 to select the ADC1 peripheral.
   * @retval ADC Calibration factor 
   */
-/*uint32_t ADC_GetCalibrationFactor(ADC_TypeDef* ADCx)
+uint32_t ADC_GetCalibrationFactor(ADC_TypeDef* ADCx)
 {
   uint32_t tmpreg = 0, calibrationcounter = 0, calibrationstatus = 0;
 
@@ -849,7 +849,7 @@
     tmpreg = 0x00000000;
   }
   return tmpreg;
-}*/
+}
 
 /**
   * @brief  Stop the on going conversions for the selected ADC.
@@ -873,13 +873,13 @@
   * @param  ADCx: where x can be 1 to select the ADC1 peripheral.
   * @retval None
   */
-/*void ADC_StartOfConversion(ADC_TypeDef* ADCx)
+void ADC_StartOfConversion(ADC_TypeDef* ADCx)
 {
   // Check the parameters 
   assert_param(IS_ADC_ALL_PERIPH(ADCx));
   
   ADCx->CR |= (uint32_t)ADC_CR_ADSTART;
-}*/
+}
 
 /**
   * @brief  Returns the last ADCx conversion result data for ADC channel.  
@@ -930,7 +930,7 @@
   *          This parameter can be: ENABLE or DISABLE.
   * @retval None
   */
-/*void ADC_DMACmd(ADC_TypeDef* ADCx, FunctionalState NewState)
+void ADC_DMACmd(ADC_TypeDef* ADCx, FunctionalState NewState)
 {
   // Check the parameters 
   assert_param(IS_ADC_ALL_PERIPH(ADCx));
@@ -946,7 +946,7 @@
     // Disable the selected ADC DMA request 
     ADCx->CFGR1 &= (uint32_t)(~ADC_CFGR1_DMAEN);
   }
-}*/
+}
 
 /**
   * @brief  Enables or disables the ADC DMA request after last transfer (Single-ADC mode)
@@ -957,14 +957,14 @@
   *            @arg ADC_DMAMode_Circular: DMA Circular Mode  
   *  @retval None
   */
-/*void ADC_DMARequestModeConfig(ADC_TypeDef* ADCx, uint32_t ADC_DMARequestMode)
+void ADC_DMARequestModeConfig(ADC_TypeDef* ADCx, uint32_t ADC_DMARequestMode)
 {
   // Check the parameters
   assert_param(IS_ADC_ALL_PERIPH(ADCx));
 
   ADCx->CFGR1 &= (uint32_t)~ADC_CFGR1_DMACFG;
   ADCx->CFGR1 |= (uint32_t)ADC_DMARequestMode;
-}*/
+}
 
 /**
   * @}
@@ -1102,7 +1102,7 @@
   *            @arg ADC_FLAG_ADCAL: ADC Calibration flag
   * @retval The new state of ADC_FLAG (SET or RESET).
   */
-/*FlagStatus ADC_GetFlagStatus(ADC_TypeDef* ADCx, uint32_t ADC_FLAG)
+FlagStatus ADC_GetFlagStatus(ADC_TypeDef* ADCx, uint32_t ADC_FLAG)
 {
   FlagStatus bitstatus = RESET;
   uint32_t tmpreg = 0;
@@ -1133,7 +1133,7 @@
   }
   // Return the ADC_FLAG status
   return  bitstatus;
-}*/
+}
 
 /**
   * @brief  Clears the ADCx's pending flags.
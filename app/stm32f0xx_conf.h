@@ -31,7 +31,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 /* Comment the line below to disable peripheral header file inclusion */
-//#include "stm32f0xx_adc.h"
+#include "stm32f0xx_adc.h"
 //#include "stm32f0xx_can.h"
 //#include "stm32f0xx_cec.h"
 //#include "stm32f0xx_crc.h"
@@ -183,7 +183,7 @@ void DBGMCU_APB1PeriphConfig(uint32_t DBGMCU_Periph, FunctionalState NewState)
   *          This parameter can be: ENABLE or DISABLE.
   * @retval None
   */
-/*void DBGMCU_APB2PeriphConfig(uint32_t DBGMCU_Periph, FunctionalState NewState)
+void DBGMCU_APB2PeriphConfig(uint32_t DBGMCU_Periph, FunctionalState NewState)
 {
   // Check the parameters 
   assert_param(IS_DBGMCU_APB2PERIPH(DBGMCU_Periph));
@@ -197,7 +197,7 @@ void DBGMCU_APB1PeriphConfig(uint32_t DBGMCU_Periph, FunctionalState NewState)
   {
     DBGMCU->APB2FZ &= ~DBGMCU_Periph;
   }
-}*/
+}
 
 /**
   * @}
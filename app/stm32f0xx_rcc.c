@@ -1698,11 +1698,11 @@ FlagStatus RCC_GetFlagStatus(uint8_t RCC_FLAG)
   * @param  None
   * @retval None
   */
-/*void RCC_ClearFlag(void)
+void RCC_ClearFlag(void)
 {
-  // Set RMVF bit to clear the reset flags
+  /* Set RMVF bit to clear the reset flags */
   RCC->CSR |= RCC_CSR_RMVF;
-}*/
+}
 
 /**
   * @brief  Checks whether the specified RCC interrupt has occurred or not.
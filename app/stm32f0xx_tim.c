@@ -2941,7 +2941,7 @@ void TIM_ClearITPendingBit(TIM_TypeDef* TIMx, uint16_t TIM_IT)
   *
   * @retval None
   */
-/*void TIM_SelectOutputTrigger(TIM_TypeDef* TIMx, uint16_t TIM_TRGOSource)
+void TIM_SelectOutputTrigger(TIM_TypeDef* TIMx, uint16_t TIM_TRGOSource)
 {
   // Check the parameters
   assert_param(IS_TIM_LIST9_PERIPH(TIMx));
@@ -2951,7 +2951,7 @@ void TIM_ClearITPendingBit(TIM_TypeDef* TIMx, uint16_t TIM_IT)
   TIMx->CR2 &= (uint16_t)~((uint16_t)TIM_CR2_MMS);
   // Select the TRGO source
   TIMx->CR2 |=  TIM_TRGOSource;
-}*/
+}
 
 /**
   * @brief  Selects the TIMx Slave Mode.
@@ -0,0 +1,26 @@
+// Settings of the simulated devices. The simulated ESP8266 answers with them
+#define DEFAULT_ACCESS_POINT_NAME "Asus"
+#define DEFAULT_ACCESS_POINT_PASSWORD "password"
+#define ESP8226_SERVER_IP_ADDRESS "192.168.0.2"
+#define ESP8226_SERVER_PORT "8080"
+#define ESP8226_OWN_IP_ADDRESS "192.168.0.3"
+#define ESP8226_OWN_DEVICE_NAME "Projector"
+// The simulated devices collect all the optional statistics, the tests check them
+#define POLL_CYCLE_STATISTICS
+#define UPTIME_STATISTICS
+#define FAULT_RECOVERY_STATISTICS
+#define REQUEST_TRACES
+#define COMMAND_TIMEOUT_STATISTICS
+#define RECOVERY_STEP_STATISTICS
+#define RAM_USAGE_STATISTICS
+#define DEVICE_STATISTICS
+// And have all the optional features
+#define USART_BAUD_RATE_ESCALATION
+#define SERVER_PING
+#define WARM_BOOT
+#define LINK_STATUS_QUERY
+#define ADAPTIVE_COMMAND_TIMEOUTS
+#define PAYLOAD_ON_PROMPT
+#define WARM_RESET_RECOVERY
+#define BACKGROUND_LONG_POLLING
+#define CHAINED_TASKS
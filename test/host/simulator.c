@@ -0,0 +1,1158 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+void *host_malloc(size_t size);
+void host_free(void *memory);
+
+// The heap of the device is accounted, the linker script symbols don't clash with the host linker ones
+#define malloc host_malloc
+#define free host_free
+#define main firmware_main
+#define _sdata host_sdata
+#define _edata host_edata
+#define _sbss host_sbss
+#define _ebss host_ebss
+#define _end host_end
+#define _eram host_eram
+#define _verified_config_page host_verified_config_page
+#include "main.c"
+#undef main
+#undef malloc
+#undef free
+
+#include "simulator.h"
+
+#define SIMULATED_RAM_SIZE 4096
+// .data and .bss of the F4P6 build, 1688 bytes, together with the C library ones
+#define SIMULATED_STATIC_DATA_SIZE 1800
+// The stack the firmware is allowed to use. The heap budget is the rest of RAM after the static data
+#define SIMULATED_STACK_SIZE 512
+// The main stack pointer while the free RAM is painted
+#define SIMULATED_START_STACK_BYTES 64
+// The firmware has called NVIC_SystemReset()
+#define SIMULATED_RESET_JUMP 2
+// newlib nano: 4 bytes of the chunk size, 8 bytes alignment
+#define SIMULATED_MALLOC_OVERHEAD_BYTES 4
+#define SIMULATED_MALLOC_ALIGNMENT 8
+// The host pages are larger than the flash ones
+#define SIMULATED_HOST_PAGE_SIZE 4096
+// RCC_FLAG_* of the RCC_CSR reset flags have this in the upper 3 bits, the lower 5 bits are the flag bit
+#define SIMULATED_RCC_CSR_FLAGS 2
+// RAM isn't cleared by the power loss, the .noinit record is random after the power on
+#define SIMULATED_POWER_ON_RAM_BYTE 0x5A
+// The local client closes its link after the command
+#define SIMULATED_LOCAL_CLIENT_CLOSE_MS 20
+// Typical factory calibration values of VREFINT and of the temperature sensor at 30 degrees C
+#define SIMULATED_VREFINT_CAL 1526
+#define SIMULATED_TEMPERATURE_SENSOR_CAL_30C 1750
+// ESP8266 samples the middle of the bits, this deviation of the MCU baud rate still gets through a 10 bits frame
+#define SIMULATED_BAUD_RATE_TOLERANCE_PERCENT 3
+
+unsigned int SIMULATED_STANDARD_BAUD_RATES[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+
+typedef struct HostAllocation {
+   struct HostAllocation *previous;
+   struct HostAllocation *next;
+   unsigned int size;
+} HostAllocation;
+
+HostPeripherals *host_peripherals_g;
+// RAM of the linker script symbols. The firmware paints its free part and scans it for the stack high-water mark
+unsigned int host_ram_g[SIMULATED_RAM_SIZE / sizeof(unsigned int)];
+// The flash page reserved by the linker script. The firmware reads and programs it at its address
+char host_verified_config_page[SIMULATED_FLASH_PAGE_SIZE] __attribute__ ((aligned(SIMULATED_FLASH_PAGE_SIZE)));
+unsigned int sim_failed_checks_g;
+
+SimulatedDevice simulated_devices_g[SIMULATED_DEVICES_MAX];
+SimulatedDevice *selected_device_g;
+unsigned char simulated_devices_amount_g;
+jmp_buf simulator_jump_g;
+unsigned int simulated_time_ms_g;
+unsigned int simulated_tick_g;
+// SIMULATOR_TRACE environment variable prints the USART traffic
+unsigned char simulated_traffic_trace_g;
+
+void map_calibration_values();
+void start_firmware(SimulatedDevice *device);
+void run_firmware_main();
+void run_firmware_turn(SimulatedDevice *device);
+void reset_simulated_device(SimulatedDevice *device);
+void run_simulated_device_ms(SimulatedDevice *device);
+unsigned char is_simulated_device_idle(SimulatedDevice *device);
+void update_esp8266_power(SimulatedDevice *device);
+void restart_esp8266(SimulatedDevice *device);
+unsigned char deliver_esp8266_bytes(SimulatedDevice *device);
+unsigned char is_line_garbling(SimulatedDevice *device);
+void complete_transmission(SimulatedDevice *device);
+void convert_health_channels(SimulatedDevice *device);
+void receive_esp8266_input(SimulatedDevice *device, char *data, unsigned short length);
+void handle_esp8266_command(SimulatedDevice *device, char *command);
+void handle_request_payload(SimulatedDevice *device);
+void send_server_response(SimulatedDevice *device);
+SimulatedReply *add_esp8266_reply(SimulatedDevice *device, unsigned int delay_ms, char *format, ...);
+void close_server_link(SimulatedDevice *device, unsigned int delay_ms);
+unsigned char is_fault_active(SimulatedDevice *device, SimulatedFault fault);
+unsigned int get_chunk_size(unsigned int size);
+void trace_traffic(SimulatedDevice *device, char *direction, char *data, unsigned short length);
+
+/**
+ * .data is "device_g", .bss is the device context. The sizes are the host ones
+ */
+__attribute__ ((used)) void define_linker_script_symbols() {
+   __asm__ volatile (
+         ".globl host_sdata, host_edata, host_sbss, host_ebss, host_end, host_eram\n"
+         ".set host_sdata, host_ram_g\n"
+         ".set host_edata, host_ram_g + %c0\n"
+         ".set host_sbss, host_ram_g + %c0\n"
+         ".set host_ebss, host_ram_g + %c1\n"
+         ".set host_end, host_ram_g + %c1\n"
+         ".set host_eram, host_ram_g + %c2\n"
+         : : "i" (sizeof(DeviceContext *)), "i" (sizeof(DeviceContext *) + sizeof(DeviceContext)), "i" (SIMULATED_RAM_SIZE));
+}
+
+/**
+ * Starts the devices as they've been powered on
+ */
+void sim_init(unsigned char devices_amount) {
+   simulated_devices_amount_g = devices_amount;
+   simulated_traffic_trace_g = getenv("SIMULATOR_TRACE") != NULL;
+   simulated_time_ms_g = 0;
+   simulated_tick_g = 0;
+   selected_device_g = NULL;
+   map_calibration_values();
+
+   for (unsigned char i = 0; i < devices_amount; i++) {
+      SimulatedDevice *device = &simulated_devices_g[i];
+
+      memset(device, 0, sizeof(SimulatedDevice));
+      device->heap_budget_bytes = SIMULATED_RAM_SIZE - SIMULATED_STATIC_DATA_SIZE - SIMULATED_STACK_SIZE;
+      device->server_hold_ms = SIMULATED_DEFAULT_SERVER_HOLD_MS;
+      device->esp8266.joined = 1;
+      device->peripherals.flash.CR = FLASH_CR_LOCK;
+      memset(device->flash_page, 0xFF, SIMULATED_FLASH_PAGE_SIZE);
+      memset(&device->recovery_record, SIMULATED_POWER_ON_RAM_BYTE, sizeof(RecoveryRecord));
+      device->reset_flags = (1 << (RCC_FLAG_PORRST & 0x1F)) | (1 << (RCC_FLAG_PINRST & 0x1F));
+
+      sim_select(i);
+      start_firmware(device);
+      update_esp8266_power(device);
+   }
+}
+
+/**
+ * The firmware and the peripheral stubs are switched to the device. The flash page and the .noinit record written by the previous
+ * device are kept by it
+ */
+void sim_select(unsigned char device_index) {
+   SimulatedDevice *device = &simulated_devices_g[device_index];
+
+   if (device == selected_device_g) {
+      return;
+   }
+   if (selected_device_g != NULL) {
+      memcpy(selected_device_g->flash_page, (void *) VERIFIED_CONFIGURATION_FLASH_ADDRESS, SIMULATED_FLASH_PAGE_SIZE);
+      selected_device_g->recovery_record = recovery_record_g;
+   }
+   memcpy((void *) VERIFIED_CONFIGURATION_FLASH_ADDRESS, device->flash_page, SIMULATED_FLASH_PAGE_SIZE);
+   recovery_record_g = device->recovery_record;
+   selected_device_g = device;
+   device_g = &device->context;
+   host_peripherals_g = &device->peripherals;
+}
+
+SimulatedDevice *sim_device(unsigned char device_index) {
+   sim_select(device_index);
+   return &simulated_devices_g[device_index];
+}
+
+unsigned int sim_time_ms() {
+   return simulated_time_ms_g;
+}
+
+unsigned char sim_relay_is_on(unsigned char device_index) {
+   sim_select(device_index);
+   return (GPIOA->ODR & PROJECTOR_RELAY_PIN) != 0;
+}
+
+/**
+ * The software reset as NVIC_SystemReset() does it
+ */
+void sim_reset(unsigned char device_index) {
+   reset_simulated_device(sim_device(device_index));
+}
+
+/**
+ * All the devices run the same millisecond one after another
+ */
+void sim_run_ms(unsigned int milliseconds) {
+   for (unsigned int i = 0; i < milliseconds; i++) {
+      for (unsigned char device_index = 0; device_index < simulated_devices_amount_g; device_index++) {
+         run_simulated_device_ms(sim_device(device_index));
+      }
+      simulated_time_ms_g++;
+   }
+}
+
+/**
+ * @return 0 if the device hasn't completed the polls in time
+ */
+unsigned char sim_run_until_polls(unsigned char device_index, unsigned int polls, unsigned int max_ms) {
+   for (unsigned int i = 0; i < max_ms && simulated_devices_g[device_index].polls < polls; i++) {
+      sim_run_ms(1);
+   }
+   return simulated_devices_g[device_index].polls >= polls;
+}
+
+void sim_inject_fault(unsigned char device_index, SimulatedFault fault, unsigned int duration_ms) {
+   SimulatedDevice *device = sim_device(device_index);
+
+   device->fault = fault;
+   device->fault_end_ms = simulated_time_ms_g + duration_ms;
+
+   if (fault == ACCESS_POINT_LOST_SIMULATED_FAULT) {
+      device->esp8266.joined = 0;
+      if (device->esp8266.started) {
+         add_esp8266_reply(device, 0, "WIFI DISCONNECT\r\n");
+      }
+      close_server_link(device, 0);
+   } else if (fault == SERVER_DOWN_SIMULATED_FAULT) {
+      close_server_link(device, 0);
+   }
+}
+
+/**
+ * A LAN client connects to the local control server, sends the command and closes its link
+ */
+void sim_send_local_command(unsigned char device_index, char link_id, char *command) {
+   SimulatedDevice *device = sim_device(device_index);
+
+   if (!device->esp8266.local_server_started) {
+      return;
+   }
+   add_esp8266_reply(device, 0, "%c,CONNECT\r\n\r\n+IPD,%c,%zu:%s", link_id, link_id, strlen(command), command);
+   add_esp8266_reply(device, SIMULATED_LOCAL_CLIENT_CLOSE_MS, "%c,CLOSED\r\n", link_id);
+}
+
+unsigned char is_fault_active(SimulatedDevice *device, SimulatedFault fault) {
+   return device->fault == fault && simulated_time_ms_g < device->fault_end_ms;
+}
+
+void sim_check(int passed, const char *condition, const char *file, int line) {
+   if (!passed) {
+      sim_failed_checks_g++;
+      printf("%s:%d: check failed: %s\n", file, line, condition);
+   }
+}
+
+/**
+ * The firmware reads the factory calibration values at their system memory addresses
+ */
+void map_calibration_values() {
+   static void *calibration_mapping;
+   void *host_page_address = (void *) ((uintptr_t) &VREFINT_CAL & ~(SIMULATED_HOST_PAGE_SIZE - 1));
+
+   if (calibration_mapping == NULL) {
+      calibration_mapping = mmap(host_page_address, SIMULATED_HOST_PAGE_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+      if (calibration_mapping != host_page_address) {
+         printf("The calibration values can't be mapped at %p\n", host_page_address);
+         exit(1);
+      }
+      VREFINT_CAL = SIMULATED_VREFINT_CAL;
+      TEMPERATURE_SENSOR_CAL_30C = SIMULATED_TEMPERATURE_SENSOR_CAL_30C;
+   }
+}
+
+int sim_report(const char *test_name) {
+   printf("%s: %s\n", test_name, sim_failed_checks_g ? "FAILED" : "passed");
+   return sim_failed_checks_g ? 1 : 0;
+}
+
+/**
+ * main() is started on the device stack and runs until the end of its first main loop turn
+ */
+void start_firmware(SimulatedDevice *device) {
+   getcontext(&device->firmware_start_context);
+   device->firmware_start_context.uc_stack.ss_sp = device->firmware_stack;
+   device->firmware_start_context.uc_stack.ss_size = sizeof(device->firmware_stack);
+   device->firmware_start_context.uc_link = NULL;
+   makecontext(&device->firmware_start_context, run_firmware_main, 0);
+
+   int jump = _setjmp(simulator_jump_g);
+
+   if (!jump) {
+      setcontext(&device->firmware_start_context);
+   } else if (jump == SIMULATED_RESET_JUMP) {
+      reset_simulated_device(device);
+   }
+}
+
+void run_firmware_main() {
+   firmware_main();
+}
+
+/**
+ * The firmware goes on from the watchdog reload of its previous main loop turn. The stacks are switched without the signal mask
+ * system calls, so a simulated day takes seconds
+ */
+void run_firmware_turn(SimulatedDevice *device) {
+   int jump = _setjmp(simulator_jump_g);
+
+   if (!jump) {
+      _longjmp(device->firmware_jump, 1);
+   } else if (jump == SIMULATED_RESET_JUMP) {
+      reset_simulated_device(device);
+   }
+}
+
+/**
+ * The heap, the context and the peripherals are lost. main() starts again on the device stack
+ */
+void reset_simulated_device(SimulatedDevice *device) {
+   while (device->allocations != NULL) {
+      host_free(device->allocations + 1);
+   }
+   memset(&device->context, 0, sizeof(DeviceContext));
+   memset(&device->peripherals, 0, sizeof(HostPeripherals));
+   device->peripherals.flash.CR = FLASH_CR_LOCK;
+   device->pll_enabled = 0;
+   device->adc_started = 0;
+   device->adc_conversions = 0;
+   device->usart_flags = 0;
+   device->transmission_in_progress = 0;
+   device->reset_flags |= 1 << (RCC_FLAG_SFTRST & 0x1F);
+   device->resets++;
+
+   start_firmware(device);
+   update_esp8266_power(device);
+}
+
+/**
+ * The millisecond without the USART traffic is run as one tick, so most of the long polling hold takes 8 times less turns
+ */
+void run_simulated_device_ms(SimulatedDevice *device) {
+   unsigned char ticks = is_simulated_device_idle(device) ? 1 : SIMULATED_TICKS_PER_MS;
+
+   for (unsigned char tick = 0; tick < ticks; tick++) {
+      SimulatedEsp8266 *esp8266 = &device->esp8266;
+
+      simulated_tick_g = simulated_time_ms_g * SIMULATED_TICKS_PER_MS + tick;
+      device->peripherals.systick.VAL = SYSTICK_TICKS_PER_MS - 1 - tick * (SYSTICK_TICKS_PER_MS / SIMULATED_TICKS_PER_MS);
+
+      if (tick == 0 && esp8266->started && is_fault_active(device, GARBAGE_SIMULATED_FAULT) &&
+            simulated_time_ms_g % SIMULATED_GARBAGE_PERIOD_MS == 0) {
+         add_esp8266_reply(device, 0, "\xFE\x13\x80\xFF~\r\n");
+      }
+      if (esp8266->started && esp8266->request_held && simulated_time_ms_g >= esp8266->response_due_ms) {
+         send_server_response(device);
+      }
+      if (!deliver_esp8266_bytes(device)) {
+         // The idle timer period is close to the tick, it keeps counting the timeouts during the skipped ticks
+         for (unsigned char period = 0; period < SIMULATED_TICKS_PER_MS / ticks; period++) {
+            TIM3_IRQHandler();
+         }
+      }
+      complete_transmission(device);
+
+      run_firmware_turn(device);
+      update_esp8266_power(device);
+   }
+
+   SysTick_Handler();
+   if (simulated_time_ms_g % 100 == 99) {
+      TIM14_IRQHandler();
+   }
+   if (simulated_time_ms_g % TIMER1_PERIOD_MS == TIMER1_PERIOD_MS - 1) {
+      convert_health_channels(device);
+   }
+}
+
+/**
+ * Nothing is sent or received by both sides during the millisecond
+ */
+unsigned char is_simulated_device_idle(SimulatedDevice *device) {
+   SimulatedEsp8266 *esp8266 = &device->esp8266;
+
+   return !(is_fault_active(device, GARBAGE_SIMULATED_FAULT) && simulated_time_ms_g % SIMULATED_GARBAGE_PERIOD_MS == 0) &&
+         !device->transmission_in_progress && !(esp8266->replies_amount && esp8266->replies[0].due_ms <= simulated_time_ms_g) &&
+         !(esp8266->started && esp8266->request_held && esp8266->response_due_ms <= simulated_time_ms_g);
+}
+
+/**
+ * ESP8266 is powered by the control pin. It prints "ready" when it's started. The access point is joined by the saved settings
+ */
+void update_esp8266_power(SimulatedDevice *device) {
+   SimulatedEsp8266 *esp8266 = &device->esp8266;
+   unsigned char powered = (GPIOA->ODR & ESP8266_CONTROL_PIN) != 0;
+
+   if (powered != esp8266->powered) {
+      restart_esp8266(device);
+      esp8266->powered = powered;
+   }
+   if (esp8266->powered && !esp8266->started && simulated_time_ms_g - esp8266->power_on_ms >= SIMULATED_ESP8266_START_MS) {
+      esp8266->started = 1;
+      add_esp8266_reply(device, 0, "\r\nready\r\n");
+   }
+}
+
+/**
+ * The settings have been saved, so the access point is joined again. The link is lost with the pending replies
+ */
+void restart_esp8266(SimulatedDevice *device) {
+   SimulatedEsp8266 *esp8266 = &device->esp8266;
+   unsigned char powered = esp8266->powered;
+   unsigned char joined = esp8266->joined;
+
+   memset(esp8266, 0, sizeof(SimulatedEsp8266));
+   esp8266->powered = powered;
+   esp8266->joined = joined;
+   esp8266->power_on_ms = simulated_time_ms_g;
+   esp8266->baud_rate = USART_BAUD_RATE;
+}
+
+/**
+ * The replies are sent one after another with the ESP8266 baud rate. The bytes are garbled when the USART one differs or the line
+ * garbles them. A dropped byte takes its time, but it doesn't reach USART
+ *
+ * @return 0 if nothing has been received during the tick
+ */
+unsigned char deliver_esp8266_bytes(SimulatedDevice *device) {
+   SimulatedEsp8266 *esp8266 = &device->esp8266;
+   unsigned char delivered = 0;
+
+   if (!esp8266->replies_amount || esp8266->replies[0].due_ms > simulated_time_ms_g) {
+      esp8266->byte_credit = 0;
+      return 0;
+   }
+
+   esp8266->byte_credit += esp8266->baud_rate;
+   while (esp8266->replies_amount && esp8266->replies[0].due_ms <= simulated_time_ms_g &&
+         esp8266->byte_credit >= SIMULATED_BAUD_RATE_PER_BYTE_TICK) {
+      SimulatedReply *reply = &esp8266->replies[0];
+      unsigned char garbled = esp8266->baud_rate != device->usart_baud_rate || is_line_garbling(device);
+      unsigned char dropped = is_fault_active(device, DROPPED_BYTES_SIMULATED_FAULT) &&
+            reply->sent_bytes % SIMULATED_DROPPED_BYTE_PERIOD == SIMULATED_DROPPED_BYTE_PERIOD - 1;
+
+      esp8266->byte_credit -= SIMULATED_BAUD_RATE_PER_BYTE_TICK;
+      device->received_byte = garbled ? (char) 0xFF : reply->data[reply->sent_bytes];
+      device->usart_flags = USART_FLAG_RXNE | (garbled ? USART_FLAG_FE : 0);
+      reply->sent_bytes++;
+      if (!dropped) {
+         USART1_IRQHandler();
+         delivered = 1;
+      }
+
+      if (reply->sent_bytes == reply->length) {
+         trace_traffic(device, "<-", reply->data, reply->length);
+         if (reply->next_baud_rate) {
+            esp8266->baud_rate = reply->next_baud_rate;
+         }
+         if (reply->restart) {
+            restart_esp8266(device);
+            break;
+         }
+         esp8266->replies_amount--;
+         memmove(&esp8266->replies[0], &esp8266->replies[1], esp8266->replies_amount * sizeof(SimulatedReply));
+      }
+   }
+   return delivered;
+}
+
+/**
+ * Called for every byte from ESP8266
+ */
+unsigned char is_line_garbling(SimulatedDevice *device) {
+   unsigned int baud_rate = device->esp8266.baud_rate;
+
+   if (device->garbling_baud_rate && baud_rate >= device->garbling_baud_rate) {
+      return 1;
+   }
+   if (device->line_error_period_ms && baud_rate != USART_BAUD_RATE && simulated_time_ms_g >= device->next_line_error_ms) {
+      device->next_line_error_ms = simulated_time_ms_g + device->line_error_period_ms;
+      return 1;
+   }
+   return 0;
+}
+
+void complete_transmission(SimulatedDevice *device) {
+   if (!device->transmission_in_progress || simulated_tick_g < device->transmission_end_tick) {
+      return;
+   }
+
+   device->transmission_in_progress = 0;
+   DMA1_Channel2_3_IRQHandler();
+   trace_traffic(device, "->", device->transmitted, device->transmitted_length);
+
+   if (device->esp8266.started && device->esp8266.baud_rate == device->usart_baud_rate &&
+         (!device->garbling_baud_rate || device->usart_baud_rate < device->garbling_baud_rate)) {
+      receive_esp8266_input(device, device->transmitted, device->transmitted_length);
+   }
+}
+
+void receive_esp8266_input(SimulatedDevice *device, char *data, unsigned short length) {
+   SimulatedEsp8266 *esp8266 = &device->esp8266;
+
+   esp8266->reply_delay_ms = is_fault_active(device, DELAYED_OK_SIMULATED_FAULT) ? SIMULATED_DELAYED_OK_MS : 0;
+
+   for (unsigned short i = 0; i < length; i++) {
+      if (esp8266->input_length >= SIMULATED_INPUT_SIZE - 1) {
+         esp8266->input_length = 0;
+      }
+      esp8266->input[esp8266->input_length++] = data[i];
+
+      if (esp8266->payload_expected) {
+         if (esp8266->input_length == esp8266->payload_length) {
+            esp8266->input[esp8266->input_length] = '\0';
+            esp8266->payload_expected = 0;
+            handle_request_payload(device);
+            esp8266->input_length = 0;
+         }
+      } else if (esp8266->input_length >= 2 && data[i] == '\n' && esp8266->input[esp8266->input_length - 2] == '\r') {
+         esp8266->input[esp8266->input_length - 2] = '\0';
+         esp8266->input_length = 0;
+         if (is_fault_active(device, BUSY_ESP8266_SIMULATED_FAULT)) {
+            add_esp8266_reply(device, 1, "busy p...\r\n");
+         } else if (!is_fault_active(device, SILENT_ESP8266_SIMULATED_FAULT)) {
+            handle_esp8266_command(device, esp8266->input);
+         }
+      }
+   }
+   esp8266->reply_delay_ms = 0;
+}
+
+/**
+ * The echo is off: ATE0 is the first command after the start
+ */
+void handle_esp8266_command(SimulatedDevice *device, char *command) {
+   SimulatedEsp8266 *esp8266 = &device->esp8266;
+   unsigned char access_point_lost = is_fault_active(device, ACCESS_POINT_LOST_SIMULATED_FAULT);
+   unsigned char server_down = access_point_lost || is_fault_active(device, SERVER_DOWN_SIMULATED_FAULT);
+
+   if (!strcmp(command, "ATE0") || !strcmp(command, "AT") || is_string_starts_with(command, "AT+CWMODE_DEF=") ||
+         is_string_starts_with(command, "AT+CIPSTA_DEF=")) {
+      add_esp8266_reply(device, 2, "\r\nOK\r\n");
+   } else if (!strcmp(command, "AT+CIPMUX=1")) {
+      esp8266->multiple_connections = 1;
+      add_esp8266_reply(device, 2, "\r\nOK\r\n");
+   } else if (is_string_starts_with(command, "AT+CIPSERVER=1,")) {
+      // The server needs the multiple connections mode
+      esp8266->local_server_started = esp8266->multiple_connections;
+      add_esp8266_reply(device, 2, esp8266->local_server_started ? "\r\nOK\r\n" : "\r\nERROR\r\n");
+   } else if (is_string_starts_with(command, "AT+UART_CUR=")) {
+      add_esp8266_reply(device, 2, "\r\nOK\r\n")->next_baud_rate = atoi(command + strlen("AT+UART_CUR="));
+   } else if (!strcmp(command, "AT+RST")) {
+      add_esp8266_reply(device, 2, "\r\nOK\r\n")->restart = 1;
+   } else if (!strcmp(command, "AT+CWMODE_DEF?")) {
+      add_esp8266_reply(device, 2, "+CWMODE_DEF:1\r\n\r\nOK\r\n");
+   } else if (!strcmp(command, "AT+CIPSTA_DEF?")) {
+      add_esp8266_reply(device, 2, "+CIPSTA_DEF:ip:\"" ESP8226_OWN_IP_ADDRESS "\"\r\n+CIPSTA_DEF:gateway:\"192.168.0.1\"\r\n"
+            "+CIPSTA_DEF:netmask:\"255.255.255.0\"\r\n\r\nOK\r\n");
+   } else if (!strcmp(command, "AT+CWJAP?")) {
+      if (esp8266->joined) {
+         add_esp8266_reply(device, 2, "+CWJAP:\"" DEFAULT_ACCESS_POINT_NAME "\",\"aa:bb:cc:dd:ee:ff\",6,-60\r\n\r\nOK\r\n");
+      } else {
+         add_esp8266_reply(device, 2, "No AP\r\n\r\nOK\r\n");
+      }
+   } else if (is_string_starts_with(command, "AT+CWJAP_DEF=")) {
+      if (access_point_lost) {
+         add_esp8266_reply(device, 3000, "+CWJAP:3\r\n\r\nFAIL\r\n");
+      } else {
+         esp8266->joined = 1;
+         add_esp8266_reply(device, 2000, "WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n");
+      }
+   } else if (!strcmp(command, "AT+CWLAP")) {
+      char networks[SIMULATED_REPLY_SIZE] = "";
+      unsigned short networks_length = 0;
+
+      // The additional neighbours come before the default access point, so it's at the end of the long list
+      for (unsigned char i = 0; i < device->additional_neighbour_networks; i++) {
+         networks_length += snprintf(networks + networks_length, sizeof(networks) - networks_length,
+               "+CWLAP:(4,\"Neighbour%u\",-90,\"11:22:33:44:55:%02x\",11,0)\r\n", i, i);
+      }
+      if (access_point_lost) {
+         add_esp8266_reply(device, 1500, "%s+CWLAP:(4,\"Neighbour\",-85,\"11:22:33:44:55:66\",1,0)\r\n\r\nOK\r\n", networks);
+      } else {
+         // The louder neighbour, which name starts with the default one, comes first
+         add_esp8266_reply(device, 1500, "%s+CWLAP:(3,\"" DEFAULT_ACCESS_POINT_NAME "_5G\",-40,\"aa:bb:cc:dd:ee:fe\",36,0)\r\n"
+               "+CWLAP:(3,\"" DEFAULT_ACCESS_POINT_NAME "\",-62,\"aa:bb:cc:dd:ee:ff\",6,0)\r\n"
+               "+CWLAP:(4,\"Neighbour\",-85,\"11:22:33:44:55:66\",1,0)\r\n\r\nOK\r\n", networks);
+      }
+   } else if (!strcmp(command, "AT+CIPSTATUS")) {
+      if (!esp8266->joined) {
+         add_esp8266_reply(device, 2, "STATUS:5\r\n\r\nOK\r\n");
+      } else if (esp8266->server_link_open) {
+         // The single connection is listed as the link 0
+         add_esp8266_reply(device, 2, "STATUS:3\r\n+CIPSTATUS:%s\"TCP\",\"" ESP8226_SERVER_IP_ADDRESS "\"," ESP8226_SERVER_PORT ",4096,0\r\n\r\nOK\r\n",
+               esp8266->multiple_connections ? esp8266->server_link_prefix : "0,");
+      } else {
+         add_esp8266_reply(device, 2, "STATUS:2\r\n\r\nOK\r\n");
+      }
+   } else if (is_string_starts_with(command, "AT+CIPSTART=")) {
+      char *link_id = command + strlen("AT+CIPSTART=");
+
+      if (esp8266->multiple_connections != (*link_id >= '0' && *link_id <= '4')) {
+         add_esp8266_reply(device, 2, "\r\nERROR\r\n");
+      } else if (esp8266->server_link_open) {
+         add_esp8266_reply(device, 2, "ALREADY CONNECTED\r\n\r\nERROR\r\n");
+      } else if (server_down) {
+         add_esp8266_reply(device, 1000, "\r\nERROR\r\nCLOSED\r\n");
+      } else {
+         esp8266->server_link_open = 1;
+         // "4,"
+         snprintf(esp8266->server_link_prefix, sizeof(esp8266->server_link_prefix), "%s", esp8266->multiple_connections ? link_id : "");
+         add_esp8266_reply(device, 20, "%sCONNECT\r\n\r\nOK\r\n", esp8266->server_link_prefix);
+      }
+   } else if (is_string_starts_with(command, "AT+CIPSEND=")) {
+      if (esp8266->server_link_open) {
+         esp8266->payload_expected = 1;
+         esp8266->payload_length = atoi(command + strlen("AT+CIPSEND=") + strlen(esp8266->server_link_prefix));
+         add_esp8266_reply(device, 2, "\r\nOK\r\n> ");
+      } else {
+         add_esp8266_reply(device, 2, "link is not valid\r\n\r\nERROR\r\n");
+      }
+   } else if (is_string_starts_with(command, "AT+PING=")) {
+      if (server_down) {
+         add_esp8266_reply(device, 1000, "+timeout\r\n\r\nERROR\r\n");
+      } else {
+         add_esp8266_reply(device, 12, "+12\r\n\r\nOK\r\n");
+      }
+   } else if (is_string_starts_with(command, "AT+CIPCLOSE")) {
+      if (esp8266->server_link_open) {
+         esp8266->server_link_open = 0;
+         esp8266->request_held = 0;
+         add_esp8266_reply(device, 10, "%sCLOSED\r\n\r\nOK\r\n", esp8266->server_link_prefix);
+      } else {
+         add_esp8266_reply(device, 2, "\r\nERROR\r\n");
+      }
+   } else {
+      add_esp8266_reply(device, 2, "\r\nERROR\r\n");
+   }
+}
+
+/**
+ * The server holds the request. The one without the debug info gets "includeDebugInfo" when the test asks for it. The unavailable
+ * server answers at once
+ */
+void handle_request_payload(SimulatedDevice *device) {
+   SimulatedEsp8266 *esp8266 = &device->esp8266;
+   SimulatedRequest *request = &device->requests[device->requests_amount % SIMULATED_REQUESTS_SIZE];
+   char *headers_end = strstr(esp8266->input, "\r\n\r\n");
+   char *content_length = strstr(esp8266->input, "Content-Length: ");
+
+   memset(request, 0, sizeof(SimulatedRequest));
+   request->received_ms = simulated_time_ms_g;
+   request->announced_length = esp8266->payload_length;
+   request->received_length = esp8266->input_length;
+   if (content_length != NULL) {
+      request->content_length = atoi(content_length + strlen("Content-Length: "));
+   }
+   if (headers_end != NULL) {
+      char *body = headers_end + 4;
+      unsigned short body_length = esp8266->input_length - (body - esp8266->input);
+
+      // The body is followed by "\r\n"
+      request->body_length = body_length >= 2 ? body_length - 2 : 0;
+      request->has_debug_info = strstr(body, "\"debugInfoIncluded\":true") != NULL;
+      request->has_local_control = strstr(body, "\"localControl\":") != NULL;
+      char *status_sequence = strstr(body, "\"statusSequence\":\"");
+
+      if (status_sequence != NULL) {
+         request->status_sequence = atoi(status_sequence + strlen("\"statusSequence\":\""));
+      }
+      if (request->has_debug_info) {
+         memcpy(device->debug_info_body, body, request->body_length);
+         device->debug_info_body[request->body_length] = '\0';
+      }
+   }
+   device->requests_amount++;
+   if (device->last_response_ok) {
+      device->last_response_ok = 0;
+      device->polls++;
+   }
+
+   add_esp8266_reply(device, 5, "\r\nRecv %u bytes\r\n\r\nSEND OK\r\n", esp8266->payload_length);
+   if (is_fault_active(device, CONNECTION_CLOSED_MID_REQUEST_SIMULATED_FAULT)) {
+      close_server_link(device, SIMULATED_CLOSED_MID_REQUEST_MS);
+      return;
+   }
+   esp8266->request_held = 1;
+   esp8266->response_due_ms = simulated_time_ms_g + (is_fault_active(device, SERVER_UNAVAILABLE_SIMULATED_FAULT) ? 20 : device->server_hold_ms);
+}
+
+/**
+ * The server closes the link right after the response, so ESP8266 prints "CLOSED" behind the data
+ */
+void send_server_response(SimulatedDevice *device) {
+   char body[128];
+   char response[512];
+
+   device->esp8266.request_held = 0;
+   if (is_fault_active(device, SERVER_UNAVAILABLE_SIMULATED_FAULT)) {
+      snprintf(response, sizeof(response), "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n");
+   } else {
+      snprintf(body, sizeof(body), "{\"statusCode\":\"OK\",\"turnOn\":%s,\"includeDebugInfo\":%s}", device->turn_on ? "true" : "false",
+            device->include_debug_info ? "true" : "false");
+      snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n%s",
+            strlen(body), body);
+      device->last_response_ok = 1;
+   }
+   add_esp8266_reply(device, 0, "\r\n+IPD,%s%zu:%s", device->esp8266.server_link_prefix, strlen(response), response);
+   device->responses_sent++;
+   close_server_link(device, 0);
+}
+
+void close_server_link(SimulatedDevice *device, unsigned int delay_ms) {
+   SimulatedEsp8266 *esp8266 = &device->esp8266;
+
+   if (!esp8266->server_link_open) {
+      return;
+   }
+   esp8266->server_link_open = 0;
+   esp8266->request_held = 0;
+   if (esp8266->started) {
+      add_esp8266_reply(device, delay_ms, "%sCLOSED\r\n", esp8266->server_link_prefix);
+   }
+}
+
+/**
+ * The replies are sent by their time. The one being sent isn't interrupted. The silent ESP8266 loses them
+ */
+SimulatedReply *add_esp8266_reply(SimulatedDevice *device, unsigned int delay_ms, char *format, ...) {
+   static SimulatedReply lost_reply;
+   SimulatedEsp8266 *esp8266 = &device->esp8266;
+   unsigned int due_ms = simulated_time_ms_g + delay_ms + esp8266->reply_delay_ms;
+   unsigned char index = esp8266->replies_amount;
+   va_list arguments;
+
+   if (is_fault_active(device, SILENT_ESP8266_SIMULATED_FAULT)) {
+      return &lost_reply;
+   }
+
+   if (esp8266->replies_amount >= SIMULATED_REPLIES_SIZE) {
+      printf("Simulated ESP8266 replies overflow\n");
+      exit(2);
+   }
+   while (index > 0 && esp8266->replies[index - 1].due_ms > due_ms && !(index == 1 && esp8266->replies[0].sent_bytes)) {
+      index--;
+   }
+   memmove(&esp8266->replies[index + 1], &esp8266->replies[index], (esp8266->replies_amount - index) * sizeof(SimulatedReply));
+   esp8266->replies_amount++;
+
+   SimulatedReply *reply = &esp8266->replies[index];
+
+   reply->due_ms = due_ms;
+   va_start(arguments, format);
+   vsnprintf(reply->data, sizeof(reply->data), format, arguments);
+   va_end(arguments);
+   reply->length = strlen(reply->data);
+   reply->sent_bytes = 0;
+   reply->next_baud_rate = 0;
+   reply->restart = 0;
+   return reply;
+}
+
+void trace_traffic(SimulatedDevice *device, char *direction, char *data, unsigned short length) {
+   if (!simulated_traffic_trace_g) {
+      return;
+   }
+
+   printf("%7u %s ", simulated_time_ms_g, direction);
+   for (unsigned short i = 0; i < length; i++) {
+      if (data[i] == '\r') {
+         printf("\\r");
+      } else if (data[i] == '\n') {
+         printf("\\n");
+      } else {
+         putchar(data[i]);
+      }
+   }
+   putchar('\n');
+}
+
+/**
+ * The allocations are accounted like newlib does it. Fragmentation isn't simulated, so the peak is the least heap the device needs
+ */
+void *host_malloc(size_t size) {
+   SimulatedDevice *device = selected_device_g;
+   unsigned int chunk_size = get_chunk_size(size);
+
+   if (device->heap_bytes + chunk_size > device->heap_budget_bytes) {
+      device->failed_allocations++;
+      return NULL;
+   }
+
+   HostAllocation *allocation = malloc(sizeof(HostAllocation) + size);
+
+   allocation->size = size;
+   allocation->previous = NULL;
+   allocation->next = device->allocations;
+   if (device->allocations != NULL) {
+      device->allocations->previous = allocation;
+   }
+   device->allocations = allocation;
+
+   device->heap_bytes += chunk_size;
+   if (device->heap_bytes > device->heap_peak_bytes) {
+      device->heap_peak_bytes = device->heap_bytes;
+   }
+   return allocation + 1;
+}
+
+void host_free(void *memory) {
+   if (memory == NULL) {
+      return;
+   }
+
+   SimulatedDevice *device = selected_device_g;
+   HostAllocation *allocation = (HostAllocation *) memory - 1;
+
+   if (allocation->previous != NULL) {
+      allocation->previous->next = allocation->next;
+   } else {
+      device->allocations = allocation->next;
+   }
+   if (allocation->next != NULL) {
+      allocation->next->previous = allocation->previous;
+   }
+   device->heap_bytes -= get_chunk_size(allocation->size);
+   free(allocation);
+}
+
+unsigned int get_chunk_size(unsigned int size) {
+   return (size + SIMULATED_MALLOC_OVERHEAD_BYTES + SIMULATED_MALLOC_ALIGNMENT - 1) & ~(SIMULATED_MALLOC_ALIGNMENT - 1);
+}
+
+/**
+ * The end of the main loop turn
+ */
+void IWDG_ReloadCounter(void) {
+   if (!_setjmp(selected_device_g->firmware_jump)) {
+      _longjmp(simulator_jump_g, 1);
+   }
+}
+
+/**
+ * The firmware stack is left for the simulator one, the device is restarted from there
+ */
+void NVIC_SystemReset(void) {
+   _longjmp(simulator_jump_g, SIMULATED_RESET_JUMP);
+}
+
+/**
+ * The heap never shrinks on the device, so the break is at the peak
+ */
+void *_sbrk(int increment) {
+   return _end + selected_device_g->heap_peak_bytes;
+}
+
+uint32_t __get_MSP(void) {
+   return (uint32_t) (uintptr_t) (_eram - SIMULATED_START_STACK_BYTES);
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn) {
+}
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority) {
+}
+
+uint32_t SysTick_Config(uint32_t ticks) {
+   host_peripherals_g->systick.LOAD = ticks - 1;
+   return 0;
+}
+
+GPIO_TypeDef *get_host_gpioa() {
+   GPIO_TypeDef *gpioa = &host_peripherals_g->gpioa;
+
+   gpioa->ODR = (gpioa->ODR | (gpioa->BSRR & 0xFFFF)) & ~(gpioa->BSRR >> 16) & ~gpioa->BRR;
+   gpioa->BSRR = 0;
+   gpioa->BRR = 0;
+   return gpioa;
+}
+
+/**
+ * The keys unlock and the page erase is done on the next access after they've been written, the programming is done by the
+ * firmware write itself
+ */
+FLASH_TypeDef *get_host_flash() {
+   FLASH_TypeDef *flash = &host_peripherals_g->flash;
+
+   if (flash->KEYR == FLASH_FKEY2) {
+      flash->KEYR = 0;
+      flash->CR &= ~FLASH_CR_LOCK;
+   }
+   if ((flash->CR & FLASH_CR_STRT) && (flash->CR & FLASH_CR_PER) && !(flash->CR & FLASH_CR_LOCK)) {
+      if (flash->AR == VERIFIED_CONFIGURATION_FLASH_ADDRESS) {
+         memset((void *) VERIFIED_CONFIGURATION_FLASH_ADDRESS, 0xFF, SIMULATED_FLASH_PAGE_SIZE);
+         selected_device_g->flash_erases++;
+         if (selected_device_g->esp8266.replies_amount || selected_device_g->esp8266.request_held) {
+            selected_device_g->busy_link_flash_erases++;
+         }
+      }
+      flash->CR &= ~FLASH_CR_STRT;
+      flash->SR |= FLASH_SR_EOP;
+   }
+   return flash;
+}
+
+void RCC_AHBPeriphClockCmd(uint32_t RCC_AHBPeriph, FunctionalState NewState) {
+}
+
+void RCC_APB1PeriphClockCmd(uint32_t RCC_APB1Periph, FunctionalState NewState) {
+}
+
+void RCC_APB2PeriphClockCmd(uint32_t RCC_APB2Periph, FunctionalState NewState) {
+}
+
+void RCC_SYSCLKConfig(uint32_t RCC_SYSCLKSource) {
+}
+
+void RCC_PLLConfig(uint32_t RCC_PLLSource, uint32_t RCC_PLLMul) {
+}
+
+void RCC_PCLKConfig(uint32_t RCC_HCLK) {
+}
+
+void RCC_PLLCmd(FunctionalState NewState) {
+   selected_device_g->pll_enabled = NewState == ENABLE;
+}
+
+FlagStatus RCC_GetFlagStatus(uint8_t RCC_FLAG) {
+   if (RCC_FLAG >> 5 == SIMULATED_RCC_CSR_FLAGS) {
+      return selected_device_g->reset_flags & (1 << (RCC_FLAG & 0x1F)) ? SET : RESET;
+   }
+   return RCC_FLAG == RCC_FLAG_PLLRDY && selected_device_g->pll_enabled ? SET : RESET;
+}
+
+void RCC_ClearFlag(void) {
+   selected_device_g->reset_flags = 0;
+}
+
+void DBGMCU_APB1PeriphConfig(uint32_t DBGMCU_Periph, FunctionalState NewState) {
+}
+
+void DBGMCU_APB2PeriphConfig(uint32_t DBGMCU_Periph, FunctionalState NewState) {
+}
+
+void IWDG_Enable(void) {
+}
+
+void IWDG_WriteAccessCmd(uint16_t IWDG_WriteAccess) {
+}
+
+void IWDG_SetPrescaler(uint8_t IWDG_Prescaler) {
+}
+
+void IWDG_SetReload(uint16_t Reload) {
+}
+
+FlagStatus IWDG_GetFlagStatus(uint16_t IWDG_FLAG) {
+   return RESET;
+}
+
+void GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_InitStruct) {
+}
+
+void GPIO_PinAFConfig(GPIO_TypeDef* GPIOx, uint16_t GPIO_PinSource, uint8_t GPIO_AF) {
+}
+
+void GPIO_WriteBit(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, BitAction BitVal) {
+   if (BitVal == Bit_SET) {
+      GPIOx->BSRR = GPIO_Pin;
+   } else {
+      GPIOx->BRR = GPIO_Pin;
+   }
+}
+
+uint8_t GPIO_ReadOutputDataBit(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+   return GPIOx->ODR & GPIO_Pin ? Bit_SET : Bit_RESET;
+}
+
+/**
+ * The baud rate BRR gives with CLOCK_SPEED. It's taken as the standard one within SIMULATED_BAUD_RATE_TOLERANCE_PERCENT, so
+ * ESP8266 understands it
+ */
+unsigned int get_usart_line_baud_rate() {
+   USART_TypeDef *usart = &host_peripherals_g->usart1;
+   unsigned int usart_divider = usart->BRR;
+
+   if (usart->CR1 & USART_CR1_OVER8) {
+      usart_divider = ((usart_divider & ~0xF) | ((usart_divider & 0x7) << 1)) / 2;
+   }
+   if (!usart_divider) {
+      return 0;
+   }
+
+   unsigned int baud_rate = CLOCK_SPEED / usart_divider;
+
+   for (unsigned char i = 0; i < sizeof(SIMULATED_STANDARD_BAUD_RATES) / sizeof(SIMULATED_STANDARD_BAUD_RATES[0]); i++) {
+      unsigned int standard_baud_rate = SIMULATED_STANDARD_BAUD_RATES[i];
+      unsigned int difference = baud_rate > standard_baud_rate ? baud_rate - standard_baud_rate : standard_baud_rate - baud_rate;
+
+      if (difference * 100 <= standard_baud_rate * SIMULATED_BAUD_RATE_TOLERANCE_PERCENT) {
+         return standard_baud_rate;
+      }
+   }
+   return baud_rate;
+}
+
+/**
+ * The baud rate written into BRR takes effect when USART is enabled
+ */
+void USART_Cmd(USART_TypeDef* USARTx, FunctionalState NewState) {
+   if (NewState == ENABLE) {
+      selected_device_g->usart_baud_rate = get_usart_line_baud_rate();
+   }
+}
+
+void USART_OverSampling8Cmd(USART_TypeDef* USARTx, FunctionalState NewState) {
+}
+
+void USART_ITConfig(USART_TypeDef* USARTx, uint32_t USART_IT, FunctionalState NewState) {
+}
+
+void USART_DMACmd(USART_TypeDef* USARTx, uint32_t USART_DMAReq, FunctionalState NewState) {
+}
+
+FlagStatus USART_GetFlagStatus(USART_TypeDef* USARTx, uint32_t USART_FLAG) {
+   return selected_device_g->usart_flags & USART_FLAG ? SET : RESET;
+}
+
+void USART_ClearFlag(USART_TypeDef* USARTx, uint32_t USART_FLAG) {
+   selected_device_g->usart_flags &= ~USART_FLAG;
+}
+
+void USART_ClearITPendingBit(USART_TypeDef* USARTx, uint32_t USART_IT) {
+}
+
+uint16_t USART_ReceiveData(USART_TypeDef* USARTx) {
+   selected_device_g->usart_flags &= ~USART_FLAG_RXNE;
+   return (unsigned char) selected_device_g->received_byte;
+}
+
+/**
+ * The ADC channel keeps its buffer, the USART one is started with the payload address and length
+ */
+void DMA_Init(DMA_Channel_TypeDef* DMAy_Channelx, DMA_InitTypeDef* DMA_InitStruct) {
+   if (DMAy_Channelx == DMA1_Channel1) {
+      DMAy_Channelx->CMAR = DMA_InitStruct->DMA_MemoryBaseAddr;
+      DMAy_Channelx->CNDTR = DMA_InitStruct->DMA_BufferSize;
+   }
+}
+
+void DMA_ITConfig(DMA_Channel_TypeDef* DMAy_Channelx, uint32_t DMA_IT, FunctionalState NewState) {
+}
+
+void DMA_ClearITPendingBit(uint32_t DMAy_IT) {
+}
+
+void DMA_SetCurrDataCounter(DMA_Channel_TypeDef* DMAy_Channelx, uint16_t DataNumber) {
+   DMAy_Channelx->CNDTR = DataNumber;
+}
+
+/**
+ * The USART transmission is copied when it's started and takes the time of its bytes. Disabling the channel aborts it
+ */
+void DMA_Cmd(DMA_Channel_TypeDef* DMAy_Channelx, FunctionalState NewState) {
+   SimulatedDevice *device = selected_device_g;
+
+   if (DMAy_Channelx != DMA1_Channel2) {
+      return;
+   }
+   if (NewState == DISABLE) {
+      device->transmission_in_progress = 0;
+      return;
+   }
+
+   unsigned short length = DMAy_Channelx->CNDTR;
+
+   if (!length || length > SIMULATED_INPUT_SIZE) {
+      return;
+   }
+   memcpy(device->transmitted, (char *) (uintptr_t) DMAy_Channelx->CMAR, length);
+   device->transmitted_length = length;
+   device->transmission_in_progress = 1;
+   device->transmission_end_tick = simulated_tick_g +
+         (length * SIMULATED_BAUD_RATE_PER_BYTE_TICK + device->usart_baud_rate - 1) / device->usart_baud_rate;
+   DMAy_Channelx->CNDTR = 0;
+}
+
+void TIM_TimeBaseInit(TIM_TypeDef* TIMx, TIM_TimeBaseInitTypeDef* TIM_TimeBaseInitStruct) {
+}
+
+void TIM_Cmd(TIM_TypeDef* TIMx, FunctionalState NewState) {
+}
+
+void TIM_ITConfig(TIM_TypeDef* TIMx, uint16_t TIM_IT, FunctionalState NewState) {
+}
+
+void TIM_ClearITPendingBit(TIM_TypeDef* TIMx, uint16_t TIM_IT) {
+}
+
+void TIM_SetCounter(TIM_TypeDef* TIMx, uint32_t Counter) {
+}
+
+void TIM_SelectOutputTrigger(TIM_TypeDef* TIMx, uint16_t TIM_TRGOSource) {
+}
+
+void ADC_Init(ADC_TypeDef* ADCx, ADC_InitTypeDef* ADC_InitStruct) {
+}
+
+void ADC_ClockModeConfig(ADC_TypeDef* ADCx, uint32_t ADC_ClockMode) {
+}
+
+void ADC_Cmd(ADC_TypeDef* ADCx, FunctionalState NewState) {
+}
+
+void ADC_TempSensorCmd(FunctionalState NewState) {
+}
+
+void ADC_VrefintCmd(FunctionalState NewState) {
+}
+
+void ADC_ChannelConfig(ADC_TypeDef* ADCx, uint32_t ADC_Channel, uint32_t ADC_SampleTime) {
+}
+
+uint32_t ADC_GetCalibrationFactor(ADC_TypeDef* ADCx) {
+   return 0;
+}
+
+void ADC_StartOfConversion(ADC_TypeDef* ADCx) {
+   selected_device_g->adc_started = 1;
+}
+
+void ADC_DMACmd(ADC_TypeDef* ADCx, FunctionalState NewState) {
+}
+
+void ADC_DMARequestModeConfig(ADC_TypeDef* ADCx, uint32_t ADC_DMARequestMode) {
+}
+
+FlagStatus ADC_GetFlagStatus(ADC_TypeDef* ADCx, uint32_t ADC_FLAG) {
+   return ADC_FLAG == ADC_FLAG_ADRDY ? SET : RESET;
+}
+
+/**
+ * The TIMER1 trigger converts the temperature sensor and VREFINT of the simulated supply voltage and temperature. The DMA moves the
+ * pair into the next place of the circular buffer
+ */
+void convert_health_channels(SimulatedDevice *device) {
+   DMA_Channel_TypeDef *channel = &device->peripherals.dma1_channel1;
+
+   if (!device->adc_started || !channel->CNDTR) {
+      return;
+   }
+
+   unsigned short *samples = (unsigned short *) (uintptr_t) channel->CMAR;
+   unsigned short place = device->adc_conversions * 2 % channel->CNDTR;
+   // At the calibration supply, then scaled to the simulated one
+   int temperature_sensor = SIMULATED_TEMPERATURE_SENSOR_CAL_30C -
+         (SIMULATED_DIE_TEMPERATURE_C - 30) * TEMPERATURE_SENSOR_AVERAGE_SLOPE / 1000;
+
+   samples[place] = (unsigned short) (temperature_sensor * CALIBRATION_VDDA_MV / SIMULATED_SUPPLY_VOLTAGE_MV);
+   samples[place + 1] = (unsigned short) (SIMULATED_VREFINT_CAL * CALIBRATION_VDDA_MV / SIMULATED_SUPPLY_VOLTAGE_MV);
+   device->adc_conversions++;
+}
@@ -0,0 +1,206 @@
+/**
+ * Host simulator of the firmware. The firmware runs against the simulated peripherals and a scripted ESP8266 with the server
+ * behind it.
+ *
+ * The time is simulated: every millisecond is 8 ticks of 125us. Every tick the ESP8266 bytes are delivered with the current baud
+ * rate into the USART ISR, the idle timer ISR is called when no byte has come, and the main loop turn is run. SysTick and TIMER14
+ * interrupts come every 1ms and 100ms. The firmware runs on its own stack, its main loop turn ends when it reloads the watchdog.
+ * The millisecond, when nothing is sent or received, is run as one tick, so a day of the long polling takes seconds. A fault of
+ * ESP8266, of the network or of the server can be injected for a while.
+ *
+ * Several devices can be run by the same firmware: "device_g" is switched to the context of the selected device. A device reset
+ * starts its main() again with the cleared context. The flash page of the verified configuration, a linker script symbol,
+ * is switched to the page of the selected device, which survives the resets. So does the .noinit recovery record. The factory
+ * calibration values are mapped at their system memory addresses, the ADC converts the simulated supply voltage and temperature.
+ *
+ * A test includes "simulator.c" only, so it has access to the whole firmware.
+ */
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <setjmp.h>
+#include <ucontext.h>
+
+#define SIMULATED_DEVICES_MAX 4
+#define SIMULATED_REPLIES_SIZE 8
+#define SIMULATED_REPLY_SIZE 2048
+#define SIMULATED_INPUT_SIZE 4096
+#define SIMULATED_REQUESTS_SIZE 32
+#define SIMULATED_FIRMWARE_STACK_SIZE 65536
+#define SIMULATED_TICKS_PER_MS 8
+#define SIMULATED_FLASH_PAGE_SIZE 1024
+// Bytes sent by both sides during a tick are "baud_rate / SIMULATED_BAUD_RATE_PER_BYTE_TICK". A byte is 10 bits
+#define SIMULATED_BAUD_RATE_PER_BYTE_TICK (10 * 1000 * SIMULATED_TICKS_PER_MS)
+#define SIMULATED_ESP8266_START_MS 300
+#define SIMULATED_DEFAULT_SERVER_HOLD_MS 5000
+// Every this byte from ESP8266 is lost while DROPPED_BYTES_SIMULATED_FAULT is active
+#define SIMULATED_DROPPED_BYTE_PERIOD 8
+#define SIMULATED_GARBAGE_PERIOD_MS 700
+// Longer than the 2 s timeout of the most commands, which is measured in whole seconds
+#define SIMULATED_DELAYED_OK_MS 5000
+#define SIMULATED_CLOSED_MID_REQUEST_MS 1000
+// Measured by the ADC on every TIMER1 trigger
+#define SIMULATED_SUPPLY_VOLTAGE_MV 3000
+#define SIMULATED_DIE_TEMPERATURE_C 25
+
+typedef enum {
+   NO_SIMULATED_FAULT,
+   // ESP8266 doesn't send anything
+   SILENT_ESP8266_SIMULATED_FAULT,
+   // ESP8266 answers "busy p..." to every command
+   BUSY_ESP8266_SIMULATED_FAULT,
+   // The access point is gone, it can't be joined
+   ACCESS_POINT_LOST_SIMULATED_FAULT,
+   // The server doesn't accept connections and doesn't answer pings
+   SERVER_DOWN_SIMULATED_FAULT,
+   // The server answers "503 Service Unavailable" right away
+   SERVER_UNAVAILABLE_SIMULATED_FAULT,
+   // Every SIMULATED_DROPPED_BYTE_PERIOD byte from ESP8266 is lost
+   DROPPED_BYTES_SIMULATED_FAULT,
+   // Noise lines come from ESP8266 every SIMULATED_GARBAGE_PERIOD_MS
+   GARBAGE_SIMULATED_FAULT,
+   // ESP8266 answers the commands SIMULATED_DELAYED_OK_MS later
+   DELAYED_OK_SIMULATED_FAULT,
+   // The server closes the link SIMULATED_CLOSED_MID_REQUEST_MS after the request without a response
+   CONNECTION_CLOSED_MID_REQUEST_SIMULATED_FAULT,
+   SIMULATED_FAULTS_SIZE
+} SimulatedFault;
+
+typedef struct {
+   unsigned int due_ms;
+   // The ESP8266 switches to this baud rate after the reply has been sent. 0 - no change
+   unsigned int next_baud_rate;
+   // ESP8266 restarts with the default baud rate after the reply has been sent
+   unsigned char restart;
+   unsigned short length;
+   unsigned short sent_bytes;
+   char data[SIMULATED_REPLY_SIZE];
+} SimulatedReply;
+
+/**
+ * Request received by the server
+ */
+typedef struct {
+   unsigned int received_ms;
+   // CIPSEND length and the bytes really received after the prompt
+   unsigned short announced_length;
+   unsigned short received_length;
+   // Content-Length header and the real length of the body
+   unsigned short content_length;
+   unsigned short body_length;
+   unsigned char has_debug_info;
+   unsigned char has_local_control;
+   unsigned short status_sequence;
+} SimulatedRequest;
+
+typedef struct {
+   unsigned char powered;
+   unsigned char started;
+   unsigned int power_on_ms;
+   unsigned int baud_rate;
+   unsigned char joined;
+   unsigned char server_link_open;
+   // AT+CIPMUX=1: the link ID of the server connection prefixes its notifications, "4,CONNECT" and "+IPD,4,<length>:"
+   unsigned char multiple_connections;
+   char server_link_prefix[3];
+   // AT+CIPSERVER=1,<port> has been accepted
+   unsigned char local_server_started;
+   // Bytes from the MCU. The CIPSEND payload is collected after the prompt until "payload_length" bytes are received
+   char input[SIMULATED_INPUT_SIZE];
+   unsigned short input_length;
+   unsigned short payload_length;
+   unsigned char payload_expected;
+   SimulatedReply replies[SIMULATED_REPLIES_SIZE];
+   unsigned char replies_amount;
+   unsigned int byte_credit;
+   // Added to the delay of the replies to the command being handled
+   unsigned int reply_delay_ms;
+   // The server holds the request and responds at this time
+   unsigned char request_held;
+   unsigned int response_due_ms;
+} SimulatedEsp8266;
+
+typedef struct {
+   DeviceContext context;
+   HostPeripherals peripherals;
+   SimulatedEsp8266 esp8266;
+
+   // The firmware main() runs on its own stack and is switched to every tick
+   char firmware_stack[SIMULATED_FIRMWARE_STACK_SIZE];
+   ucontext_t firmware_start_context;
+   jmp_buf firmware_jump;
+   unsigned int resets;
+
+   SimulatedFault fault;
+   unsigned int fault_end_ms;
+   // Listed by AT+CWLAP besides the default access point and the neighbour
+   unsigned char additional_neighbour_networks;
+   // The line garbles the bytes of this baud rate and above both ways, ESP8266 still switches to it. 0 - any baud rate gets through
+   unsigned int garbling_baud_rate;
+   // A byte from ESP8266 with an escalated baud rate is garbled once per this period. 0 - never
+   unsigned int line_error_period_ms;
+   unsigned int next_line_error_ms;
+
+   // Kept over the resets
+   unsigned char flash_page[SIMULATED_FLASH_PAGE_SIZE];
+   unsigned int flash_erases;
+   // Erases while ESP8266 was answering or the server held the request. The USART bytes are lost while the CPU is stalled
+   unsigned int busy_link_flash_erases;
+   RecoveryRecord recovery_record;
+   // RCC_CSR reset flags, 1 << (RCC_FLAG_* & 0x1F)
+   unsigned int reset_flags;
+
+   unsigned char pll_enabled;
+   // The ADC waits for the TIMER1 triggers
+   unsigned char adc_started;
+   unsigned int adc_conversions;
+   unsigned int usart_baud_rate;
+   // USART_FLAG_* of the received byte
+   unsigned int usart_flags;
+   char received_byte;
+   // The DMA transmission is handed over to ESP8266 when its last byte has been sent
+   char transmitted[SIMULATED_INPUT_SIZE];
+   unsigned short transmitted_length;
+   unsigned char transmission_in_progress;
+   unsigned int transmission_end_tick;
+
+   // Heap accounting of the device including the allocator overhead
+   unsigned int heap_bytes;
+   unsigned int heap_peak_bytes;
+   unsigned int heap_budget_bytes;
+   unsigned int failed_allocations;
+   struct HostAllocation *allocations;
+
+   // The server side
+   unsigned int server_hold_ms;
+   unsigned char turn_on;
+   unsigned char include_debug_info;
+   SimulatedRequest requests[SIMULATED_REQUESTS_SIZE];
+   unsigned short requests_amount;
+   unsigned short responses_sent;
+   // Completed polls: requests sent after the "200 OK" response of the previous one
+   unsigned int polls;
+   unsigned char last_response_ok;
+   // Body of the last request with the debug info
+   char debug_info_body[SIMULATED_INPUT_SIZE];
+} SimulatedDevice;
+
+void sim_init(unsigned char devices_amount);
+void sim_select(unsigned char device_index);
+SimulatedDevice *sim_device(unsigned char device_index);
+void sim_run_ms(unsigned int milliseconds);
+unsigned char sim_run_until_polls(unsigned char device_index, unsigned int polls, unsigned int max_ms);
+void sim_inject_fault(unsigned char device_index, SimulatedFault fault, unsigned int duration_ms);
+void sim_send_local_command(unsigned char device_index, char link_id, char *command);
+unsigned int sim_time_ms();
+unsigned char sim_relay_is_on(unsigned char device_index);
+void sim_reset(unsigned char device_index);
+
+extern unsigned int sim_failed_checks_g;
+
+#define CHECK(condition) sim_check((condition), #condition, __FILE__, __LINE__)
+
+void sim_check(int passed, const char *condition, const char *file, int line);
+int sim_report(const char *test_name);
+
+#endif
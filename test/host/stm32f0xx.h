@@ -0,0 +1,57 @@
+/**
+ * Host build of the device header. The Cortex-M0 functions with assembler are replaced with the simulator ones and the registers
+ * the firmware accesses directly are taken from the simulated device. The rest of the peripherals are only passed to the Standard
+ * Peripheral Library functions, which are implemented by the simulator
+ */
+#ifndef HOST_STM32F0XX_H
+#define HOST_STM32F0XX_H
+
+#define NVIC_SystemReset core_NVIC_SystemReset
+#define NVIC_EnableIRQ core_NVIC_EnableIRQ
+#define NVIC_SetPriority core_NVIC_SetPriority
+#define SysTick_Config core_SysTick_Config
+#define __get_MSP core___get_MSP
+
+#include_next "stm32f0xx.h"
+
+#undef NVIC_SystemReset
+#undef NVIC_EnableIRQ
+#undef NVIC_SetPriority
+#undef SysTick_Config
+#undef __get_MSP
+
+void NVIC_SystemReset(void);
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t SysTick_Config(uint32_t ticks);
+uint32_t __get_MSP(void);
+
+typedef struct {
+   DMA_Channel_TypeDef dma1_channel1;
+   DMA_Channel_TypeDef dma1_channel2;
+   GPIO_TypeDef gpioa;
+   USART_TypeDef usart1;
+   FLASH_TypeDef flash;
+   SysTick_Type systick;
+} HostPeripherals;
+
+extern HostPeripherals *host_peripherals_g;
+FLASH_TypeDef *get_host_flash();
+GPIO_TypeDef *get_host_gpioa();
+
+#undef DMA1_Channel1
+#undef DMA1_Channel2
+#undef GPIOA
+#undef USART1
+#undef FLASH
+#undef SysTick
+
+#define DMA1_Channel1 (&host_peripherals_g->dma1_channel1)
+#define DMA1_Channel2 (&host_peripherals_g->dma1_channel2)
+// The register writes with side effects take effect on the next access
+#define GPIOA (get_host_gpioa())
+#define USART1 (&host_peripherals_g->usart1)
+#define FLASH (get_host_flash())
+#define SysTick (&host_peripherals_g->systick)
+
+#endif
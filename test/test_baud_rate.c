@@ -0,0 +1,83 @@
+/**
+ * ESP8266 is switched to an escalated baud rate by AT+UART_CUR after the start. A baud rate the line can't carry fails the probe,
+ * ESP8266 is power cycled and the next slower baud rate is tried. Rare line errors are tolerated, a burst of them brings the default
+ * baud rate back
+ */
+#include "simulator.c"
+
+#define START_MAX_MS 20000
+// The failed probes and the power cycle of ESP8266 are included
+#define FALL_BACK_MAX_MS 60000
+#define POLL_MAX_MS (SIMULATED_DEFAULT_SERVER_HOLD_MS + 5000)
+// Fewer errors than USART_ESCALATED_BAUD_RATE_MAX_ERRORS in a window, but many more of them in the run
+#define RARE_LINE_ERROR_PERIOD_MS 20000
+#define RARE_LINE_ERRORS_RUN_MS 600000
+#define LINE_ERROR_BURST_PERIOD_MS 200
+
+void check_escalation() {
+   sim_init(1);
+   SimulatedDevice *device = sim_device(0);
+
+   CHECK(sim_run_until_polls(0, 2, START_MAX_MS));
+   CHECK(device->usart_baud_rate == USART_ESCALATED_BAUD_RATES[0]);
+   CHECK(device->esp8266.baud_rate == USART_ESCALATED_BAUD_RATES[0]);
+   CHECK(device->context.usart_framing_errors_counter == 0);
+}
+
+/**
+ * ESP8266 accepts AT+UART_CUR, but the line garbles "garbling_baud_rate" and above
+ */
+void check_probe_failure(unsigned int garbling_baud_rate, unsigned int expected_baud_rate) {
+   sim_init(1);
+   SimulatedDevice *device = sim_device(0);
+
+   device->garbling_baud_rate = garbling_baud_rate;
+   CHECK(sim_run_until_polls(0, 2, START_MAX_MS + FALL_BACK_MAX_MS * USART_ESCALATED_BAUD_RATES_SIZE));
+   CHECK(device->usart_baud_rate == expected_baud_rate);
+   CHECK(device->esp8266.baud_rate == expected_baud_rate);
+
+   // The failed baud rates aren't tried again
+   unsigned short polls = device->context.polls_completed_counter;
+
+   CHECK(sim_run_until_polls(0, device->polls + 3, POLL_MAX_MS * 3));
+   CHECK(device->usart_baud_rate == expected_baud_rate);
+   CHECK(device->context.polls_completed_counter >= polls + 3);
+   CHECK(device->resets == 0);
+   CHECK(device->failed_allocations == 0);
+   printf("Line garbling %u baud: %u baud after %u ms\n", garbling_baud_rate, expected_baud_rate, sim_time_ms());
+}
+
+/**
+ * The errors are counted per window, so the rare ones of a long uptime don't add up to the fall back. A burst of them does
+ */
+void check_line_errors() {
+   sim_init(1);
+   SimulatedDevice *device = sim_device(0);
+
+   CHECK(sim_run_until_polls(0, 2, START_MAX_MS));
+   device->line_error_period_ms = RARE_LINE_ERROR_PERIOD_MS;
+   device->next_line_error_ms = sim_time_ms() + RARE_LINE_ERROR_PERIOD_MS;
+   sim_run_ms(RARE_LINE_ERRORS_RUN_MS);
+   unsigned short rare_errors = get_usart_baud_rate_errors();
+
+   CHECK(rare_errors >= USART_ESCALATED_BAUD_RATE_MAX_ERRORS * 2);
+   CHECK(device->usart_baud_rate == USART_ESCALATED_BAUD_RATES[0]);
+
+   // The burst goes on with the slower escalated baud rate too. The default one has no line errors
+   device->line_error_period_ms = LINE_ERROR_BURST_PERIOD_MS;
+   sim_run_ms(FALL_BACK_MAX_MS * USART_ESCALATED_BAUD_RATES_SIZE);
+   CHECK(device->usart_baud_rate == USART_BAUD_RATE);
+   CHECK(device->context.usart_escalated_baud_rate_index == USART_ESCALATED_BAUD_RATES_SIZE);
+   CHECK(sim_run_until_polls(0, device->polls + 2, POLL_MAX_MS * 2));
+   CHECK(device->resets == 0);
+   printf("Line errors: %u rare ones tolerated in %u s, the burst fell back to %u baud\n", rare_errors,
+         RARE_LINE_ERRORS_RUN_MS / 1000, device->usart_baud_rate);
+}
+
+int main() {
+   check_escalation();
+   check_probe_failure(USART_ESCALATED_BAUD_RATES[0], USART_ESCALATED_BAUD_RATES[1]);
+   check_probe_failure(USART_ESCALATED_BAUD_RATES[1], USART_BAUD_RATE);
+   check_line_errors();
+   return sim_report("test_baud_rate");
+}
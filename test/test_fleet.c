@@ -0,0 +1,122 @@
+/**
+ * Several devices run by the same firmware through "device_g". Every device has to keep its own relay, heap and counters, so a
+ * fault or a reset of one device doesn't touch the others
+ */
+#include "simulator.c"
+
+#define FLEET_SIZE SIMULATED_DEVICES_MAX
+#define POLL_MAX_MS (SIMULATED_DEFAULT_SERVER_HOLD_MS + 5000)
+#define FAULT_MS 20000
+#define RECOVERY_AFTER_FAULT_MAX_MS 20000
+// The reset device starts ESP8266 again, joins the network and connects to the server
+#define START_MAX_MS 20000
+
+unsigned short polls_g[FLEET_SIZE];
+
+/**
+ * @return 0 if any device hasn't completed one more poll in time
+ */
+unsigned char run_until_every_device_polls(unsigned int max_ms) {
+   for (unsigned char i = 0; i < FLEET_SIZE; i++) {
+      polls_g[i] = sim_device(i)->context.polls_completed_counter;
+   }
+   for (unsigned int ms = 0; ms < max_ms; ms++) {
+      unsigned char all_polled = 1;
+
+      for (unsigned char i = 0; i < FLEET_SIZE; i++) {
+         if (sim_device(i)->context.polls_completed_counter == polls_g[i]) {
+            all_polled = 0;
+         }
+      }
+      if (all_polled) {
+         return 1;
+      }
+      sim_run_ms(1);
+   }
+   return 0;
+}
+
+int main() {
+   sim_init(FLEET_SIZE);
+
+   CHECK(run_until_every_device_polls(START_MAX_MS));
+   for (unsigned char i = 0; i < FLEET_SIZE; i++) {
+      SimulatedDevice *device = sim_device(i);
+
+      CHECK(device_g == &device->context);
+      CHECK(!sim_relay_is_on(i));
+      // The verified configuration is saved once after the first start
+      CHECK(!device->context.warm_boot);
+      CHECK(device->flash_erases == 1);
+      // Between the polls, when nothing comes from ESP8266
+      CHECK(device->busy_link_flash_erases == 0);
+      // The random record of the power on is dropped
+      CHECK(device->context.reset_cause == POWER_ON_RESET_CAUSE);
+      CHECK(recovery_record_g.warm_resets == 0);
+   }
+
+   // Odd devices are switched on
+   for (unsigned char i = 1; i < FLEET_SIZE; i += 2) {
+      sim_device(i)->turn_on = 1;
+   }
+   CHECK(run_until_every_device_polls(POLL_MAX_MS));
+   CHECK(run_until_every_device_polls(POLL_MAX_MS));
+   for (unsigned char i = 0; i < FLEET_SIZE; i++) {
+      CHECK(sim_relay_is_on(i) == (i % 2));
+   }
+
+   // The reset device starts from the cleared context, its relay is switched on again from the .noinit record before the server
+   // answers. The verified configuration has been kept in its flash
+   sim_reset(1);
+   CHECK(sim_relay_is_on(1));
+   CHECK(sim_device(1)->context.reset_cause == SOFTWARE_RESET_CAUSE);
+   CHECK(recovery_record_g.warm_resets == 1);
+   CHECK(sim_device(1)->context.polls_completed_counter == 0);
+   CHECK(sim_device(1)->context.warm_boot);
+   CHECK(is_verified_configuration_valid());
+   for (unsigned char i = 0; i < FLEET_SIZE; i++) {
+      SimulatedDevice *device = sim_device(i);
+
+      CHECK(device->resets == (i == 1));
+      CHECK(i == 1 || sim_relay_is_on(i) == (i % 2));
+      CHECK(i == 1 || device->context.polls_completed_counter > 0);
+   }
+   CHECK(run_until_every_device_polls(START_MAX_MS));
+   CHECK(sim_relay_is_on(1));
+   CHECK(sim_device(1)->flash_erases == 1);
+
+   // The others keep polling while the server of one device is down
+   sim_inject_fault(2, SERVER_DOWN_SIMULATED_FAULT, FAULT_MS);
+   unsigned short faulty_device_polls = sim_device(2)->context.polls_completed_counter;
+   unsigned short polls[FLEET_SIZE];
+
+   for (unsigned char i = 0; i < FLEET_SIZE; i++) {
+      polls[i] = sim_device(i)->context.polls_completed_counter;
+   }
+   sim_run_ms(FAULT_MS);
+   for (unsigned char i = 0; i < FLEET_SIZE; i++) {
+      unsigned short completed_polls = sim_device(i)->context.polls_completed_counter - polls[i];
+
+      CHECK(i == 2 ? completed_polls == 0 : completed_polls >= FAULT_MS / POLL_MAX_MS);
+   }
+   for (unsigned int ms = 0; ms < RECOVERY_AFTER_FAULT_MAX_MS && sim_device(2)->context.polls_completed_counter == faulty_device_polls;
+         ms++) {
+      sim_run_ms(1);
+   }
+   CHECK(sim_device(2)->context.polls_completed_counter != faulty_device_polls);
+   CHECK(run_until_every_device_polls(POLL_MAX_MS));
+
+   for (unsigned char i = 0; i < FLEET_SIZE; i++) {
+      SimulatedDevice *device = sim_device(i);
+
+      CHECK(sim_relay_is_on(i) == (i % 2));
+      CHECK(device->failed_allocations == 0);
+      CHECK(device->heap_peak_bytes <= device->heap_budget_bytes);
+      for (unsigned short request = 0; request < device->requests_amount && request < SIMULATED_REQUESTS_SIZE; request++) {
+         CHECK(device->requests[request].announced_length == device->requests[request].received_length);
+      }
+      printf("Device %u: %u polls, %u resets, the largest heap: %u bytes\n", i, device->context.polls_completed_counter,
+            device->resets, device->heap_peak_bytes);
+   }
+   return sim_report("test_fleet");
+}
@@ -0,0 +1,166 @@
+/**
+ * The firmware built with the local control listens to the LAN clients besides the long polling. A command with the right tag and
+ * a growing sequence switches the relay at once, the others are rejected. The command holds until a poll has told the server
+ * about it, then the server's "turnOn" is followed again. The accepted sequence is kept in the flash, so a command isn't replayed
+ * after a reset
+ */
+#define LOCAL_CONTROL_KEY "0123456789abcdef"
+#define LOCAL_CONTROL_PORT "8888"
+#include "simulator.c"
+
+#define POLL_MAX_MS (SIMULATED_DEFAULT_SERVER_HOLD_MS + 5000)
+// The command frame comes in one reply, it's handled by the next main loop turns
+#define COMMAND_MAX_MS 50
+
+#define SIPHASH_ROUND(v) \
+   v[0] += v[1]; v[1] = ROTATE_LEFT_64(v[1], 13); v[1] ^= v[0]; v[0] = ROTATE_LEFT_64(v[0], 32); \
+   v[2] += v[3]; v[3] = ROTATE_LEFT_64(v[3], 16); v[3] ^= v[2]; \
+   v[0] += v[3]; v[3] = ROTATE_LEFT_64(v[3], 21); v[3] ^= v[0]; \
+   v[2] += v[1]; v[1] = ROTATE_LEFT_64(v[1], 17); v[1] ^= v[2]; v[2] = ROTATE_LEFT_64(v[2], 32);
+
+/**
+ * SipHash-2-4 of the client, independent of the firmware one
+ */
+uint64_t siphash(const unsigned char *key, const unsigned char *data, size_t length) {
+   uint64_t key_0 = 0;
+   uint64_t key_1 = 0;
+
+   for (unsigned char i = 0; i < 8; i++) {
+      key_0 |= (uint64_t) key[i] << (8 * i);
+      key_1 |= (uint64_t) key[i + 8] << (8 * i);
+   }
+   uint64_t v[] = {key_0 ^ 0x736f6d6570736575ULL, key_1 ^ 0x646f72616e646f6dULL, key_0 ^ 0x6c7967656e657261ULL,
+         key_1 ^ 0x7465646279746573ULL};
+   unsigned char last_block[8] = {0};
+
+   for (size_t block = 0; block < length / 8 + 1; block++) {
+      uint64_t message_word = 0;
+
+      if (block == length / 8) {
+         memcpy(last_block, data + block * 8, length % 8);
+         last_block[7] = (unsigned char) length;
+      }
+      for (unsigned char i = 0; i < 8; i++) {
+         message_word |= (uint64_t) (block == length / 8 ? last_block[i] : data[block * 8 + i]) << (8 * i);
+      }
+      v[3] ^= message_word;
+      SIPHASH_ROUND(v);
+      SIPHASH_ROUND(v);
+      v[0] ^= message_word;
+   }
+   v[2] ^= 0xFF;
+   for (unsigned char i = 0; i < 4; i++) {
+      SIPHASH_ROUND(v);
+   }
+   return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+/**
+ * "<sequence>:<1|0>:<tag>" from the LAN client on the link 0
+ */
+void send_local_command(unsigned int sequence, unsigned char turn_on, char *key) {
+   char signed_part[24];
+   char command[48];
+
+   snprintf(signed_part, sizeof(signed_part), "%u:%u", sequence, turn_on);
+   uint64_t tag = siphash((unsigned char *) key, (unsigned char *) signed_part, strlen(signed_part));
+   snprintf(command, sizeof(command), "%s:%016llx", signed_part, (unsigned long long) tag);
+
+   sim_send_local_command(0, '0', command);
+   sim_run_ms(COMMAND_MAX_MS);
+}
+
+/**
+ * @return 1 if any request since "first_request" has reported the local control
+ */
+unsigned char is_local_control_reported(SimulatedDevice *device, unsigned short first_request) {
+   for (unsigned short request = first_request; request < device->requests_amount; request++) {
+      if (device->requests[request % SIMULATED_REQUESTS_SIZE].has_local_control) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+int main() {
+   // The test vector of the SipHash paper: the key and the message are 00 01 02 ...
+   unsigned char vector_bytes[16];
+
+   for (unsigned char i = 0; i < 16; i++) {
+      vector_bytes[i] = i;
+   }
+   CHECK(siphash(vector_bytes, vector_bytes, 15) == 0xa129ca6149be45e5ULL);
+   // The same tag as the firmware computes
+   CHECK(siphash((unsigned char *) LOCAL_CONTROL_KEY, (unsigned char *) "7:1", 3) == get_local_control_tag("7:1", 3));
+
+   sim_init(1);
+   SimulatedDevice *device = sim_device(0);
+
+   // The server is connected by the last link ID, the lower ones are left for the LAN clients
+   CHECK(sim_run_until_polls(0, 2, 20000));
+   CHECK(device->esp8266.local_server_started);
+   CHECK(!strcmp(device->esp8266.server_link_prefix, SERVER_LINK_ID ","));
+   CHECK(!sim_relay_is_on(0));
+
+   unsigned short requests = device->requests_amount;
+
+   send_local_command(1, 1, LOCAL_CONTROL_KEY);
+   CHECK(sim_relay_is_on(0));
+   CHECK(device->context.local_control_commands_counter == 1);
+   unsigned int command_relay_time_us = device->context.relay_actuation_time_us;
+
+   // A wrong tag, a replayed sequence and a garbled command
+   send_local_command(2, 0, "fedcba9876543210");
+   send_local_command(1, 0, LOCAL_CONTROL_KEY);
+   sim_send_local_command(0, '0', "2:x:0");
+   sim_run_ms(COMMAND_MAX_MS);
+   CHECK(sim_relay_is_on(0));
+   CHECK(device->context.rejected_local_control_commands_counter == 3);
+
+   // The server still says "turnOn":false, the command holds until it has been reported
+   CHECK(sim_run_until_polls(0, device->polls + 1, POLL_MAX_MS));
+   CHECK(is_local_control_reported(device, requests));
+   CHECK(sim_run_until_polls(0, device->polls + 2, POLL_MAX_MS * 2));
+   CHECK(!sim_relay_is_on(0));
+
+   // The long polling hasn't been disturbed by the LAN clients
+   CHECK(device->context.polls_completed_counter >= 5);
+   CHECK(device->resets == 0);
+   CHECK(device->failed_allocations == 0);
+   CHECK(device->heap_peak_bytes <= device->heap_budget_bytes);
+   unsigned short accepted_commands = device->context.local_control_commands_counter;
+   unsigned short rejected_commands = device->context.rejected_local_control_commands_counter;
+
+   // The accepted sequence has survived the reset, the captured command is still rejected
+   sim_reset(0);
+   CHECK(get_saved_local_control_sequence() == 1);
+   CHECK(sim_run_until_polls(0, device->polls + 1, 20000));
+   send_local_command(1, 1, LOCAL_CONTROL_KEY);
+   CHECK(!sim_relay_is_on(0));
+   CHECK(device->context.rejected_local_control_commands_counter == 1);
+   send_local_command(2, 1, LOCAL_CONTROL_KEY);
+   CHECK(sim_relay_is_on(0));
+   CHECK(get_saved_local_control_sequence() == 2);
+   CHECK(device->flash_erases == 1);
+
+   // The nearly full page isn't erased while the command is handled, but before the next request
+   unsigned int *saved_sequences = VERIFIED_CONFIGURATION->saved_local_control_sequences;
+   unsigned int sequence = 3;
+
+   for (unsigned short i = 2; i < SAVED_LOCAL_CONTROL_SEQUENCES_SIZE - SAVED_LOCAL_CONTROL_SEQUENCES_RESERVE; i++) {
+      saved_sequences[i] = sequence++;
+   }
+   send_local_command(sequence, 0, LOCAL_CONTROL_KEY);
+   CHECK(!sim_relay_is_on(0));
+   CHECK(device->flash_erases == 1);
+   CHECK(sim_run_until_polls(0, device->polls + 1, POLL_MAX_MS));
+   CHECK(device->flash_erases == 2);
+   CHECK(device->busy_link_flash_erases == 0);
+   CHECK(saved_sequences[0] == sequence);
+   CHECK(saved_sequences[1] == 0xFFFFFFFF);
+   CHECK(is_verified_configuration_valid());
+
+   printf("Local commands: %u accepted, %u rejected, the relay switched %u us after the command\n",
+         accepted_commands, rejected_commands, command_relay_time_us);
+   return sim_report("test_local_control");
+}
@@ -0,0 +1,165 @@
+/**
+ * Every simulated fault is injected into the polling device for a while. The device has to poll again soon after the fault has
+ * gone and to record the time to recover in the fault recovery statistics. The times are printed as the benchmark
+ */
+#include "simulator.c"
+
+#define FAULT_MS 20000
+#define RECOVERY_AFTER_FAULT_MAX_MS 20000
+// The ladder reaches the system reset by then
+#define LADDER_FAULT_MS 180000
+// The fault is noticed by the timeout of the held request or of the connection at the latest
+#define DETECTION_MAX_MS (SIMULATED_DEFAULT_SERVER_HOLD_MS + 10000)
+// The response to the held request is lost, it's given up by the long polling timeout
+#define LONG_POLLING_DETECTION_MAX_MS (330000 + SIMULATED_DEFAULT_SERVER_HOLD_MS)
+// The polls keep their rate while a tolerated fault is active
+#define TOLERATED_FAULT_POLL_OVERHEAD_MS 3000
+
+typedef struct {
+   SimulatedFault fault;
+   char *name;
+   // Not a single poll gets through while the fault is active. The others spoil a part of the polls only
+   unsigned char polls_stopped;
+   // From the fault start to the first fault recorded by the device
+   unsigned int detection_max_ms;
+   // The device may ride the fault out: the polls go on while it's active and no fault is recorded
+   unsigned char may_be_tolerated;
+} RecoveryCase;
+
+RecoveryCase RECOVERY_CASES[] = {
+   {SILENT_ESP8266_SIMULATED_FAULT, "silent ESP8266", 1, LONG_POLLING_DETECTION_MAX_MS, 0},
+   {BUSY_ESP8266_SIMULATED_FAULT, "busy ESP8266", 1, DETECTION_MAX_MS, 0},
+   {ACCESS_POINT_LOST_SIMULATED_FAULT, "access point lost", 1, DETECTION_MAX_MS, 0},
+   {SERVER_DOWN_SIMULATED_FAULT, "server down", 1, DETECTION_MAX_MS, 0},
+   {SERVER_UNAVAILABLE_SIMULATED_FAULT, "server unavailable", 1, DETECTION_MAX_MS, 0},
+   {DROPPED_BYTES_SIMULATED_FAULT, "dropped bytes", 0, DETECTION_MAX_MS, 0},
+   // Noise between the commands is dropped while the long polling request is held in the background
+   {GARBAGE_SIMULATED_FAULT, "garbage", 0, DETECTION_MAX_MS, 1},
+   {DELAYED_OK_SIMULATED_FAULT, "delayed OK", 1, DETECTION_MAX_MS, 0},
+   {CONNECTION_CLOSED_MID_REQUEST_SIMULATED_FAULT, "closed mid-request", 1, DETECTION_MAX_MS, 0}
+};
+
+void check_recovery(RecoveryCase *recovery_case) {
+   sim_init(1);
+   SimulatedDevice *device = sim_device(0);
+
+   CHECK(sim_run_until_polls(0, 2, 20000));
+   unsigned int fault_start_ms = sim_time_ms();
+   // The server counts the poll by the next request, the device counts it by the response
+   unsigned short polls = device->context.polls_completed_counter;
+
+   sim_inject_fault(0, recovery_case->fault, FAULT_MS);
+   unsigned char no_wifi_link_status = 0;
+
+   for (unsigned int ms = 0; ms < FAULT_MS; ms++) {
+      sim_run_ms(1);
+      no_wifi_link_status |= device->context.link_status == NO_WIFI_LINK_STATUS;
+   }
+   unsigned short polls_during_fault = device->context.polls_completed_counter - polls;
+
+   if (recovery_case->polls_stopped) {
+      // The request held by the server may be answered
+      CHECK(polls_during_fault <= 1);
+   }
+   polls = device->context.polls_completed_counter;
+   // The fault can't be noticed before its end, when the held request hasn't timed out by then
+   unsigned int recovery_end_ms = fault_start_ms + (recovery_case->detection_max_ms > FAULT_MS ? recovery_case->detection_max_ms : FAULT_MS) +
+         RECOVERY_AFTER_FAULT_MAX_MS;
+
+   while (device->context.polls_completed_counter == polls && sim_time_ms() < recovery_end_ms) {
+      sim_run_ms(1);
+   }
+   CHECK(device->context.polls_completed_counter != polls);
+
+   unsigned int recovery_ms = sim_time_ms() - fault_start_ms;
+   unsigned int faults = 0;
+   FaultRecoveryStatistics *recorded_recovery = NULL;
+
+   for (unsigned char fault_class = 0; fault_class < FAULT_CLASSES_SIZE; fault_class++) {
+      FaultRecoveryStatistics *fault_recovery = &device->context.fault_recoveries[fault_class];
+
+      faults += fault_recovery->faults;
+      if (fault_recovery->recoveries) {
+         CHECK(recorded_recovery == NULL || !recovery_case->polls_stopped);
+         recorded_recovery = fault_recovery;
+      }
+   }
+   if (recovery_case->may_be_tolerated && !faults) {
+      CHECK(polls_during_fault >= FAULT_MS / (device->server_hold_ms + TOLERATED_FAULT_POLL_OVERHEAD_MS));
+   } else {
+      CHECK(faults > 0);
+      CHECK(recorded_recovery != NULL);
+   }
+   if (recorded_recovery != NULL && recovery_case->polls_stopped) {
+      CHECK(recorded_recovery->recoveries == 1);
+      CHECK(recorded_recovery->last_recovery_time_ms <= recovery_ms);
+      CHECK(recorded_recovery->last_recovery_time_ms + recovery_case->detection_max_ms >= recovery_ms);
+   }
+   // A status, which hasn't reached the server, is sent again with the same sequence. One, which ESP8266 has sent without
+   // confirming it, may be received twice
+   unsigned short first_request = device->requests_amount > SIMULATED_REQUESTS_SIZE ? device->requests_amount - SIMULATED_REQUESTS_SIZE : 0;
+
+   for (unsigned short request = first_request + 1; request < device->requests_amount; request++) {
+      unsigned short status_sequence = device->requests[request % SIMULATED_REQUESTS_SIZE].status_sequence;
+      unsigned short previous_status_sequence = device->requests[(request - 1) % SIMULATED_REQUESTS_SIZE].status_sequence;
+
+      CHECK(status_sequence == previous_status_sequence || status_sequence == previous_status_sequence + 1);
+   }
+   if (recovery_case->fault == ACCESS_POINT_LOST_SIMULATED_FAULT) {
+      // AT+CIPSTATUS has reported no Wi-Fi before the connection to the server
+      CHECK(no_wifi_link_status);
+   }
+   CHECK(device->resets == 0);
+   CHECK(device->failed_allocations == 0);
+   CHECK(device->heap_peak_bytes <= device->heap_budget_bytes);
+
+   printf("%-20s recovered %5u ms after the fault, %3u faults, recorded %5u ms\n", recovery_case->name, recovery_ms - FAULT_MS,
+         faults, recorded_recovery != NULL ? recorded_recovery->last_recovery_time_ms : 0);
+}
+
+/**
+ * ESP8266 that stays busy makes the device climb the recovery ladder up to the system reset, taking every step once. The device
+ * polls again after the fault
+ */
+void check_recovery_ladder() {
+   sim_init(1);
+   SimulatedDevice *device = sim_device(0);
+   unsigned short recovery_step_attempts[RECOVERY_STEPS_SIZE] = {0};
+
+   CHECK(sim_run_until_polls(0, 2, 20000));
+   unsigned int fault_start_ms = sim_time_ms();
+
+   sim_inject_fault(0, BUSY_ESP8266_SIMULATED_FAULT, LADDER_FAULT_MS);
+   while (!device->resets && sim_time_ms() - fault_start_ms < LADDER_FAULT_MS) {
+      for (RecoveryStep recovery_step = RESYNC_PARSER_RECOVERY_STEP; recovery_step < RECOVERY_STEPS_SIZE; recovery_step++) {
+         recovery_step_attempts[recovery_step] = device->context.recovery_steps[recovery_step].attempts;
+      }
+      sim_run_ms(1);
+   }
+   unsigned int system_reset_ms = sim_time_ms() - fault_start_ms;
+
+   CHECK(device->resets == 1);
+   // The system reset has cleared the context before its attempt could be seen
+   for (RecoveryStep recovery_step = RESYNC_PARSER_RECOVERY_STEP; recovery_step < SYSTEM_RESET_RECOVERY_STEP; recovery_step++) {
+      CHECK(recovery_step_attempts[recovery_step] == 1);
+   }
+
+   sim_run_ms(LADDER_FAULT_MS - system_reset_ms);
+   unsigned short polls = device->context.polls_completed_counter;
+
+   for (unsigned int ms = 0; ms < RECOVERY_AFTER_FAULT_MAX_MS && device->context.polls_completed_counter == polls; ms++) {
+      sim_run_ms(1);
+   }
+   CHECK(device->context.polls_completed_counter != polls);
+   CHECK(device->failed_allocations == 0);
+
+   printf("%-20s the system reset %u ms after the fault start\n", "recovery ladder", system_reset_ms);
+}
+
+int main() {
+   for (unsigned char i = 0; i < sizeof(RECOVERY_CASES) / sizeof(RecoveryCase); i++) {
+      check_recovery(&RECOVERY_CASES[i]);
+   }
+   check_recovery_ladder();
+   return sim_report("test_recovery");
+}
@@ -0,0 +1,138 @@
+/**
+ * Long polling requests: CIPSEND length, Content-Length and the heap have to match what the server receives. The poll cycle
+ * statistics have to count the commands and bytes the ESP8266 has really got, the traces have to follow the request stages. The
+ * initialization time is printed as the benchmark of the chained commands
+ */
+#include "simulator.c"
+
+// ESP8266 accepts up to 2048 bytes by one CIPSEND
+#define CIPSEND_MAX_LENGTH 2048
+#define POLL_MAX_MS (SIMULATED_DEFAULT_SERVER_HOLD_MS + 5000)
+// AT+CIPSTART, AT+CIPSEND and the request
+#define POLL_CYCLE_MIN_AT_COMMANDS 3
+// From ATE0 to the long polling request. The scripted AT+CWLAP takes 1.5 s of it
+#define INITIALIZATION_MAX_MS 3000
+// The visible network list of about 1 KB is several times longer than a receive buffer
+#define LONG_NETWORK_LIST_NEIGHBOURS 16
+
+void check_requests(SimulatedDevice *device) {
+   for (unsigned short i = 0; i < device->requests_amount && i < SIMULATED_REQUESTS_SIZE; i++) {
+      SimulatedRequest *request = &device->requests[i];
+
+      CHECK(request->announced_length == request->received_length);
+      CHECK(request->announced_length <= CIPSEND_MAX_LENGTH);
+      CHECK(request->content_length == request->body_length);
+      // Every request has got through, no sequence has been skipped
+      CHECK(request->status_sequence == i + 1);
+   }
+}
+
+/**
+ * The previous cycle contains the last request and its response. The simulated CPU takes no time, so the CPU time isn't checked
+ */
+void check_poll_cycle(SimulatedDevice *device) {
+   SimulatedRequest *request = &device->requests[(device->requests_amount - 2) % SIMULATED_REQUESTS_SIZE];
+
+   CHECK(device->context.last_poll_cycle.at_commands >= POLL_CYCLE_MIN_AT_COMMANDS);
+   CHECK(device->context.last_poll_cycle.sent_bytes > request->received_length);
+   CHECK(device->context.last_poll_cycle.received_bytes > strlen("HTTP/1.1 200 OK\r\n"));
+   CHECK(device->context.last_poll_cycle.allocations > 0);
+}
+
+/**
+ * The last request with the parsed response has passed every stage one after another. The server has held it for its hold time
+ *
+ * @return the trace of the request
+ */
+Trace *check_trace(SimulatedDevice *device) {
+   unsigned int response_timestamp_ms = calculate_response_timestamp();
+   Trace *parsed_trace = NULL;
+
+   for (unsigned char i = 0; i < TRACES_SIZE; i++) {
+      Trace *trace = &device->context.traces[i];
+
+      if ((trace->recorded_stages & (1 << RESPONSE_PARSED_STAGE)) &&
+            (parsed_trace == NULL || trace->start_timestamp_ms > parsed_trace->start_timestamp_ms)) {
+         parsed_trace = trace;
+      }
+   }
+   CHECK(parsed_trace != NULL);
+   if (parsed_trace == NULL) {
+      return NULL;
+   }
+   for (TraceStage stage = CIPSTART_SENT_STAGE; stage < RESPONSE_PARSED_STAGE; stage++) {
+      CHECK(parsed_trace->recorded_stages & (1 << stage));
+      CHECK(parsed_trace->stage_offsets_ms[stage] <= parsed_trace->stage_offsets_ms[stage + 1]);
+   }
+   CHECK(response_timestamp_ms == parsed_trace->stage_offsets_ms[RESPONSE_PARSED_STAGE]);
+   CHECK(response_timestamp_ms >= device->server_hold_ms);
+   CHECK(response_timestamp_ms < POLL_MAX_MS);
+   return parsed_trace;
+}
+
+/**
+ * The long visible network list is received in line chunks. The default access point at its end has to be found without the
+ * buffer overflows
+ */
+void check_long_network_list() {
+   sim_init(1);
+   SimulatedDevice *device = sim_device(0);
+
+   device->additional_neighbour_networks = LONG_NETWORK_LIST_NEIGHBOURS;
+   CHECK(sim_run_until_polls(0, 1, 20000));
+   // The RSSI of the default access point only, the neighbours are weaker
+   CHECK(device->context.rssi.samples > 0);
+   CHECK(device->context.rssi.min_dbm >= -62 && device->context.rssi.max_dbm <= -60);
+   CHECK(get_smoothed_rssi() >= -62 && get_smoothed_rssi() <= -60);
+   CHECK(device->context.usart_buffer_overflows_counter == 0);
+   CHECK(device->failed_allocations == 0);
+}
+
+int main() {
+   sim_init(1);
+   SimulatedDevice *device = sim_device(0);
+
+   CHECK(sim_run_until_polls(0, 1, 20000));
+   // The initialization commands are sent right after the previous responses
+   CHECK(device->context.chained_tasks_counter > 0);
+   CHECK(device->context.last_initialization_time_ms > 0 && device->context.last_initialization_time_ms < INITIALIZATION_MAX_MS);
+   CHECK(sim_run_until_polls(0, 2, POLL_MAX_MS));
+   check_poll_cycle(device);
+   check_trace(device);
+
+   // The server asks for the debug info
+   device->include_debug_info = 1;
+   CHECK(sim_run_until_polls(0, device->polls + 2, POLL_MAX_MS * 2));
+   CHECK(strstr(device->debug_info_body, "\"pollCycle\":{") != NULL);
+
+   device->turn_on = 1;
+   CHECK(sim_run_until_polls(0, device->polls + 1, POLL_MAX_MS));
+   CHECK(sim_relay_is_on(0));
+   check_poll_cycle(device);
+   Trace *trace = check_trace(device);
+   CHECK(trace != NULL && (trace->recorded_stages & (1 << RELAY_WRITTEN_STAGE)));
+   // The relay is switched by the response parser
+   CHECK(device->context.relay_actuation_time_us > 0 && device->context.relay_actuation_time_us <= device->context.max_relay_actuation_time_us);
+
+   check_requests(device);
+   // The ADC samples of the supply voltage and the die temperature are averaged every second
+   CHECK(device->context.supply_voltage_mv >= SIMULATED_SUPPLY_VOLTAGE_MV - 5 && device->context.supply_voltage_mv <= SIMULATED_SUPPLY_VOLTAGE_MV + 5);
+   CHECK(device->context.die_temperature_c >= SIMULATED_DIE_TEMPERATURE_C - 1 && device->context.die_temperature_c <= SIMULATED_DIE_TEMPERATURE_C + 1);
+   CHECK(device->context.min_supply_voltage_mv <= device->context.supply_voltage_mv);
+   // The long polling payloads are started by the ">" prompt in the USART ISR
+   CHECK(device->context.payloads_sent_on_prompt_counter > 0);
+   CHECK(device->resets == 0);
+   CHECK(device->failed_allocations == 0);
+   CHECK(device->heap_peak_bytes <= device->heap_budget_bytes);
+   printf("Requests: %u, the largest heap: %u of %u bytes, the last poll cycle: %u commands, %u bytes sent, %u received, "
+         "%u allocations\n", device->requests_amount, device->heap_peak_bytes, device->heap_budget_bytes,
+         device->context.last_poll_cycle.at_commands, device->context.last_poll_cycle.sent_bytes, device->context.last_poll_cycle.received_bytes,
+         device->context.last_poll_cycle.allocations);
+   printf("Initialization: %u ms, %u chained tasks\n", device->context.last_initialization_time_ms,
+         device->context.chained_tasks_counter);
+   printf("Request on the wire: %u us after the poll decision, %u payloads on the prompt, the relay switched %u us after the response\n",
+         device->context.request_on_wire_time_us, device->context.payloads_sent_on_prompt_counter, device->context.relay_actuation_time_us);
+
+   check_long_network_list();
+   return sim_report("test_requests");
+}
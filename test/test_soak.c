@@ -0,0 +1,56 @@
+/**
+ * A day of the long polling without faults. Polls have to keep their rate, the heap mustn't grow after the first hour, the error
+ * counters have to stay 0 and the event timeline mustn't show anything after the start
+ */
+#include <time.h>
+#include "simulator.c"
+
+#define SOAK_HOURS 24
+#define HOUR_MS (60 * 60 * 1000)
+// Connection, CIPSEND and the response take far less than this besides the server hold time
+#define POLL_OVERHEAD_MAX_MS 3000
+// The device is started, has joined the network and has found the server by then
+#define START_MAX_MS 60000
+
+int main() {
+   clock_t start_clock = clock();
+
+   sim_init(1);
+   SimulatedDevice *device = sim_device(0);
+
+   sim_run_ms(HOUR_MS);
+   unsigned int first_hour_heap_peak_bytes = device->heap_peak_bytes;
+
+   for (unsigned char hour = 1; hour < SOAK_HOURS; hour++) {
+      unsigned int polls = device->polls;
+
+      sim_run_ms(HOUR_MS);
+      CHECK(device->polls - polls >= HOUR_MS / (device->server_hold_ms + POLL_OVERHEAD_MAX_MS));
+   }
+
+   double seconds = (double) (clock() - start_clock) / CLOCKS_PER_SEC;
+
+   CHECK(device->heap_peak_bytes == first_hour_heap_peak_bytes);
+   CHECK(device->heap_peak_bytes <= device->heap_budget_bytes);
+   CHECK(device->failed_allocations == 0);
+   CHECK(device->resets == 0);
+   CHECK(device->context.device_state_resets_counter == 0);
+   CHECK(device->context.send_usart_data_errors_unresetable_counter == 0);
+   CHECK(device->context.usart_framing_errors_counter == 0);
+   // The network checks are sent while the server holds the long polling request
+   CHECK(device->context.commands_during_long_polling_counter > 0);
+   // The server has answered every ping
+   CHECK(device->context.server_ping_time_ms > 0);
+   CHECK(device->context.server_ping_failures_counter == 0);
+   // The counter is 16 bit, the polls completed by the device are the ones the server has got the next request after
+   CHECK((unsigned short) (device->context.polls_completed_counter - device->polls) <= 1);
+   // Nothing has happened since the device has connected
+   for (unsigned char i = 0; i < device->context.device_events_amount; i++) {
+      CHECK(device->context.device_events[i].timestamp_ms < START_MAX_MS);
+   }
+   // SysTick has counted every simulated millisecond, the skipped ticks included
+   CHECK(sim_time_ms() - device->context.milliseconds_counter < 100);
+   printf("%u hours: %u polls, %u commands during the long polling, the largest heap: %u bytes, %.1f s\n", SOAK_HOURS, device->polls,
+         device->context.commands_during_long_polling_counter, device->heap_peak_bytes, seconds);
+   return sim_report("test_soak");
+}